@@ -0,0 +1,162 @@
+// CBoundedQueue
+// A lock-free, bounded multi-producer multi-consumer FIFO queue
+//
+// The queue is a ring buffer of cells, each carrying a sequence number that
+// tells producers and consumers whether the cell is free or filled in the
+// current lap (D. Vyukov's bounded MPMC queue). tryPush/tryPop never block;
+// push/pop wait (spinning first, then sleeping) while the queue is full or
+// empty, which bounds the memory held by a pipeline stage.
+//
+// Example:
+// CBoundedQueue<int> queue(8);
+// queue.push(42);
+// int aValue; queue.pop(aValue);
+//-------------------------------------------------------------------------
+
+#ifndef CBOUNDEDQUEUE_H
+#define CBOUNDEDQUEUE_H
+
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <stddef.h>
+
+template <class T>
+class CBoundedQueue {
+public:
+  // constructor, the capacity is rounded up to the next power of 2
+  CBoundedQueue(int aCapacity);
+  // destructor
+  virtual ~CBoundedQueue();
+
+  // Appends aItem if the queue is not full, returns false otherwise
+  bool tryPush(const T& aItem);
+  // Removes the first item if the queue is not empty, returns false otherwise
+  bool tryPop(T& aItem);
+  // Appends aItem, waits while the queue is full
+  void push(const T& aItem);
+  // Removes the first item, waits while the queue is empty
+  void pop(T& aItem);
+
+  // Gives access to the queue's capacity
+  inline int capacity() const;
+protected:
+  // Lets a thread wait for a slot: spin first, then back off to short sleeps
+  static void backoff(int& aRound);
+
+  struct CCell {
+    std::atomic<size_t> mSequence;
+    T mData;
+  };
+  CCell* mCells;
+  size_t mMask;
+  // Producer and consumer positions live on separate cache lines
+  alignas(64) std::atomic<size_t> mEnqueuePos;
+  alignas(64) std::atomic<size_t> mDequeuePos;
+private:
+  // Copying a queue makes no sense
+  CBoundedQueue(const CBoundedQueue<T>&);
+  CBoundedQueue<T>& operator=(const CBoundedQueue<T>&);
+};
+
+// I M P L E M E N T A T I O N --------------------------------------------
+
+// constructor
+template <class T>
+CBoundedQueue<T>::CBoundedQueue(int aCapacity) {
+  size_t aSize = 2;
+  while ((int)aSize < aCapacity) aSize <<= 1;
+  mCells = new CCell[aSize];
+  mMask = aSize-1;
+  for (size_t i = 0; i < aSize; i++)
+    mCells[i].mSequence.store(i,std::memory_order_relaxed);
+  mEnqueuePos.store(0,std::memory_order_relaxed);
+  mDequeuePos.store(0,std::memory_order_relaxed);
+}
+
+// destructor
+template <class T>
+CBoundedQueue<T>::~CBoundedQueue() {
+  delete[] mCells;
+}
+
+// tryPush
+template <class T>
+bool CBoundedQueue<T>::tryPush(const T& aItem) {
+  size_t aPos = mEnqueuePos.load(std::memory_order_relaxed);
+  CCell* aCell;
+  while (true) {
+    aCell = &mCells[aPos & mMask];
+    size_t aSeq = aCell->mSequence.load(std::memory_order_acquire);
+    ptrdiff_t aDiff = (ptrdiff_t)aSeq-(ptrdiff_t)aPos;
+    if (aDiff == 0) {
+      if (mEnqueuePos.compare_exchange_weak(aPos,aPos+1,std::memory_order_relaxed)) break;
+    }
+    // Cell still holds an item of the previous lap: queue is full
+    else if (aDiff < 0) return false;
+    else aPos = mEnqueuePos.load(std::memory_order_relaxed);
+  }
+  aCell->mData = aItem;
+  aCell->mSequence.store(aPos+1,std::memory_order_release);
+  return true;
+}
+
+// tryPop
+template <class T>
+bool CBoundedQueue<T>::tryPop(T& aItem) {
+  size_t aPos = mDequeuePos.load(std::memory_order_relaxed);
+  CCell* aCell;
+  while (true) {
+    aCell = &mCells[aPos & mMask];
+    size_t aSeq = aCell->mSequence.load(std::memory_order_acquire);
+    ptrdiff_t aDiff = (ptrdiff_t)aSeq-(ptrdiff_t)(aPos+1);
+    if (aDiff == 0) {
+      if (mDequeuePos.compare_exchange_weak(aPos,aPos+1,std::memory_order_relaxed)) break;
+    }
+    // Cell has not been filled yet: queue is empty
+    else if (aDiff < 0) return false;
+    else aPos = mDequeuePos.load(std::memory_order_relaxed);
+  }
+  aItem = aCell->mData;
+  aCell->mSequence.store(aPos+mMask+1,std::memory_order_release);
+  return true;
+}
+
+// push
+template <class T>
+void CBoundedQueue<T>::push(const T& aItem) {
+  int aRound = 0;
+  while (!tryPush(aItem))
+    backoff(aRound);
+}
+
+// pop
+template <class T>
+void CBoundedQueue<T>::pop(T& aItem) {
+  int aRound = 0;
+  while (!tryPop(aItem))
+    backoff(aRound);
+}
+
+// capacity
+template <class T>
+inline int CBoundedQueue<T>::capacity() const {
+  return (int)mMask+1;
+}
+
+// P R O T E C T E D ------------------------------------------------------
+
+// backoff
+template <class T>
+void CBoundedQueue<T>::backoff(int& aRound) {
+  if (aRound < 64) std::this_thread::yield();
+  else {
+    // Sleep 1us, 2us, ... up to 1ms: stages waiting for file I/O do not burn a core
+    int aShift = aRound-64;
+    if (aShift > 10) aShift = 10;
+    std::this_thread::sleep_for(std::chrono::microseconds(1 << aShift));
+  }
+  aRound++;
+}
+
+#endif
@@ -0,0 +1,235 @@
+// CCanny
+// Fused, row-streaming Canny edge detector
+//
+// Computes central-difference gradients with mirrored boundaries, quantizes
+// the gradient direction, suppresses non-maxima and thresholds the result
+// while sweeping over the image row by row. Only three rows of gradient
+// magnitudes and directions are kept as working state.
+// The result equals that of the sequence
+//   NFilter::filter(x, CDerivative(3), 1); NFilter::filter(y, 1, CDerivative(3));
+//   magnitude; normalize(0,255); non-maximum suppression; clip(aThreshold,255);
+//   normalize(0,255)
+// (up to pixels whose gradient direction lies exactly on a sector boundary).
+//-------------------------------------------------------------------------
+
+#ifndef CCANNY_H
+#define CCANNY_H
+
+#include <math.h>
+#include "CMatrix.h"
+
+template <class T>
+class CCanny {
+public:
+  // constructor, aThreshold refers to the gradient magnitude normalized to [0,255]
+  CCanny(const T aThreshold = 70);
+  // destructor
+  virtual ~CCanny();
+
+  // Computes the normalized edge map of aImage, the size of aResult will be adjusted
+  void apply(const CMatrix<T>& aImage, CMatrix<T>& aResult);
+
+  // Access to the threshold
+  inline T threshold() const;
+  inline void setThreshold(const T aThreshold);
+protected:
+  // Quantized gradient directions
+  enum { cHorizontal = 0, cDiagonal = 1, cVertical = 2, cAntiDiagonal = 3 };
+  // Makes sure the row buffers can hold rows of aXSize pixels
+  void reserve(int aXSize);
+  // Computes gradient magnitude (and direction if aDir != 0) of row ay,
+  // aSquared leaves out the square root
+  void gradientRow(const CMatrix<T>& aImage, int ay, T* aMag, unsigned char* aDir, bool aSquared = false) const;
+
+  T mThreshold;
+  int mCapacity;
+  // Three rows of gradient magnitudes and directions
+  T* mMag;
+  unsigned char* mDir;
+private:
+  // The row buffers are not shared, use one detector per thread
+  CCanny(const CCanny<T>&);
+  CCanny<T>& operator=(const CCanny<T>&);
+};
+
+// I M P L E M E N T A T I O N --------------------------------------------
+
+// constructor
+template <class T>
+CCanny<T>::CCanny(const T aThreshold)
+  : mThreshold(aThreshold), mCapacity(0), mMag(0), mDir(0) {
+}
+
+// destructor
+template <class T>
+CCanny<T>::~CCanny() {
+  delete[] mMag;
+  delete[] mDir;
+}
+
+// apply
+template <class T>
+void CCanny<T>::apply(const CMatrix<T>& aImage, CMatrix<T>& aResult) {
+  int aXSize = aImage.xSize();
+  int aYSize = aImage.ySize();
+  if (aResult.xSize() != aXSize || aResult.ySize() != aYSize)
+    aResult.setSize(aXSize,aYSize);
+  if (aXSize*aYSize == 0) return;
+  reserve(aXSize);
+  // First sweep: range of the gradient magnitude. The square root is monotonic,
+  // so only the extremes of the squared magnitudes need one.
+  T aMin = 0;
+  T aMax = 0;
+  for (int y = 0; y < aYSize; y++) {
+    gradientRow(aImage,y,mMag,0,true);
+    if (y == 0) aMin = aMax = mMag[0];
+    for (int x = 0; x < aXSize; x++) {
+      if (mMag[x] > aMax) aMax = mMag[x];
+      if (mMag[x] < aMin) aMin = mMag[x];
+    }
+  }
+  aMin = sqrt(aMin);
+  aMax = sqrt(aMax);
+  T aScale = aMax-aMin;
+  if (aScale == 0) aScale = 1;
+  else aScale = 255/aScale;
+  // Second sweep: non-maximum suppression and thresholding
+  // aPrev holds the already suppressed row y-1, aCur row y (suppressed in place
+  // from left to right), aNext the unsuppressed row y+1
+  T* aPrev = mMag;
+  T* aCur = mMag+aXSize;
+  T* aNext = mMag+2*aXSize;
+  unsigned char* aDirCur = mDir+aXSize;
+  unsigned char* aDirNext = mDir+2*aXSize;
+  gradientRow(aImage,0,aNext,aDirNext);
+  for (int x = 0; x < aXSize; x++) {
+    aNext[x] -= aMin; aNext[x] *= aScale;
+  }
+  T aOutMin = 0;
+  T aOutMax = 0;
+  for (int y = 0; y < aYSize; y++) {
+    T* aHelp = aPrev; aPrev = aCur; aCur = aNext; aNext = aHelp;
+    unsigned char* aDirHelp = aDirCur; aDirCur = aDirNext; aDirNext = aDirHelp;
+    if (y+1 < aYSize) {
+      gradientRow(aImage,y+1,aNext,aDirNext);
+      for (int x = 0; x < aXSize; x++) {
+        aNext[x] -= aMin; aNext[x] *= aScale;
+      }
+    }
+    // Boundary pixels are never suppressed
+    if (y > 0 && y < aYSize-1)
+      for (int x = 1; x < aXSize-1; x++) {
+        T m = aCur[x];
+        switch (aDirCur[x]) {
+          case cHorizontal:
+            if (m <= aCur[x-1] || m <= aCur[x+1]) aCur[x] = 0;
+            break;
+          case cDiagonal:
+            if (m <= aPrev[x-1] || m <= aNext[x+1]) aCur[x] = 0;
+            break;
+          case cVertical:
+            if (m <= aNext[x] || m <= aPrev[x]) aCur[x] = 0;
+            break;
+          default:
+            if (m <= aPrev[x+1] || m <= aNext[x-1]) aCur[x] = 0;
+        }
+      }
+    // Thresholding, row y is final now
+    T* aOut = aResult.data()+y*aResult.pitch();
+    for (int x = 0; x < aXSize; x++) {
+      T m = aCur[x];
+      if (m < mThreshold) m = mThreshold;
+      else if (m > 255) m = 255;
+      aOut[x] = m;
+    }
+    if (y == 0) aOutMin = aOutMax = aOut[0];
+    for (int x = 0; x < aXSize; x++) {
+      if (aOut[x] > aOutMax) aOutMax = aOut[x];
+      if (aOut[x] < aOutMin) aOutMin = aOut[x];
+    }
+  }
+  // Final normalization to [0,255]
+  aScale = aOutMax-aOutMin;
+  if (aScale == 0) aScale = 1;
+  else aScale = 255/aScale;
+  for (int y = 0; y < aYSize; y++) {
+    T* aOut = aResult.data()+y*aResult.pitch();
+    for (int x = 0; x < aXSize; x++) {
+      aOut[x] -= aOutMin; aOut[x] *= aScale;
+    }
+  }
+}
+
+// threshold
+template <class T>
+inline T CCanny<T>::threshold() const {
+  return mThreshold;
+}
+
+// setThreshold
+template <class T>
+inline void CCanny<T>::setThreshold(const T aThreshold) {
+  mThreshold = aThreshold;
+}
+
+// P R O T E C T E D ------------------------------------------------------
+
+// reserve
+template <class T>
+void CCanny<T>::reserve(int aXSize) {
+  if (aXSize <= mCapacity) return;
+  delete[] mMag;
+  delete[] mDir;
+  mMag = new T[3*aXSize];
+  mDir = new unsigned char[3*aXSize];
+  mCapacity = aXSize;
+}
+
+// gradientRow
+template <class T>
+void CCanny<T>::gradientRow(const CMatrix<T>& aImage, int ay, T* aMag, unsigned char* aDir, bool aSquared) const {
+  // tan(22.5 deg) and tan(67.5 deg) delimit the direction sectors
+  static const T cTan1 = 0.41421356237309504880;
+  static const T cTan3 = 2.41421356237309504880;
+  int aXSize = aImage.xSize();
+  int aYSize = aImage.ySize();
+  int aPitch = aImage.pitch();
+  const T* aUp = aImage.data()+(ay > 0 ? ay-1 : 0)*aPitch;
+  const T* aRow = aImage.data()+ay*aPitch;
+  const T* aDown = aImage.data()+(ay < aYSize-1 ? ay+1 : aYSize-1)*aPitch;
+  if (aSquared) {
+    // The interior without boundary branches, so the compiler can vectorize it
+    for (int x = 1; x < aXSize-1; x++) {
+      T gx = (T)0.5*aRow[x+1]-(T)0.5*aRow[x-1];
+      T gy = (T)0.5*aDown[x]-(T)0.5*aUp[x];
+      aMag[x] = gx*gx+gy*gy;
+    }
+    int aBorder[2] = {0,aXSize-1};
+    for (int k = 0; k < 2; k++) {
+      int x = aBorder[k];
+      int xm = (x > 0) ? x-1 : 0;
+      int xp = (x < aXSize-1) ? x+1 : aXSize-1;
+      T gx = (T)0.5*aRow[xp]-(T)0.5*aRow[xm];
+      T gy = (T)0.5*aDown[x]-(T)0.5*aUp[x];
+      aMag[x] = gx*gx+gy*gy;
+    }
+    return;
+  }
+  for (int x = 0; x < aXSize; x++) {
+    // Mirrored boundaries, the branches are only taken at x = 0 and x = aXSize-1
+    int xm = (x > 0) ? x-1 : 0;
+    int xp = (x < aXSize-1) ? x+1 : aXSize-1;
+    T gx = (T)0.5*aRow[xp]-(T)0.5*aRow[xm];
+    T gy = (T)0.5*aDown[x]-(T)0.5*aUp[x];
+    aMag[x] = sqrt(gx*gx+gy*gy);
+    if (aDir == 0) continue;
+    T aAbsX = fabs(gx);
+    T aAbsY = fabs(gy);
+    if (aAbsY <= cTan1*aAbsX) aDir[x] = cHorizontal;
+    else if (aAbsY > cTan3*aAbsX) aDir[x] = cVertical;
+    else if ((gx > 0) == (gy > 0)) aDir[x] = cDiagonal;
+    else aDir[x] = cAntiDiagonal;
+  }
+}
+
+#endif
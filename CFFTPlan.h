@@ -0,0 +1,1050 @@
+// CFFT1D, CFFTPlan, CRealFFTPlan
+// Reusable 1D and 2D FFTs of a fixed size, of complex and of real data
+//
+// A plan computes the twiddle factors and the bit reversal tables of its rows
+// and columns once and keeps the data in one aligned buffer of interleaved
+// complex values, so a sequence of frames of the same size is transformed
+// without any allocation or table setup per frame. cached() keeps the plans
+// of the sizes a thread used last.
+//
+// Any size is possible. CFFT1D transforms powers of 2 with the routines of
+// Takuya Ooura's FFT package, products of powers of 2, 3 and 5 (e.g. 1920 or
+// 1080) with a mixed radix Stockham FFT, and all other sizes with Bluestein's
+// algorithm, a convolution computed by transforms of one of the former sizes.
+// The latter is several times slower; padding to goodSize() is usually the
+// better choice where the data allows it.
+//
+// CRealFFTPlan transforms real images. Each row of xSize() values is
+// transformed as xSize()/2 complex values and then split into the
+// frequencies 0..xSize()/2, the columns only cover these frequencies. This
+// takes half the work and memory of a complex transform; the other half of
+// the spectrum is the complex conjugate.
+//
+// The power of 2 transforms of Ooura's package are also available as the
+// functions cdft() and cdft2d().
+//
+// Example:
+// CFFTPlan& plan = CFFTPlan::cached(256,256);
+// plan.row(y)[2*x] = real; plan.row(y)[2*x+1] = imaginary;
+// plan.transform(-1);
+// CRealFFTPlan& realPlan = CRealFFTPlan::cached(256,256);
+// realPlan.row(y)[x] = value;
+// realPlan.forward();
+// spectrum(u,v) = realPlan.row(v)[2*u] + i*realPlan.row(v)[2*u+1] for 0 <= u <= 128
+//-------------------------------------------------------------------------
+
+#ifndef CFFTPLAN_H
+#define CFFTPLAN_H
+
+#include <math.h>
+#include <iostream>
+#include <algorithm>
+#include <list>
+#include <memory>
+#include <functional>
+#include "CVector.h"
+#include "CThreadPool.h"
+
+class CFFT1D {
+public:
+  // constructor, transform of aSize complex values, aSize at least 1
+  CFFT1D(int aSize);
+
+  // Transforms aSize pairs of real and imaginary part in a in place, aSign as in CFFTPlan::transform().
+  // aScratch holds scratchSize() doubles, so that threads can share the transform.
+  void transform(double* a, int aSign, double* aScratch) const;
+
+  // Gives access to the size
+  inline int size() const;
+  // Number of doubles of scratch memory transform() needs
+  inline int scratchSize() const;
+
+  // Smallest size of at least aSize that has no prime factors other than 2, 3 and 5
+  static int goodSize(int aSize);
+protected:
+  enum EMethod { cOoura, cMixedRadix, cBluestein };
+  // Radix 2, 3, 4 and 5 passes of the Stockham FFT, alternating between a and aScratch
+  void mixedRadix(double* a, int aSign, double* aScratch) const;
+  // One pass of radix r from x to y on the length r*m with stride s, w are the twiddle factors of the pass
+  template <int r> static void pass(const double* x, double* y, const double* w, int m, int s, int aSign);
+  // Convolution with the chirp exp(-i*pi*j^2/size()) via transforms of mInner
+  void bluestein(double* a, int aSign, double* aScratch) const;
+
+  int mSize;
+  EMethod mMethod;
+  // Ooura: bit reversal table and twiddle factors
+  CVector<int> mTable;
+  CVector<double> mW;
+  // Mixed radix: the radix of each pass and exp(-2*pi*i*p*u/n) for each pass of length n
+  CVector<int> mFactors;
+  CVector<double> mTwiddles;
+  // Bluestein: exp(-i*pi*j^2/size()) and the scaled spectra of the conjugate chirp for both signs
+  std::shared_ptr<const CFFT1D> mInner;
+  CVector<double> mChirp;
+  CVector<double> mKernel[2];
+};
+
+class CFFTPlan {
+public:
+  // constructor, plan for aYSize rows of aXSize complex values
+  CFFTPlan(int aXSize, int aYSize);
+
+  // Transforms the buffer in place, first the rows, then the columns. aSign = -1 computes
+  // X[k] = sum_j x[j]*exp(-2*pi*i*j*k/n), aSign = 1 the same with exp(+...), both without normalization
+  void transform(int aSign);
+
+  // Gives access to row y of the buffer, xSize() pairs of real and imaginary part
+  inline double* row(int y) const;
+  // Gives access to the buffer, the rows are pitch() doubles apart
+  inline double* data() const;
+  inline int pitch() const;
+  // Gives access to the size
+  inline int xSize() const;
+  inline int ySize() const;
+
+  // Returns the plan of the calling thread for this size. The plans of the last cCached sizes
+  // are kept, so the reference stays valid until the thread has asked for cCached other sizes.
+  static CFFTPlan& cached(int aXSize, int aYSize);
+protected:
+  enum { cCached = 4 };
+  int mXSize;
+  int mYSize;
+  // Rows are padded by a cache line, a power of 2 as row distance would map
+  // the elements of a column to the same cache sets
+  int mPitch;
+  CVector<double> mData;
+  // Transforms of a row and of a column
+  CFFT1D mRows;
+  CFFT1D mColumns;
+};
+
+class CRealFFTPlan {
+public:
+  // constructor, plan for real images of aXSize x aYSize pixels, aXSize even
+  CRealFFTPlan(int aXSize, int aYSize);
+
+  // Replaces the real image in the buffer by its half spectrum
+  // X(u,v) = sum_x,y I(x,y)*exp(-2*pi*i*(u*x/xSize()+v*y/ySize())) for 0 <= u <= xSize()/2.
+  // The other half is X(u,v) = conj(X(xSize()-u,(ySize()-v) % ySize())).
+  void forward();
+  // Replaces the half spectrum in the buffer by the real image it belongs to, times xSize()*ySize()
+  void inverse();
+
+  // Gives access to row y of the buffer, xSize() real values or xSize()/2+1 pairs of real and imaginary part
+  inline double* row(int y) const;
+  // Gives access to the buffer, the rows are pitch() doubles apart
+  inline double* data() const;
+  inline int pitch() const;
+  // Gives access to the size of the image
+  inline int xSize() const;
+  inline int ySize() const;
+  // Number of frequencies per row of the half spectrum, xSize()/2+1
+  inline int spectrumXSize() const;
+
+  // Returns the plan of the calling thread for this size, see CFFTPlan::cached()
+  static CRealFFTPlan& cached(int aXSize, int aYSize);
+protected:
+  enum { cCached = 4 };
+  // Splits the transform Z of the xSize()/2 complex values packed into a row into the spectrum of the row, or back
+  inline void split(double* a);
+  inline void merge(double* a);
+
+  int mXSize;
+  int mYSize;
+  int mPitch;
+  CVector<double> mData;
+  // Transforms of a row of xSize()/2 and of a column of ySize() complex values
+  CFFT1D mRows;
+  CFFT1D mColumns;
+  // cos and sin of 2*pi*u/xSize() for 0 <= u <= xSize()/4
+  CVector<double> mSplit;
+};
+
+// Returns the plan of type TPlan of the calling thread for a size, the last aCount sizes are kept
+template <class TPlan> inline TPlan& cachedPlan(int aXSize, int aYSize, unsigned int aCount);
+
+// Exceptions -----------------------------------------------------------------
+
+// Thrown if a plan is requested for an empty size or a real plan for an odd width
+struct EFFTSize {
+  EFFTSize(int aXSize, int aYSize) {
+    using namespace std;
+    cerr << "Exception EFFTSize: " << aXSize << "x" << aYSize << " cannot be transformed" << endl;
+  }
+};
+
+// -----------------------------------------------------------------------------
+// FFT (from Takuya OOURA FFT package)
+// -----------------------------------------------------------------------------
+
+// Bit reversal of bitrv2 split into computing the table and permuting a,
+// so a plan computes the table once
+inline void bitrv2table(int n, int *ip) {
+  int j, l, m;
+  ip[0] = 0;
+  l = n;
+  m = 1;
+  while ((m << 2) < l) {
+    l >>= 1;
+    for (j = 0; j <= m - 1; j++)
+      ip[m + j] = ip[j] + l;
+    m <<= 1;
+  }
+}
+
+inline void bitrv2permute(int n, const int *ip, double *a) {
+  int j, j1, k, k1, l, m, m2;
+  double xr, xi;
+  l = n;
+  m = 1;
+  while ((m << 2) < l) {
+    l >>= 1;
+    m <<= 1;
+  }
+  if ((m << 2) > l) {
+    for (k = 1; k <= m - 1; k++)
+      for (j = 0; j <= k - 1; j++) {
+        j1 = (j << 1) + ip[k];
+        k1 = (k << 1) + ip[j];
+        xr = a[j1];
+        xi = a[j1 + 1];
+        a[j1] = a[k1];
+        a[j1 + 1] = a[k1 + 1];
+        a[k1] = xr;
+        a[k1 + 1] = xi;
+      }
+  }
+  else {
+    m2 = m << 1;
+    for (k = 1; k <= m - 1; k++)
+      for (j = 0; j <= k - 1; j++) {
+        j1 = (j << 1) + ip[k];
+        k1 = (k << 1) + ip[j];
+        xr = a[j1];
+        xi = a[j1 + 1];
+        a[j1] = a[k1];
+        a[j1 + 1] = a[k1 + 1];
+        a[k1] = xr;
+        a[k1 + 1] = xi;
+        j1 += m2;
+        k1 += m2;
+        xr = a[j1];
+        xi = a[j1 + 1];
+        a[j1] = a[k1];
+        a[j1 + 1] = a[k1 + 1];
+        a[k1] = xr;
+        a[k1 + 1] = xi;
+      }
+  }
+}
+
+inline void bitrv2(int n, int *ip, double *a) {
+  bitrv2table(n, ip);
+  bitrv2permute(n, ip, a);
+}
+
+inline void makewt(int nw, int *ip, double *w) {
+  int nwh, j;
+  double delta, x, y;
+  ip[0] = nw;
+  ip[1] = 1;
+  if (nw > 2) {
+    nwh = nw >> 1;
+    delta = atan(1.0) / nwh;
+    w[0] = 1;
+    w[1] = 0;
+    w[nwh] = cos(delta * nwh);
+    w[nwh + 1] = w[nwh];
+    for (j = 2; j <= nwh - 2; j += 2) {
+      x = cos(delta * j);
+      y = sin(delta * j);
+      w[j] = x;
+      w[j + 1] = y;
+      w[nw - j] = y;
+      w[nw - j + 1] = x;
+    }
+    bitrv2(nw, ip + 2, w);
+  }
+}
+
+inline void cftbsub(int n, double *a, double *w) {
+  int j, j1, j2, j3, k, k1, ks, l, m;
+  double wk1r, wk1i, wk2r, wk2i, wk3r, wk3i;
+  double x0r, x0i, x1r, x1i, x2r, x2i, x3r, x3i;
+  l = 2;
+  while ((l << 1) < n) {
+    m = l << 2;
+    for (j = 0; j <= l - 2; j += 2) {
+      j1 = j + l;
+      j2 = j1 + l;
+      j3 = j2 + l;
+      x0r = a[j] + a[j1];
+      x0i = a[j + 1] + a[j1 + 1];
+      x1r = a[j] - a[j1];
+      x1i = a[j + 1] - a[j1 + 1];
+      x2r = a[j2] + a[j3];
+      x2i = a[j2 + 1] + a[j3 + 1];
+      x3r = a[j2] - a[j3];
+      x3i = a[j2 + 1] - a[j3 + 1];
+      a[j] = x0r + x2r;
+      a[j + 1] = x0i + x2i;
+      a[j2] = x0r - x2r;
+      a[j2 + 1] = x0i - x2i;
+      a[j1] = x1r - x3i;
+      a[j1 + 1] = x1i + x3r;
+      a[j3] = x1r + x3i;
+      a[j3 + 1] = x1i - x3r;
+    }
+    if (m < n) {
+      wk1r = w[2];
+      for (j = m; j <= l + m - 2; j += 2) {
+        j1 = j + l;
+        j2 = j1 + l;
+        j3 = j2 + l;
+        x0r = a[j] + a[j1];
+        x0i = a[j + 1] + a[j1 + 1];
+        x1r = a[j] - a[j1];
+        x1i = a[j + 1] - a[j1 + 1];
+        x2r = a[j2] + a[j3];
+        x2i = a[j2 + 1] + a[j3 + 1];
+        x3r = a[j2] - a[j3];
+        x3i = a[j2 + 1] - a[j3 + 1];
+        a[j] = x0r + x2r;
+        a[j + 1] = x0i + x2i;
+        a[j2] = x2i - x0i;
+        a[j2 + 1] = x0r - x2r;
+        x0r = x1r - x3i;
+        x0i = x1i + x3r;
+        a[j1] = wk1r * (x0r - x0i);
+        a[j1 + 1] = wk1r * (x0r + x0i);
+        x0r = x3i + x1r;
+        x0i = x3r - x1i;
+        a[j3] = wk1r * (x0i - x0r);
+        a[j3 + 1] = wk1r * (x0i + x0r);
+      }
+      k1 = 1;
+      ks = -1;
+      for (k = (m << 1); k <= n - m; k += m) {
+        k1++;
+        ks = -ks;
+        wk1r = w[k1 << 1];
+        wk1i = w[(k1 << 1) + 1];
+        wk2r = ks * w[k1];
+        wk2i = w[k1 + ks];
+        wk3r = wk1r - 2 * wk2i * wk1i;
+        wk3i = 2 * wk2i * wk1r - wk1i;
+        for (j = k; j <= l + k - 2; j += 2) {
+          j1 = j + l;
+          j2 = j1 + l;
+          j3 = j2 + l;
+          x0r = a[j] + a[j1];
+          x0i = a[j + 1] + a[j1 + 1];
+          x1r = a[j] - a[j1];
+          x1i = a[j + 1] - a[j1 + 1];
+          x2r = a[j2] + a[j3];
+          x2i = a[j2 + 1] + a[j3 + 1];
+          x3r = a[j2] - a[j3];
+          x3i = a[j2 + 1] - a[j3 + 1];
+          a[j] = x0r + x2r;
+          a[j + 1] = x0i + x2i;
+          x0r -= x2r;
+          x0i -= x2i;
+          a[j2] = wk2r * x0r - wk2i * x0i;
+          a[j2 + 1] = wk2r * x0i + wk2i * x0r;
+          x0r = x1r - x3i;
+          x0i = x1i + x3r;
+          a[j1] = wk1r * x0r - wk1i * x0i;
+          a[j1 + 1] = wk1r * x0i + wk1i * x0r;
+          x0r = x1r + x3i;
+          x0i = x1i - x3r;
+          a[j3] = wk3r * x0r - wk3i * x0i;
+          a[j3 + 1] = wk3r * x0i + wk3i * x0r;
+        }
+      }
+    }
+    l = m;
+  }
+  if (l < n) {
+    for (j = 0; j <= l - 2; j += 2) {
+      j1 = j + l;
+      x0r = a[j] - a[j1];
+      x0i = a[j + 1] - a[j1 + 1];
+      a[j] += a[j1];
+      a[j + 1] += a[j1 + 1];
+      a[j1] = x0r;
+      a[j1 + 1] = x0i;
+    }
+  }
+}
+
+inline void cftfsub(int n, double *a, double *w) {
+  int j, j1, j2, j3, k, k1, ks, l, m;
+  double wk1r, wk1i, wk2r, wk2i, wk3r, wk3i;
+  double x0r, x0i, x1r, x1i, x2r, x2i, x3r, x3i;
+
+  l = 2;
+  while ((l << 1) < n) {
+    m = l << 2;
+    for (j = 0; j <= l - 2; j += 2) {
+      j1 = j + l;
+      j2 = j1 + l;
+      j3 = j2 + l;
+      x0r = a[j] + a[j1];
+      x0i = a[j + 1] + a[j1 + 1];
+      x1r = a[j] - a[j1];
+      x1i = a[j + 1] - a[j1 + 1];
+      x2r = a[j2] + a[j3];
+      x2i = a[j2 + 1] + a[j3 + 1];
+      x3r = a[j2] - a[j3];
+      x3i = a[j2 + 1] - a[j3 + 1];
+      a[j] = x0r + x2r;
+      a[j + 1] = x0i + x2i;
+      a[j2] = x0r - x2r;
+      a[j2 + 1] = x0i - x2i;
+      a[j1] = x1r + x3i;
+      a[j1 + 1] = x1i - x3r;
+      a[j3] = x1r - x3i;
+      a[j3 + 1] = x1i + x3r;
+    }
+    if (m < n) {
+      wk1r = w[2];
+      for (j = m; j <= l + m - 2; j += 2) {
+        j1 = j + l;
+        j2 = j1 + l;
+        j3 = j2 + l;
+        x0r = a[j] + a[j1];
+        x0i = a[j + 1] + a[j1 + 1];
+        x1r = a[j] - a[j1];
+        x1i = a[j + 1] - a[j1 + 1];
+        x2r = a[j2] + a[j3];
+        x2i = a[j2 + 1] + a[j3 + 1];
+        x3r = a[j2] - a[j3];
+        x3i = a[j2 + 1] - a[j3 + 1];
+        a[j] = x0r + x2r;
+        a[j + 1] = x0i + x2i;
+        a[j2] = x0i - x2i;
+        a[j2 + 1] = x2r - x0r;
+        x0r = x1r + x3i;
+        x0i = x1i - x3r;
+        a[j1] = wk1r * (x0i + x0r);
+        a[j1 + 1] = wk1r * (x0i - x0r);
+        x0r = x3i - x1r;
+        x0i = x3r + x1i;
+        a[j3] = wk1r * (x0r + x0i);
+        a[j3 + 1] = wk1r * (x0r - x0i);
+      }
+      k1 = 1;
+      ks = -1;
+      for (k = (m << 1); k <= n - m; k += m) {
+        k1++;
+        ks = -ks;
+        wk1r = w[k1 << 1];
+        wk1i = w[(k1 << 1) + 1];
+        wk2r = ks * w[k1];
+        wk2i = w[k1 + ks];
+        wk3r = wk1r - 2 * wk2i * wk1i;
+        wk3i = 2 * wk2i * wk1r - wk1i;
+        for (j = k; j <= l + k - 2; j += 2) {
+          j1 = j + l;
+          j2 = j1 + l;
+          j3 = j2 + l;
+          x0r = a[j] + a[j1];
+          x0i = a[j + 1] + a[j1 + 1];
+          x1r = a[j] - a[j1];
+          x1i = a[j + 1] - a[j1 + 1];
+          x2r = a[j2] + a[j3];
+          x2i = a[j2 + 1] + a[j3 + 1];
+          x3r = a[j2] - a[j3];
+          x3i = a[j2 + 1] - a[j3 + 1];
+          a[j] = x0r + x2r;
+          a[j + 1] = x0i + x2i;
+          x0r -= x2r;
+          x0i -= x2i;
+          a[j2] = wk2r * x0r + wk2i * x0i;
+          a[j2 + 1] = wk2r * x0i - wk2i * x0r;
+          x0r = x1r + x3i;
+          x0i = x1i - x3r;
+          a[j1] = wk1r * x0r + wk1i * x0i;
+          a[j1 + 1] = wk1r * x0i - wk1i * x0r;
+          x0r = x1r - x3i;
+          x0i = x1i + x3r;
+          a[j3] = wk3r * x0r + wk3i * x0i;
+          a[j3 + 1] = wk3r * x0i - wk3i * x0r;
+        }
+      }
+    }
+    l = m;
+  }
+  if (l < n) {
+    for (j = 0; j <= l - 2; j += 2) {
+      j1 = j + l;
+      x0r = a[j] - a[j1];
+      x0i = a[j + 1] - a[j1 + 1];
+      a[j] += a[j1];
+      a[j + 1] += a[j1 + 1];
+      a[j1] = x0r;
+      a[j1 + 1] = x0i;
+    }
+  }
+}
+
+inline void cdft(int n, int isgn, double *a, int *ip, double *w) {
+  if (n > (ip[0] << 2)) makewt(n >> 2, ip, w);
+  if (n > 4) bitrv2(n, ip + 2, a);
+  if (isgn < 0) cftfsub(n, a, w);
+  else cftbsub(n, a, w);
+}
+
+// Row and column passes of the 2D transforms, shared by cdft2d and the plans.
+// Both split their work across the cores for large transforms. A column is
+// strided in memory, so columns are gathered and transformed in blocks of
+// cColumnBlock: each row then contributes a whole cache line.
+enum { cColumnBlock = 4, cParallelFFT = 1 << 15 };
+
+// Transforms aCount rows of aLength doubles, aRow(i) returns row i. aTransform(a,aScratch) transforms
+// one row in place, aScratch points to aScratchSize doubles of the calling thread.
+template <class TRows, class TTransform>
+inline void fftRows(const TRows& aRow, int aCount, int aLength, const TTransform& aTransform, int aScratchSize) {
+  std::function<void(int)> aPass = [&](int i) {
+    // Scratch of the calling thread, kept for the next rows
+    static thread_local CVector<double> aScratch;
+    if (aScratch.size() < aScratchSize) aScratch.setSize(aScratchSize);
+    aTransform(aRow(i),aScratch.data());
+  };
+  if ((double)aCount*aLength < cParallelFFT) {
+    for (int i = 0; i < aCount; i++)
+      aPass(i);
+  }
+  else CThreadPool::parallelFor(aCount, aPass);
+}
+
+// Transforms the first aColumns complex columns of aCount rows, aTransform as for fftRows()
+template <class TRows, class TTransform>
+inline void fftColumns(const TRows& aRow, int aCount, int aColumns, const TTransform& aTransform, int aScratchSize) {
+  int aLength = 2*aCount;
+  // Padded like the rows of the plans, so the columns of a block do not share cache sets
+  int aStride = aLength+8;
+  int aBlocks = (aColumns+cColumnBlock-1)/cColumnBlock;
+  std::function<void(int)> aPass = [&](int aBlock) {
+    int j1 = aBlock*cColumnBlock;
+    int aWidth = (j1+cColumnBlock <= aColumns) ? cColumnBlock : aColumns-j1;
+    // Scratch of the calling thread, kept for the next blocks
+    static thread_local CVector<double> aBuffer;
+    if (aBuffer.size() < cColumnBlock*aStride+aScratchSize) aBuffer.setSize(cColumnBlock*aStride+aScratchSize);
+    double *t = aBuffer.data();
+    if (aWidth == cColumnBlock) {
+      for (int i = 0; i < aCount; i++) {
+        const double *a = aRow(i)+2*j1;
+        for (int k = 0; k < cColumnBlock; k++) {
+          t[k*aStride+2*i] = a[2*k];
+          t[k*aStride+2*i+1] = a[2*k+1];
+        }
+      }
+    }
+    else {
+      for (int i = 0; i < aCount; i++) {
+        const double *a = aRow(i)+2*j1;
+        for (int k = 0; k < aWidth; k++) {
+          t[k*aStride+2*i] = a[2*k];
+          t[k*aStride+2*i+1] = a[2*k+1];
+        }
+      }
+    }
+    for (int k = 0; k < aWidth; k++)
+      aTransform(t+k*aStride,t+cColumnBlock*aStride);
+    for (int i = 0; i < aCount; i++) {
+      double *a = aRow(i)+2*j1;
+      for (int k = 0; k < aWidth; k++) {
+        a[2*k] = t[k*aStride+2*i];
+        a[2*k+1] = t[k*aStride+2*i+1];
+      }
+    }
+  };
+  if ((double)aColumns*aLength < cParallelFFT) {
+    for (int i = 0; i < aBlocks; i++)
+      aPass(i);
+  }
+  else CThreadPool::parallelFor(aBlocks, aPass);
+}
+
+// The bit reversal table of the rows is kept in ip+2 as bitrv2 would leave it,
+// the columns are transformed in blocks, so t is no longer used
+inline void cdft2d(int n1, int n2, int isgn, double **a, double *t, int *ip, double *w) {
+  int n;
+  n = n1 << 1;
+  if (n < n2)  n = n2;
+  if (n > (ip[0] << 2)) makewt(n >> 2, ip, w);
+  bitrv2table(n2, ip + 2);
+  CVector<int> aColumnTable(n1 + 1);
+  bitrv2table(n1 << 1, aColumnTable.data());
+  const int *aRowTable = ip + 2;
+  std::function<double*(int)> aRow = [a](int i) { return a[i]; };
+  auto aRows = [=](double *b, double *) {
+    if (n2 > 4) bitrv2permute(n2, aRowTable, b);
+    if (isgn < 0) cftfsub(n2, b, w);
+    else cftbsub(n2, b, w);
+  };
+  auto aColumns = [&](double *b, double *) {
+    if ((n1 << 1) > 4) bitrv2permute(n1 << 1, aColumnTable.data(), b);
+    if (isgn < 0) cftfsub(n1 << 1, b, w);
+    else cftbsub(n1 << 1, b, w);
+  };
+  fftRows(aRow, n1, n2, aRows, 0);
+  fftColumns(aRow, n1, n2 >> 1, aColumns, 0);
+}
+
+// I M P L E M E N T A T I O N --------------------------------------------
+
+// C F F T 1 D ------------------------------------------------------------
+
+// constructor
+inline CFFT1D::CFFT1D(int aSize)
+  : mSize(aSize) {
+  if (aSize < 1) throw EFFTSize(aSize,1);
+  if ((aSize & (aSize-1)) == 0) {
+    mMethod = cOoura;
+    int n = 2*aSize;
+    CVector<int> aTable(2+n);
+    aTable(0) = 0;
+    mW.setSize((n >> 2) > 1 ? n >> 2 : 1);
+    if (n > 4) makewt(n >> 2,aTable.data(),mW.data());
+    mTable.setSize(aSize+1);
+    bitrv2table(n,mTable.data());
+  }
+  else if (goodSize(aSize) == aSize) {
+    mMethod = cMixedRadix;
+    int aCount = 0;
+    int aFactors[64];
+    for (int n = aSize; n > 1; aCount++) {
+      if (n % 4 == 0) aFactors[aCount] = 4;
+      else if (n % 2 == 0) aFactors[aCount] = 2;
+      else if (n % 3 == 0) aFactors[aCount] = 3;
+      else aFactors[aCount] = 5;
+      n /= aFactors[aCount];
+    }
+    mFactors.setSize(aCount);
+    // Each pass of length n needs n/r*(r-1) twiddle factors
+    int aTwiddles = 0;
+    for (int f = 0, n = aSize; f < aCount; n /= aFactors[f], f++) {
+      mFactors(f) = aFactors[f];
+      aTwiddles += n/aFactors[f]*(aFactors[f]-1);
+    }
+    mTwiddles.setSize(2*aTwiddles);
+    double* w = mTwiddles.data();
+    double aPi2 = 8.0*atan(1.0);
+    for (int f = 0, n = aSize; f < aCount; n /= aFactors[f], f++) {
+      int r = aFactors[f];
+      for (int p = 0; p < n/r; p++)
+        for (int u = 1; u < r; u++) {
+          double aAngle = aPi2*((double)p*u)/n;
+          *w++ = cos(aAngle);
+          *w++ = -sin(aAngle);
+        }
+    }
+  }
+  else {
+    mMethod = cBluestein;
+    int m = goodSize(2*aSize-1);
+    mInner = std::make_shared<const CFFT1D>(m);
+    // j^2 is reduced modulo 2*aSize, the chirp has this period, to keep the angles accurate
+    double aPi = 4.0*atan(1.0);
+    mChirp.setSize(2*aSize);
+    for (int j = 0; j < aSize; j++) {
+      double aAngle = aPi*(double)(((long long)j*j) % (2*aSize))/aSize;
+      mChirp(2*j) = cos(aAngle);
+      mChirp(2*j+1) = -sin(aAngle);
+    }
+    CVector<double> aScratch(mInner->scratchSize() > 0 ? mInner->scratchSize() : 1);
+    for (int k = 0; k < 2; k++) {
+      // The kernel conj(chirp) of the transform with aSign < 0 (k = 0) or its conjugate,
+      // wrapped around so that negative distances j-l of the convolution index it from the end
+      double aConj = (k == 0) ? 1.0 : -1.0;
+      mKernel[k].setSize(2*m);
+      mKernel[k] = 0;
+      double* h = mKernel[k].data();
+      for (int j = 0; j < aSize; j++) {
+        h[2*j] = mChirp(2*j);
+        h[2*j+1] = -aConj*mChirp(2*j+1);
+        if (j > 0) {
+          h[2*(m-j)] = h[2*j];
+          h[2*(m-j)+1] = h[2*j+1];
+        }
+      }
+      mInner->transform(h,-1,aScratch.data());
+      for (int j = 0; j < 2*m; j++)
+        h[j] /= m;
+    }
+  }
+}
+
+// transform
+inline void CFFT1D::transform(double* a, int aSign, double* aScratch) const {
+  switch (mMethod) {
+    case cOoura:
+      if (mSize == 1) return;
+      if (mSize > 2) bitrv2permute(2*mSize,mTable.data(),a);
+      if (aSign < 0) cftfsub(2*mSize,a,mW.data());
+      else cftbsub(2*mSize,a,mW.data());
+      break;
+    case cMixedRadix:
+      mixedRadix(a,aSign,aScratch);
+      break;
+    case cBluestein:
+      bluestein(a,aSign,aScratch);
+      break;
+  }
+}
+
+// size
+inline int CFFT1D::size() const {
+  return mSize;
+}
+
+// scratchSize
+inline int CFFT1D::scratchSize() const {
+  switch (mMethod) {
+    case cMixedRadix: return 2*mSize;
+    case cBluestein: return 2*mInner->size()+mInner->scratchSize();
+    default: return 0;
+  }
+}
+
+// goodSize
+inline int CFFT1D::goodSize(int aSize) {
+  for (int aResult = (aSize > 1) ? aSize : 1; ; aResult++) {
+    int n = aResult;
+    while (n % 2 == 0) n /= 2;
+    while (n % 3 == 0) n /= 3;
+    while (n % 5 == 0) n /= 5;
+    if (n == 1) return aResult;
+  }
+}
+
+// mixedRadix
+// A pass of radix r on a sequence of length n with stride s combines, for p < n/r and q < s, the r values
+// x(q+s*(p+t*n/r)) into y(q+s*(r*p+u)) = W^(p*u)*sum_t x(q+s*(p+t*n/r))*exp(-2*pi*i*t*u/r) with
+// W = exp(-2*pi*i/n), everything conjugated for aSign > 0. The next pass continues on the length n/r
+// with stride r*s, and the result ends up in natural order without a bit reversal.
+inline void CFFT1D::mixedRadix(double* a, int aSign, double* aScratch) const {
+  double* x = a;
+  double* y = aScratch;
+  const double* w = mTwiddles.data();
+  int n = mSize;
+  int s = 1;
+  for (int f = 0; f < mFactors.size(); f++) {
+    int r = mFactors(f);
+    int m = n/r;
+    switch (r) {
+      case 2: pass<2>(x,y,w,m,s,aSign); break;
+      case 3: pass<3>(x,y,w,m,s,aSign); break;
+      case 4: pass<4>(x,y,w,m,s,aSign); break;
+      default: pass<5>(x,y,w,m,s,aSign); break;
+    }
+    w += 2*(r-1)*m;
+    std::swap(x,y);
+    n = m;
+    s *= r;
+  }
+  if (x != a)
+    for (int i = 0; i < 2*mSize; i++)
+      a[i] = x[i];
+}
+
+// pass
+template <int r>
+inline void CFFT1D::pass(const double* x, double* y, const double* w, int m, int s, int aSign) {
+  // cos and sin of 2*pi/3, 2*pi/5 and 4*pi/5, the sines with the sign of the transform
+  const double c3 = -0.5;
+  const double s3 = aSign*0.86602540378443864676;
+  const double c51 = 0.30901699437494742410;
+  const double c52 = -0.80901699437494742410;
+  const double s51 = aSign*0.95105651629515357212;
+  const double s52 = aSign*0.58778525229247312917;
+  double aConj = (aSign < 0) ? 1.0 : -1.0;
+  // Distance of the inputs t and t+1 and of the outputs u and u+1
+  int aIn = 2*s*m;
+  int aOut = 2*s;
+  for (int p = 0; p < m; p++) {
+    const double* wp = w+2*(r-1)*p;
+    double wr[r],wi[r];
+    for (int u = 1; u < r; u++) {
+      wr[u] = wp[2*(u-1)];
+      wi[u] = aConj*wp[2*(u-1)+1];
+    }
+    for (int q = 0; q < s; q++) {
+      const double* x0 = x+2*(q+s*p);
+      double* y0 = y+2*(q+s*r*p);
+      double br[r],bi[r];
+      if (r == 2) {
+        br[0] = x0[0]+x0[aIn]; bi[0] = x0[1]+x0[aIn+1];
+        br[1] = x0[0]-x0[aIn]; bi[1] = x0[1]-x0[aIn+1];
+      }
+      else if (r == 3) {
+        double tr = x0[aIn]+x0[2*aIn], ti = x0[aIn+1]+x0[2*aIn+1];
+        double er = x0[0]+c3*tr, ei = x0[1]+c3*ti;
+        double dr = s3*(x0[aIn]-x0[2*aIn]), di = s3*(x0[aIn+1]-x0[2*aIn+1]);
+        br[0] = x0[0]+tr; bi[0] = x0[1]+ti;
+        br[1] = er-di; bi[1] = ei+dr;
+        br[2] = er+di; bi[2] = ei-dr;
+      }
+      else if (r == 4) {
+        double s0r = x0[0]+x0[2*aIn], s0i = x0[1]+x0[2*aIn+1];
+        double d0r = x0[0]-x0[2*aIn], d0i = x0[1]-x0[2*aIn+1];
+        double s1r = x0[aIn]+x0[3*aIn], s1i = x0[aIn+1]+x0[3*aIn+1];
+        // i*aSign*(x1-x3)
+        double d1r = -aSign*(x0[aIn+1]-x0[3*aIn+1]), d1i = aSign*(x0[aIn]-x0[3*aIn]);
+        br[0] = s0r+s1r; bi[0] = s0i+s1i;
+        br[1] = d0r+d1r; bi[1] = d0i+d1i;
+        br[2] = s0r-s1r; bi[2] = s0i-s1i;
+        br[3] = d0r-d1r; bi[3] = d0i-d1i;
+      }
+      else {
+        double b1r = x0[aIn]+x0[4*aIn], b1i = x0[aIn+1]+x0[4*aIn+1];
+        double b2r = x0[2*aIn]+x0[3*aIn], b2i = x0[2*aIn+1]+x0[3*aIn+1];
+        double d1r = x0[aIn]-x0[4*aIn], d1i = x0[aIn+1]-x0[4*aIn+1];
+        double d2r = x0[2*aIn]-x0[3*aIn], d2i = x0[2*aIn+1]-x0[3*aIn+1];
+        double e1r = x0[0]+c51*b1r+c52*b2r, e1i = x0[1]+c51*b1i+c52*b2i;
+        double e2r = x0[0]+c52*b1r+c51*b2r, e2i = x0[1]+c52*b1i+c51*b2i;
+        double f1r = s51*d1r+s52*d2r, f1i = s51*d1i+s52*d2i;
+        double f2r = s52*d1r-s51*d2r, f2i = s52*d1i-s51*d2i;
+        br[0] = x0[0]+b1r+b2r; bi[0] = x0[1]+b1i+b2i;
+        br[1] = e1r-f1i; bi[1] = e1i+f1r;
+        br[r-1] = e1r+f1i; bi[r-1] = e1i-f1r;
+        br[2] = e2r-f2i; bi[2] = e2i+f2r;
+        br[r-2] = e2r+f2i; bi[r-2] = e2i-f2r;
+      }
+      y0[0] = br[0];
+      y0[1] = bi[0];
+      for (int u = 1; u < r; u++) {
+        y0[u*aOut] = wr[u]*br[u]-wi[u]*bi[u];
+        y0[u*aOut+1] = wr[u]*bi[u]+wi[u]*br[u];
+      }
+    }
+  }
+}
+
+// bluestein
+// With j*k = (j^2+k^2-(k-j)^2)/2 the transform becomes X(k) = c(k)*sum_j (x(j)*c(j))*conj(c(k-j)) with the
+// chirp c(j) = exp(-i*pi*j^2/n), a convolution that mInner computes cyclically on the padded size
+inline void CFFT1D::bluestein(double* a, int aSign, double* aScratch) const {
+  int m = mInner->size();
+  double aConj = (aSign < 0) ? 1.0 : -1.0;
+  double* b = aScratch;
+  double* aInnerScratch = aScratch+2*m;
+  for (int j = 0; j < mSize; j++) {
+    double cr = mChirp(2*j);
+    double ci = aConj*mChirp(2*j+1);
+    b[2*j] = a[2*j]*cr-a[2*j+1]*ci;
+    b[2*j+1] = a[2*j]*ci+a[2*j+1]*cr;
+  }
+  for (int j = 2*mSize; j < 2*m; j++)
+    b[j] = 0;
+  mInner->transform(b,-1,aInnerScratch);
+  const double* h = mKernel[(aSign < 0) ? 0 : 1].data();
+  for (int j = 0; j < 2*m; j += 2) {
+    double aReal = b[j]*h[j]-b[j+1]*h[j+1];
+    b[j+1] = b[j]*h[j+1]+b[j+1]*h[j];
+    b[j] = aReal;
+  }
+  mInner->transform(b,1,aInnerScratch);
+  for (int k = 0; k < mSize; k++) {
+    double cr = mChirp(2*k);
+    double ci = aConj*mChirp(2*k+1);
+    a[2*k] = b[2*k]*cr-b[2*k+1]*ci;
+    a[2*k+1] = b[2*k]*ci+b[2*k+1]*cr;
+  }
+}
+
+// C F F T P L A N --------------------------------------------------------
+
+// constructor
+inline CFFTPlan::CFFTPlan(int aXSize, int aYSize)
+  : mXSize(aXSize),mYSize(aYSize),mPitch(2*aXSize+8),mRows(aXSize),mColumns(aYSize) {
+  mData.setSize(mPitch*aYSize);
+}
+
+// transform
+inline void CFFTPlan::transform(int aSign) {
+  auto aRow = [this](int y) { return row(y); };
+  auto aRows = [this,aSign](double* a, double* aScratch) { mRows.transform(a,aSign,aScratch); };
+  auto aColumns = [this,aSign](double* a, double* aScratch) { mColumns.transform(a,aSign,aScratch); };
+  fftRows(aRow,mYSize,2*mXSize,aRows,mRows.scratchSize());
+  fftColumns(aRow,mYSize,mXSize,aColumns,mColumns.scratchSize());
+}
+
+// row
+inline double* CFFTPlan::row(int y) const {
+  return mData.data()+mPitch*y;
+}
+
+// data
+inline double* CFFTPlan::data() const {
+  return mData.data();
+}
+
+// pitch
+inline int CFFTPlan::pitch() const {
+  return mPitch;
+}
+
+// xSize
+inline int CFFTPlan::xSize() const {
+  return mXSize;
+}
+
+// ySize
+inline int CFFTPlan::ySize() const {
+  return mYSize;
+}
+
+// cached
+inline CFFTPlan& CFFTPlan::cached(int aXSize, int aYSize) {
+  return cachedPlan<CFFTPlan>(aXSize,aYSize,cCached);
+}
+
+// C R E A L F F T P L A N ----------------------------------------------------
+
+// constructor
+inline CRealFFTPlan::CRealFFTPlan(int aXSize, int aYSize)
+  : mXSize(aXSize),mYSize(aYSize),mPitch((aXSize+2+7)/8*8),mRows(aXSize/2),mColumns(aYSize) {
+  if (aXSize < 2 || (aXSize & 1)) throw EFFTSize(aXSize,aYSize);
+  mData.setSize(mPitch*aYSize);
+  int aQuarter = aXSize/4;
+  mSplit.setSize(2*aQuarter+2);
+  double aDelta = 8.0*atan(1.0)/aXSize;
+  for (int u = 0; u <= aQuarter; u++) {
+    mSplit(2*u) = cos(aDelta*u);
+    mSplit(2*u+1) = sin(aDelta*u);
+  }
+}
+
+// forward
+inline void CRealFFTPlan::forward() {
+  auto aRow = [this](int y) { return row(y); };
+  auto aRows = [this](double* a, double* aScratch) { mRows.transform(a,-1,aScratch); };
+  auto aColumns = [this](double* a, double* aScratch) { mColumns.transform(a,-1,aScratch); };
+  fftRows(aRow,mYSize,mXSize,aRows,mRows.scratchSize());
+  for (int y = 0; y < mYSize; y++)
+    split(row(y));
+  fftColumns(aRow,mYSize,mXSize/2+1,aColumns,mColumns.scratchSize());
+}
+
+// inverse
+inline void CRealFFTPlan::inverse() {
+  auto aRow = [this](int y) { return row(y); };
+  auto aRows = [this](double* a, double* aScratch) { mRows.transform(a,1,aScratch); };
+  auto aColumns = [this](double* a, double* aScratch) { mColumns.transform(a,1,aScratch); };
+  fftColumns(aRow,mYSize,mXSize/2+1,aColumns,mColumns.scratchSize());
+  for (int y = 0; y < mYSize; y++)
+    merge(row(y));
+  fftRows(aRow,mYSize,mXSize,aRows,mRows.scratchSize());
+}
+
+// row
+inline double* CRealFFTPlan::row(int y) const {
+  return mData.data()+mPitch*y;
+}
+
+// data
+inline double* CRealFFTPlan::data() const {
+  return mData.data();
+}
+
+// pitch
+inline int CRealFFTPlan::pitch() const {
+  return mPitch;
+}
+
+// xSize
+inline int CRealFFTPlan::xSize() const {
+  return mXSize;
+}
+
+// ySize
+inline int CRealFFTPlan::ySize() const {
+  return mYSize;
+}
+
+// spectrumXSize
+inline int CRealFFTPlan::spectrumXSize() const {
+  return mXSize/2+1;
+}
+
+// cached
+inline CRealFFTPlan& CRealFFTPlan::cached(int aXSize, int aYSize) {
+  return cachedPlan<CRealFFTPlan>(aXSize,aYSize,cCached);
+}
+
+// P R O T E C T E D ------------------------------------------------------
+
+// split
+// With h = xSize()/2, E(u) = (Z(u)+conj(Z(h-u)))/2 is the spectrum of the even, O(u) = (Z(u)-conj(Z(h-u)))/2i
+// that of the odd values, and X(u) = E(u)+W^u*O(u), X(h-u) = conj(E(u)-W^u*O(u)) with W = exp(-2*pi*i/xSize())
+inline void CRealFFTPlan::split(double* a) {
+  int h = mXSize/2;
+  double aReal = a[0];
+  double aImaginary = a[1];
+  a[0] = aReal+aImaginary;
+  a[1] = 0;
+  a[2*h] = aReal-aImaginary;
+  a[2*h+1] = 0;
+  for (int u = 1; 2*u <= h; u++) {
+    int m = h-u;
+    double er = 0.5*(a[2*u]+a[2*m]);
+    double ei = 0.5*(a[2*u+1]-a[2*m+1]);
+    double orr = 0.5*(a[2*u+1]+a[2*m+1]);
+    double oi = -0.5*(a[2*u]-a[2*m]);
+    double wr = mSplit(2*u);
+    double wi = -mSplit(2*u+1);
+    double tr = wr*orr-wi*oi;
+    double ti = wr*oi+wi*orr;
+    a[2*u] = er+tr;
+    a[2*u+1] = ei+ti;
+    a[2*m] = er-tr;
+    a[2*m+1] = -(ei-ti);
+  }
+}
+
+// merge
+// Inverts split(), without the factors 1/2, so that inverse() scales by xSize()*ySize()
+inline void CRealFFTPlan::merge(double* a) {
+  int h = mXSize/2;
+  double aFirst = a[0];
+  double aLast = a[2*h];
+  a[0] = aFirst+aLast;
+  a[1] = aFirst-aLast;
+  for (int u = 1; 2*u <= h; u++) {
+    int m = h-u;
+    // E = X(u)+conj(X(h-u)), W^u*O = X(u)-conj(X(h-u))
+    double er = a[2*u]+a[2*m];
+    double ei = a[2*u+1]-a[2*m+1];
+    double tr = a[2*u]-a[2*m];
+    double ti = a[2*u+1]+a[2*m+1];
+    double wr = mSplit(2*u);
+    double wi = mSplit(2*u+1);
+    double orr = wr*tr-wi*ti;
+    double oi = wr*ti+wi*tr;
+    // Z(u) = E+i*O, Z(h-u) = conj(E)+i*conj(O)
+    a[2*u] = er-oi;
+    a[2*u+1] = ei+orr;
+    a[2*m] = er+oi;
+    a[2*m+1] = -ei+orr;
+  }
+}
+
+// cachedPlan
+// The list keeps the plans in the order of their last use, splicing does not move them in memory
+template <class TPlan>
+inline TPlan& cachedPlan(int aXSize, int aYSize, unsigned int aCount) {
+  static thread_local std::list<TPlan> aPlans;
+  for (typename std::list<TPlan>::iterator i = aPlans.begin(); i != aPlans.end(); ++i)
+    if (i->xSize() == aXSize && i->ySize() == aYSize) {
+      aPlans.splice(aPlans.begin(),aPlans,i);
+      return aPlans.front();
+    }
+  aPlans.emplace_front(aXSize,aYSize);
+  if (aPlans.size() > aCount) aPlans.pop_back();
+  return aPlans.front();
+}
+
+#endif
@@ -9,11 +9,21 @@
 #define CFILTER
 
 #include <math.h>
+#include <utility>
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <mutex>
 #include <NMath.h>
 #include <CVector.h>
 #include <CMatrix.h>
 #include <CTensor.h>
 #include <CTensor4D.h>
+#include <CThreadPool.h>
+#include <CFFTPlan.h>
+#if defined(__SSE2__) || defined(__AVX__)
+  #include <immintrin.h>
+#endif
 
 // CFilter is an extention of CVector. It has an additional property Delta
 // which shifts the data to the left (a vector always begins with index 0).
@@ -86,9 +96,32 @@ public:
   inline int BY() const;
   // Returns the sum of all filter co-efficients (absolutes)
   T sum() const;
+
+  // Relative error up to which the convolution may replace the filter by a sum of separable filters
+  // (see separate()). The default, defaultTolerance(), only lets filters that are separable (or of low rank)
+  // up to rounding take the separable passes; 0 always applies the filter as it is.
+  inline void setTolerance(double aTolerance);
+  inline double tolerance() const;
+  // A few units of the precision of T
+  static inline double defaultTolerance();
+  // The separable filters within tolerance() of the current coefficients, filter(x,y) ~ sum_k aFilterX[k](x)*aFilterY[k](y).
+  // The decomposition is kept and computed again only after the coefficients, the size, the center or the
+  // tolerance have changed. May be called by several threads at once. Returns the number of pairs.
+  int separable(std::vector<CFilter<T> >& aFilterX, std::vector<CFilter<T> >& aFilterY) const;
+  // Approximates the filter by as few separable filters as possible, filter(x,y) ~ sum_k aFilterX[k](x)*aFilterY[k](y),
+  // such that the error (Frobenius norm) stays within aTolerance times the norm of the filter. Returns the number of pairs.
+  int separate(std::vector<CFilter<T> >& aFilterX, std::vector<CFilter<T> >& aFilterY, double aTolerance) const;
 protected:
   int mDeltaX;
   int mDeltaY;
+  double mTolerance;
+  // The last decomposition and the state of the filter it was computed from
+  mutable std::mutex mSeparableGuard;
+  mutable std::vector<T> mSeparated;
+  mutable int mSeparatedXSize,mSeparatedYSize,mSeparatedDeltaX,mSeparatedDeltaY;
+  mutable double mSeparatedTolerance;
+  mutable std::vector<CFilter<T> > mSeparableX;
+  mutable std::vector<CFilter<T> > mSeparableY;
 };
 
 namespace NFilter {
@@ -107,42 +140,110 @@ namespace NFilter {
 
   // Linear 2D filtering
 
+  // Each function for matrices has a counterpart for views (CMatrixView), e.g. of the layers
+  // of a tensor, which reads and writes the viewed memory directly.
+  // The views of the source and the result must not overlap.
+
   // Convolution of the matrix aMatrix with aFilter, aFilter should be a separable filter
   // The result will be written into aMatrix, so its initial values will get lost
   template <class T> inline void filter(CMatrix<T>& aMatrix, const CFilter<T>& aFilterX, const CFilter<T>& aFilterY);
+  template <class T> inline void filter(const CMatrixView<T>& aMatrix, const CFilter<T>& aFilterX, const CFilter<T>& aFilterY);
   // Convolution of the matrix aMatrix with aFilter, aFilter must be separable
   // The initial values of aMatrix will persist.
   template <class T> inline void filter(const CMatrix<T>& aMatrix, CMatrix<T>& aResult, const CFilter<T>& aFilterX, const CFilter<T>& aFilterY);
+  template <class T> inline void filter(const CMatrixView<T>& aMatrix, const CMatrixView<T>& aResult, const CFilter<T>& aFilterX, const CFilter<T>& aFilterY);
 
   // Convolution of the matrix aMatrix with aFilter only in x-direction, aDummy can be set to 1
   // The result will be written into aMatrix, so its initial values will get lost
   template <class T> inline void filter(CMatrix<T>& aMatrix, const CFilter<T>& aFilter, const int aDummy);
+  template <class T> inline void filter(const CMatrixView<T>& aMatrix, const CFilter<T>& aFilter, const int aDummy);
   // Convolution of the matrix aMatrix with aFilter only in x-direction, aDummy can be set to 1
   // The initial values of aMatrix will persist.
-  template <class T> void filter(const CMatrix<T>& aMatrix, CMatrix<T>& aResult, const CFilter<T>& aFilter, const int aDummy);
+  template <class T> inline void filter(const CMatrix<T>& aMatrix, CMatrix<T>& aResult, const CFilter<T>& aFilter, const int aDummy);
+  template <class T> void filter(const CMatrixView<T>& aMatrix, const CMatrixView<T>& aResult, const CFilter<T>& aFilter, const int aDummy);
+  // The same for a matrix that may be changed: a halo of aMatrix that covers aFilter is filled with the mirrored
+  // values (see CMatrix::mirror()), so the rows are filtered without treating the rims. A const matrix is left as it is.
+  template <class T> inline void filter(CMatrix<T>& aMatrix, CMatrix<T>& aResult, const CFilter<T>& aFilter, const int aDummy);
+  // Convolution in x-direction, aMirror allows writing the mirrored values into the halo of aMatrix
+  template <class T> void filterX(const CMatrixView<T>& aMatrix, const CMatrixView<T>& aResult, const CFilter<T>& aFilter, bool aMirror);
+  // True if the halo of aMatrix covers everything a filter with range aA<=i<aB reads beyond the
+  // boundaries of a dimension of size aSize. The filter can then read the mirrored values from the halo.
+  template <class T> inline bool haloCovers(const CMatrixView<T>& aMatrix, int aA, int aB, int aSize);
+  // Convolution of one row of length aSize with aFilter, mirrored at the boundaries
+  template <class T> inline void filterRowX(const T* aRow, T* aResult, int aSize, const CFilter<T>& aFilter);
+  // Inner part of a row convolution: aResult[x] = sum_i aFilter[i]*aRow[x+i] for 0 <= x < aCount, 0 <= i < aTaps
+  // The float and double versions work on several output pixels per SSE/AVX register
+  template <class T> inline void convolveRow(const T* aRow, T* aResult, int aCount, const T* aFilter, int aTaps);
+  inline void convolveRow(const float* aRow, float* aResult, int aCount, const float* aFilter, int aTaps);
+  inline void convolveRow(const double* aRow, double* aResult, int aCount, const double* aFilter, int aTaps);
+  // Convolution of a whole aXSize x aYSize plane with aFilter in y-direction, mirrored at the boundaries,
+  // the rows of aPlane and aResult are aPitch and aResultPitch elements apart
+  template <class T> void filterPlaneY(const T* aPlane, int aPitch, T* aResult, int aResultPitch, int aXSize, int aYSize, const CFilter<T>& aFilter);
+  // One output row of a column convolution: aResult[x] = sum_j aFilter[j]*aRows[j][x] for 0 <= x < aCount, 0 <= j < aTaps
+  // The float and double versions work on several output pixels per SSE/AVX register
+  template <class T> inline void convolveColumns(const T* const* aRows, T* aResult, int aCount, const T* aFilter, int aTaps);
+  inline void convolveColumns(const float* const* aRows, float* aResult, int aCount, const float* aFilter, int aTaps);
+  inline void convolveColumns(const double* const* aRows, double* aResult, int aCount, const double* aFilter, int aTaps);
   // Convolution of the matrix aMatrix with aFilter only in y-direction, aDummy can be set to 1
   // The result will be written into aMatrix, so its initial values will get lost
   template <class T> inline void filter(CMatrix<T>& aMatrix, const int aDummy, const CFilter<T>& aFilter);
+  template <class T> inline void filter(const CMatrixView<T>& aMatrix, const int aDummy, const CFilter<T>& aFilter);
   // Convolution of the matrix aMatrix with aFilter only in y-direction, aDummy can be set to 1
   // The initial values of aMatrix will persist.
-  template <class T> void filter(const CMatrix<T>& aMatrix, CMatrix<T>& aResult, const int aDummy, const CFilter<T>& aFilter);
+  template <class T> inline void filter(const CMatrix<T>& aMatrix, CMatrix<T>& aResult, const int aDummy, const CFilter<T>& aFilter);
+  template <class T> void filter(const CMatrixView<T>& aMatrix, const CMatrixView<T>& aResult, const int aDummy, const CFilter<T>& aFilter);
 
   // Convolution of the matrix aMatrix with aFilter
   // The result will be written to aMatrix, so its initial values will get lost
   template <class T> inline void filter(CMatrix<T>& aMatrix, const CFilter2D<T>& aFilter);
+  template <class T> inline void filter(const CMatrixView<T>& aMatrix, const CFilter2D<T>& aFilter);
   // Convolution of the matrix aMatrix with aFilter, the initial values of aMatrix will persist
-  template <class T> void filter(const CMatrix<T>& aMatrix, CMatrix<T>& aResult, const CFilter2D<T>& aFilter);
+  template <class T> inline void filter(const CMatrix<T>& aMatrix, CMatrix<T>& aResult, const CFilter2D<T>& aFilter);
+  template <class T> void filter(const CMatrixView<T>& aMatrix, const CMatrixView<T>& aResult, const CFilter2D<T>& aFilter);
+  // The same for a matrix that may be changed, a halo of aMatrix that covers aFilter is filled with the mirrored values
+  template <class T> inline void filter(CMatrix<T>& aMatrix, CMatrix<T>& aResult, const CFilter2D<T>& aFilter);
+  // Convolution with aFilter, aMirror allows writing the mirrored values into the halo of aMatrix
+  template <class T> void filter2D(const CMatrixView<T>& aMatrix, const CMatrixView<T>& aResult, const CFilter2D<T>& aFilter, bool aMirror);
+  // Applies aFilter as a sum of separable passes if its decomposition within aFilter.tolerance() (see CFilter2D::separable())
+  // needs fewer than aBudget operations per pixel, otherwise returns false
+  template <class T> bool filterSeparable(const CMatrixView<T>& aMatrix, const CMatrixView<T>& aResult, const CFilter2D<T>& aFilter, double aBudget);
+  // Convolution of the matrix aMatrix with aFilter via FFT, mirrored at the boundaries. The matrix is split into tiles
+  // that are transformed separately (overlap-save), two tiles at a time as real and imaginary part of one transform.
+  template <class T> inline void filterFFT(const CMatrix<T>& aMatrix, CMatrix<T>& aResult, const CFilter2D<T>& aFilter);
+  template <class T> void filterFFT(const CMatrixView<T>& aMatrix, const CMatrixView<T>& aResult, const CFilter2D<T>& aFilter);
+  // Side length of the FFT tiles of a dimension of aSize pixels for a filter of aTaps taps
+  inline int fftSize(int aSize, int aTaps);
+  // Operations per pixel of filterFFT() relative to one multiply-add of the direct convolution
+  inline double fftCost(int aXSize, int aYSize, int aXTaps, int aYTaps);
+  // Convolution of the matrix aMatrix with aFilter without rims: aMatrix must be readable as far as aFilter
+  // reaches beyond its boundaries. The matrix is split into tiles that are filtered in parallel.
+  template <class T> void convolve2D(const CMatrixView<T>& aMatrix, const CMatrixView<T>& aResult, const CFilter2D<T>& aFilter);
+  // One output row of a 2D convolution: aResult[x] = sum_j sum_i aFilter[j*aXTaps+i]*aSource[j*aPitch+x+i]
+  // for 0 <= x < aCount. cTaps > 0 fixes a cTaps x cTaps filter at compile time, so the tap loops are unrolled.
+  // The float and double versions work on several output pixels per SSE/AVX register
+  template <int cTaps, class T> inline void convolveRow2D(const T* aSource, int aPitch, T* aResult, int aCount, const T* aFilter, int aXTaps, int aYTaps);
+  template <int cTaps> inline void convolveRow2D(const float* aSource, int aPitch, float* aResult, int aCount, const float* aFilter, int aXTaps, int aYTaps);
+  template <int cTaps> inline void convolveRow2D(const double* aSource, int aPitch, double* aResult, int aCount, const double* aFilter, int aXTaps, int aYTaps);
+  // Index i of a dimension of size aSize mirrored at the boundaries as often as necessary
+  inline int reflect(int i, int aSize);
 
   // Convolution with a rectangle -> approximation of Gaussian
   template <class T> inline void boxFilterX(CMatrix<T>& aMatrix, int aWidth);
-  template <class T> void boxFilterX(const CMatrix<T>& aMatrix, CMatrix<T>& aResult, int aWidth);
+  template <class T> inline void boxFilterX(const CMatrixView<T>& aMatrix, int aWidth);
+  template <class T> inline void boxFilterX(const CMatrix<T>& aMatrix, CMatrix<T>& aResult, int aWidth);
+  template <class T> void boxFilterX(const CMatrixView<T>& aMatrix, const CMatrixView<T>& aResult, int aWidth);
   template <class T> inline void boxFilterY(CMatrix<T>& aMatrix, int aWidth);
-  template <class T> void boxFilterY(const CMatrix<T>& aMatrix, CMatrix<T>& aResult, int aWidth);
+  template <class T> inline void boxFilterY(const CMatrixView<T>& aMatrix, int aWidth);
+  template <class T> inline void boxFilterY(const CMatrix<T>& aMatrix, CMatrix<T>& aResult, int aWidth);
+  template <class T> void boxFilterY(const CMatrixView<T>& aMatrix, const CMatrixView<T>& aResult, int aWidth);
 
   // Recursive filter -> approximation of Gaussian
-  template <class T> void recursiveSmoothX(CMatrix<T>& aMatrix, float aSigma);
-  template <class T> void recursiveSmoothY(CMatrix<T>& aMatrix, float aSigma);
+  template <class T> inline void recursiveSmoothX(CMatrix<T>& aMatrix, float aSigma);
+  template <class T> void recursiveSmoothX(const CMatrixView<T>& aMatrix, float aSigma);
+  template <class T> inline void recursiveSmoothY(CMatrix<T>& aMatrix, float aSigma);
+  template <class T> void recursiveSmoothY(const CMatrixView<T>& aMatrix, float aSigma);
   template <class T> inline void recursiveSmooth(CMatrix<T>& aMatrix, float aSigma);
+  template <class T> inline void recursiveSmooth(const CMatrixView<T>& aMatrix, float aSigma);
 
   // Linear 3D filtering
 
@@ -345,10 +446,10 @@ inline T& CFilter<T>::operator[](const int aIndex) const {
 template <class T>
 CFilter<T>& CFilter<T>::operator=(const CFilter<T>& aCopyFrom) {
   if (this != &aCopyFrom) {
-    delete[] this->mData;
+    NMemory::release(this->mData);
     this->mSize = aCopyFrom.mSize;
     mDelta = aCopyFrom.mDelta;
-    this->mData = new T[this->mSize];
+    this->mData = NMemory::allocate<T>(this->mSize);
     for (register int i = 0; i < this->mSize; i++)
       this->mData[i] = aCopyFrom.mData[i];
   }
@@ -393,28 +494,37 @@ inline void CFilter<T>::shift(int aDelta) {
 // constructor
 template <class T>
 inline CFilter2D<T>::CFilter2D()
-  : CMatrix<T>(),mDeltaX(0),mDeltaY(0) {
+  : CMatrix<T>(),mDeltaX(0),mDeltaY(0),mTolerance(defaultTolerance()),mSeparatedXSize(-1) {
 }
 
 template <class T>
 inline CFilter2D<T>::CFilter2D(const int aXSize, const int aYSize, const int aDeltaX, const int aDeltaY)
-  : CMatrix<T>(aXSize,aYSize),mDeltaX(aDeltaX),mDeltaY(aDeltaY) {
+  : CMatrix<T>(aXSize,aYSize),mDeltaX(aDeltaX),mDeltaY(aDeltaY),mTolerance(defaultTolerance()),mSeparatedXSize(-1) {
 }
 
 // copy constructor
 template <class T>
 CFilter2D<T>::CFilter2D(const CFilter2D<T>& aCopyFrom)
-  : CMatrix<T>(aCopyFrom.mXSize,aCopyFrom.mYSize),mDeltaX(aCopyFrom.mDeltaX,aCopyFrom.mDeltaY) {
-  for (int i = 0; i < this->mXSize*this->mYSize; i++)
-    this->mData[i] = aCopyFrom.mData[i];
+  : CMatrix<T>(aCopyFrom),mDeltaX(aCopyFrom.mDeltaX),mDeltaY(aCopyFrom.mDeltaY),mTolerance(aCopyFrom.mTolerance) {
+  std::lock_guard<std::mutex> aLock(aCopyFrom.mSeparableGuard);
+  mSeparated = aCopyFrom.mSeparated;
+  mSeparatedXSize = aCopyFrom.mSeparatedXSize;
+  mSeparatedYSize = aCopyFrom.mSeparatedYSize;
+  mSeparatedDeltaX = aCopyFrom.mSeparatedDeltaX;
+  mSeparatedDeltaY = aCopyFrom.mSeparatedDeltaY;
+  mSeparatedTolerance = aCopyFrom.mSeparatedTolerance;
+  mSeparableX = aCopyFrom.mSeparableX;
+  mSeparableY = aCopyFrom.mSeparableY;
 }
 
 // constructor initialized by a matrix
 template <class T>
 CFilter2D<T>::CFilter2D(const CMatrix<T>& aCopyFrom, const int aDeltaX, const int aDeltaY)
-  : CMatrix<T>(aCopyFrom.xSize(),aCopyFrom.ySize()),mDeltaX(aDeltaX),mDeltaY(aDeltaY) {
-  for (register int i = 0; i < this->mXSize*this->mYSize; i++)
-    this->mData[i] = aCopyFrom.data()[i];
+  : CMatrix<T>(aCopyFrom.xSize(),aCopyFrom.ySize()),mDeltaX(aDeltaX),mDeltaY(aDeltaY),mTolerance(defaultTolerance()),
+    mSeparatedXSize(-1) {
+  for (int y = 0; y < this->mYSize; y++)
+    for (register int x = 0; x < this->mXSize; x++)
+      CMatrix<T>::operator()(x,y) = aCopyFrom(x,y);
 }
 
 // normalizeSum
@@ -450,14 +560,14 @@ inline T& CFilter2D<T>::operator()(const int ax, const int ay) const {
 template <class T>
 CFilter2D<T>& CFilter2D<T>::operator=(const CFilter2D<T>& aCopyFrom) {
   if (this != &aCopyFrom) {
-    delete[] this->mData;
-    this->mXSize = aCopyFrom.mXSize;
-    this->mYSize = aCopyFrom.mYSize;
+    // The matrix takes care of the layout and the memory
+    CMatrix<T>::operator=(aCopyFrom);
     mDeltaX = aCopyFrom.mDeltaX;
     mDeltaY = aCopyFrom.mDeltaY;
-    this->mData = new T[this->mXSize*this->mYSize];
-    for (register int i = 0; i < this->mXSize*this->mYSize; i++)
-      this->mData[i] = aCopyFrom.mData[i];
+    mTolerance = aCopyFrom.mTolerance;
+    // The decomposition is computed anew when needed
+    std::lock_guard<std::mutex> aLock(mSeparableGuard);
+    mSeparatedXSize = -1;
   }
   return *this;
 }
@@ -507,6 +617,142 @@ T CFilter2D<T>::sum() const {
   return aResult;
 }
 
+// setTolerance
+template <class T>
+inline void CFilter2D<T>::setTolerance(double aTolerance) {
+  mTolerance = aTolerance;
+}
+
+// tolerance
+template <class T>
+inline double CFilter2D<T>::tolerance() const {
+  return mTolerance;
+}
+
+// defaultTolerance
+// The decomposition is computed in double, a filter of exact rank k stored in T leaves
+// singular values beyond k of about the rounding of its coefficients
+template <class T>
+inline double CFilter2D<T>::defaultTolerance() {
+  return 16*std::numeric_limits<T>::epsilon();
+}
+
+// separable
+// The coefficients are compared with those of the last decomposition, so writes of any kind
+// (operator(), fill(), setSize(), data()) are noticed
+template <class T>
+int CFilter2D<T>::separable(std::vector<CFilter<T> >& aFilterX, std::vector<CFilter<T> >& aFilterY) const {
+  std::lock_guard<std::mutex> aLock(mSeparableGuard);
+  int aSize = this->mXSize*this->mYSize;
+  if (mSeparatedXSize != this->mXSize || mSeparatedYSize != this->mYSize || mSeparatedDeltaX != mDeltaX ||
+      mSeparatedDeltaY != mDeltaY || mSeparatedTolerance != mTolerance ||
+      !std::equal(this->mData,this->mData+aSize,mSeparated.begin())) {
+    separate(mSeparableX,mSeparableY,mTolerance);
+    mSeparated.assign(this->mData,this->mData+aSize);
+    mSeparatedXSize = this->mXSize;
+    mSeparatedYSize = this->mYSize;
+    mSeparatedDeltaX = mDeltaX;
+    mSeparatedDeltaY = mDeltaY;
+    mSeparatedTolerance = mTolerance;
+  }
+  aFilterX = mSeparableX;
+  aFilterY = mSeparableY;
+  return aFilterX.size();
+}
+
+// separate
+// One-sided Jacobi SVD in double precision: plane rotations make the columns of the filter matrix
+// orthogonal, the rotated columns are then S(k)*u_k and the accumulated rotations hold the v_k.
+// The filter is decomposed transposed if it is wider than high, so there are fewer columns to pair.
+template <class T>
+int CFilter2D<T>::separate(std::vector<CFilter<T> >& aFilterX, std::vector<CFilter<T> >& aFilterY, double aTolerance) const {
+  aFilterX.clear();
+  aFilterY.clear();
+  bool aTransposed = (this->mXSize > this->mYSize);
+  int aColumns = aTransposed ? this->mYSize : this->mXSize;
+  int aRows = aTransposed ? this->mXSize : this->mYSize;
+  if (aColumns == 0) return 0;
+  // Column k of the matrix is A[k*aRows...], of the rotations V[k*aColumns...]
+  std::vector<double> A(aColumns*aRows),V(aColumns*aColumns,0.0);
+  for (int y = 0; y < this->mYSize; y++)
+    for (int x = 0; x < this->mXSize; x++) {
+      if (aTransposed) A[y*aRows+x] = CMatrix<T>::operator()(x,y);
+      else A[x*aRows+y] = CMatrix<T>::operator()(x,y);
+    }
+  for (int k = 0; k < aColumns; k++)
+    V[k*aColumns+k] = 1.0;
+  for (int aSweep = 0; aSweep < 60; aSweep++) {
+    bool aRotated = false;
+    for (int p = 0; p < aColumns-1; p++)
+      for (int q = p+1; q < aColumns; q++) {
+        double* a = &A[p*aRows];
+        double* b = &A[q*aRows];
+        double aAlpha = 0.0, aBeta = 0.0, aGamma = 0.0;
+        for (int i = 0; i < aRows; i++) {
+          aAlpha += a[i]*a[i];
+          aBeta += b[i]*b[i];
+          aGamma += a[i]*b[i];
+        }
+        if (aGamma == 0.0 || fabs(aGamma) <= 1e-15*sqrt(aAlpha*aBeta)) continue;
+        aRotated = true;
+        double aZeta = (aBeta-aAlpha)/(2.0*aGamma);
+        double t = ((aZeta >= 0) ? 1.0 : -1.0)/(fabs(aZeta)+sqrt(1.0+aZeta*aZeta));
+        double c = 1.0/sqrt(1.0+t*t);
+        double s = c*t;
+        for (int i = 0; i < aRows; i++) {
+          double aA = a[i];
+          a[i] = c*aA-s*b[i];
+          b[i] = s*aA+c*b[i];
+        }
+        double* v = &V[p*aColumns];
+        double* w = &V[q*aColumns];
+        for (int i = 0; i < aColumns; i++) {
+          double aV = v[i];
+          v[i] = c*aV-s*w[i];
+          w[i] = s*aV+c*w[i];
+        }
+      }
+    if (!aRotated) break;
+  }
+  // Singular values in descending order
+  std::vector<double> S(aColumns);
+  std::vector<int> aOrder(aColumns);
+  for (int k = 0; k < aColumns; k++) {
+    double aNorm = 0.0;
+    for (int i = 0; i < aRows; i++)
+      aNorm += A[k*aRows+i]*A[k*aRows+i];
+    S[k] = sqrt(aNorm);
+    aOrder[k] = k;
+  }
+  std::sort(aOrder.begin(),aOrder.end(),[&S](int i, int j) { return S[i] > S[j]; });
+  // The squared error of a rank k approximation is the sum of the squared singular values beyond k
+  double aTotal = 0.0;
+  for (int k = 0; k < aColumns; k++)
+    aTotal += S[k]*S[k];
+  int aRank = 0;
+  double aRest = aTotal;
+  while (aRank < aColumns && aRest > aTolerance*aTolerance*aTotal) {
+    aRest -= S[aOrder[aRank]]*S[aOrder[aRank]];
+    aRank++;
+  }
+  // filter(column,row) = sum_k A_k(row)*V_k(column) with the rotated columns A_k = S(k)*u_k,
+  // so the singular value goes into the y-filter (or the x-filter if transposed)
+  aFilterX.reserve(aRank);
+  aFilterY.reserve(aRank);
+  for (int r = 0; r < aRank; r++) {
+    int k = aOrder[r];
+    CFilter<T> aX(this->mXSize,mDeltaX);
+    CFilter<T> aY(this->mYSize,mDeltaY);
+    for (int x = 0; x < this->mXSize; x++)
+      aX[x-mDeltaX] = aTransposed ? A[k*aRows+x] : V[k*aColumns+x];
+    for (int y = 0; y < this->mYSize; y++)
+      aY[y-mDeltaY] = aTransposed ? V[k*aColumns+y] : A[k*aRows+y];
+    aFilterX.push_back(aX);
+    aFilterY.push_back(aY);
+  }
+  return aRank;
+}
+
 // C G A U S S -----------------------------------------------------------------
 template <class T>
 CGauss<T>::CGauss(const int aSize, const int aDegreeOfDerivative)
@@ -979,8 +1225,9 @@ namespace NFilter {
 
 template <class T>
 inline void filter(CVector<T>& aVector, const CFilter<T>& aFilter) {
-  CVector<T> oldVector(aVector);
-  filter(oldVector,aVector,aFilter);
+  CVector<T> aResult(aVector.size());
+  filter(aVector,aResult,aFilter);
+  aVector = std::move(aResult);
 }
 
 template <class T>
@@ -1014,8 +1261,9 @@ void filter(const CVector<T>& aVector, CVector<T>& aResult, const CFilter<T>& aF
 // boxfilter
 template <class T>
 inline void boxFilter(CVector<T>& aVector, int aWidth) {
-  CVector<T> aTemp(aVector);
-  boxFilter(aTemp,aVector,aWidth);
+  CVector<T> aTemp(aVector.size());
+  boxFilter(aVector,aTemp,aWidth);
+  aVector = std::move(aTemp);
 }
 
 template <class T>
@@ -1055,207 +1303,747 @@ inline void filter(CMatrix<T>& aMatrix, const CFilter<T>& aFilterX, const CFilte
   filter(tempMatrix,aMatrix,1,aFilterY);
 }
 
+template <class T>
+inline void filter(const CMatrixView<T>& aMatrix, const CFilter<T>& aFilterX, const CFilter<T>& aFilterY) {
+  CMatrix<T> tempMatrix(aMatrix.xSize(),aMatrix.ySize());
+  filter(aMatrix,tempMatrix.view(),aFilterX,1);
+  filter(tempMatrix.view(),aMatrix,1,aFilterY);
+}
+
 template <class T>
 inline void filter(const CMatrix<T>& aMatrix, CMatrix<T>& aResult, const CFilter<T>& aFilterX, const CFilter<T>& aFilterY) {
+  filter(aMatrix.view(),aResult.view(),aFilterX,aFilterY);
+}
+
+template <class T>
+inline void filter(const CMatrixView<T>& aMatrix, const CMatrixView<T>& aResult, const CFilter<T>& aFilterX, const CFilter<T>& aFilterY) {
   CMatrix<T> tempMatrix(aMatrix.xSize(),aMatrix.ySize());
-  filter(aMatrix,tempMatrix,aFilterX,1);
-  filter(tempMatrix,aResult,1,aFilterY);
+  filter(aMatrix,tempMatrix.view(),aFilterX,1);
+  filter(tempMatrix.view(),aResult,1,aFilterY);
 }
 
 template <class T>
 inline void filter(CMatrix<T>& aMatrix, const CFilter<T>& aFilter, const int aDummy) {
-  CMatrix<T> tempMatrix(aMatrix.xSize(),aMatrix.ySize());
+  // The result takes the halo of aMatrix, so the buffers can be exchanged instead of copied
+  CMatrix<T> tempMatrix;
+  tempMatrix.setHalo(aMatrix.halo());
+  tempMatrix.setSize(aMatrix.xSize(),aMatrix.ySize());
   filter(aMatrix,tempMatrix,aFilter,1);
-  aMatrix = tempMatrix;
+  aMatrix = std::move(tempMatrix);
+}
+
+template <class T>
+inline void filter(const CMatrixView<T>& aMatrix, const CFilter<T>& aFilter, const int aDummy) {
+  // aMatrix is overwritten anyway, so its halo may be written as well
+  CMatrix<T> tempMatrix(aMatrix.xSize(),aMatrix.ySize());
+  filterX(aMatrix,tempMatrix.view(),aFilter,true);
+  aMatrix.copy(tempMatrix.view());
+}
+
+template <class T>
+inline void filter(const CMatrix<T>& aMatrix, CMatrix<T>& aResult, const CFilter<T>& aFilter, const int aDummy) {
+  filter(aMatrix.view(),aResult.view(),aFilter,aDummy);
 }
 
 template <class T>
-void filter(const CMatrix<T>& aMatrix, CMatrix<T>& aResult, const CFilter<T>& aFilter, const int aDummy) {
+void filter(const CMatrixView<T>& aMatrix, const CMatrixView<T>& aResult, const CFilter<T>& aFilter, const int aDummy) {
+  filterX(aMatrix,aResult,aFilter,false);
+}
+
+template <class T>
+inline void filter(CMatrix<T>& aMatrix, CMatrix<T>& aResult, const CFilter<T>& aFilter, const int aDummy) {
+  filterX(aMatrix.view(),aResult.view(),aFilter,true);
+}
+
+template <class T>
+void filterX(const CMatrixView<T>& aMatrix, const CMatrixView<T>& aResult, const CFilter<T>& aFilter, bool aMirror) {
   if (aResult.xSize() != aMatrix.xSize() || aResult.ySize() != aMatrix.ySize())
     throw EFilterIncompatibleSize(aMatrix.xSize()*aMatrix.ySize(),aResult.xSize()*aResult.ySize());
+  // With a halo each row is a single convolution without rims
+  if (aMirror && haloCovers(aMatrix,aFilter.A(),aFilter.B(),aMatrix.xSize())) {
+    aMatrix.mirror();
+    for (int y = 0; y < aMatrix.ySize(); y++)
+      convolveRow(aMatrix.data()+y*aMatrix.pitch()+aFilter.A(),aResult.data()+y*aResult.pitch(),aMatrix.xSize(),&aFilter[aFilter.A()],aFilter.B()-aFilter.A());
+  }
+  else for (int y = 0; y < aMatrix.ySize(); y++)
+    filterRowX(aMatrix.data()+y*aMatrix.pitch(),aResult.data()+y*aResult.pitch(),aMatrix.xSize(),aFilter);
+}
+
+template <class T>
+inline bool haloCovers(const CMatrixView<T>& aMatrix, int aA, int aB, int aSize) {
+  // Values more than aSize pixels beyond the boundary cannot be mirrored
+  int aReach = (-aA > aB-1) ? -aA : aB-1;
+  return aReach <= aMatrix.halo() && aReach <= aSize;
+}
+
+template <class T>
+inline void filterRowX(const T* aRow, T* aResult, int aSize, const CFilter<T>& aFilter) {
   int x1 = -aFilter.A();
-  int x2 = aMatrix.xSize()-aFilter.B();
-  int a2Size = 2*aMatrix.xSize()-1;
-  aResult = 0;
-  for (int y = 0; y < aMatrix.ySize(); y++) {
-    int aOffset = y*aMatrix.xSize();
-    // Left rim
-    for (int x = 0; x < x1; x++)
-      for (int i = aFilter.A(); i < aFilter.B(); i++) {
-        if (x+i < 0) aResult.data()[aOffset+x] += aFilter[i]*aMatrix.data()[aOffset-1-x-i];
-        else if (x+i >= aMatrix.xSize()) aResult.data()[aOffset+x] += aFilter[i]*aMatrix.data()[aOffset+a2Size-x-i];
-        else aResult.data()[aOffset+x] += aFilter[i]*aMatrix.data()[aOffset+x+i];
-      }
-    // Center
-    for (int x = x1; x < x2; x++)
-      for (int i = aFilter.A(); i < aFilter.B(); i++)
-        aResult.data()[aOffset+x] += aFilter[i]*aMatrix.data()[aOffset+x+i];
-    // Right rim
-    for (int x = x2; x < aMatrix.xSize(); x++)
-      for (int i = aFilter.A(); i < aFilter.B(); i++) {
-        if (x+i < 0) aResult.data()[aOffset+x] += aFilter[i]*aMatrix.data()[aOffset-1-x-i];
-        else if (x+i >= aMatrix.xSize()) aResult.data()[aOffset+x] += aFilter[i]*aMatrix.data()[aOffset+a2Size-x-i];
-        else aResult.data()[aOffset+x] += aFilter[i]*aMatrix.data()[aOffset+x+i];
-      }
+  int x2 = aSize-aFilter.B();
+  // Filters wider than the row have no center part
+  if (x1 > aSize) x1 = aSize;
+  if (x2 < x1) x2 = x1;
+  int a2Size = 2*aSize-1;
+  // Left rim
+  for (int x = 0; x < x1; x++) {
+    T aSum = 0;
+    for (int i = aFilter.A(); i < aFilter.B(); i++) {
+      if (x+i < 0) aSum += aFilter[i]*aRow[-1-x-i];
+      else if (x+i >= aSize) aSum += aFilter[i]*aRow[a2Size-x-i];
+      else aSum += aFilter[i]*aRow[x+i];
+    }
+    aResult[x] = aSum;
+  }
+  // Center
+  convolveRow(aRow+x1+aFilter.A(),aResult+x1,x2-x1,&aFilter[aFilter.A()],aFilter.B()-aFilter.A());
+  // Right rim
+  for (int x = x2; x < aSize; x++) {
+    T aSum = 0;
+    for (int i = aFilter.A(); i < aFilter.B(); i++) {
+      if (x+i < 0) aSum += aFilter[i]*aRow[-1-x-i];
+      else if (x+i >= aSize) aSum += aFilter[i]*aRow[a2Size-x-i];
+      else aSum += aFilter[i]*aRow[x+i];
+    }
+    aResult[x] = aSum;
+  }
+}
+
+template <class T>
+inline void convolveRow(const T* aRow, T* aResult, int aCount, const T* aFilter, int aTaps) {
+  for (int x = 0; x < aCount; x++) {
+    T aSum = 0;
+    for (int i = 0; i < aTaps; i++)
+      aSum += aFilter[i]*aRow[x+i];
+    aResult[x] = aSum;
+  }
+}
+
+// The vectorized versions accumulate the taps of each pixel in the same order as the
+// scalar loop with separate multiplications and additions, so all versions agree exactly
+inline void convolveRow(const float* aRow, float* aResult, int aCount, const float* aFilter, int aTaps) {
+  int x = 0;
+  #ifdef __AVX__
+  for (; x+16 <= aCount; x += 16) {
+    __m256 aSum0 = _mm256_setzero_ps();
+    __m256 aSum1 = _mm256_setzero_ps();
+    for (int i = 0; i < aTaps; i++) {
+      __m256 aTap = _mm256_set1_ps(aFilter[i]);
+      aSum0 = _mm256_add_ps(aSum0,_mm256_mul_ps(aTap,_mm256_loadu_ps(aRow+x+i)));
+      aSum1 = _mm256_add_ps(aSum1,_mm256_mul_ps(aTap,_mm256_loadu_ps(aRow+x+8+i)));
+    }
+    _mm256_storeu_ps(aResult+x,aSum0);
+    _mm256_storeu_ps(aResult+x+8,aSum1);
+  }
+  #endif
+  #ifdef __SSE2__
+  for (; x+8 <= aCount; x += 8) {
+    __m128 aSum0 = _mm_setzero_ps();
+    __m128 aSum1 = _mm_setzero_ps();
+    for (int i = 0; i < aTaps; i++) {
+      __m128 aTap = _mm_set1_ps(aFilter[i]);
+      aSum0 = _mm_add_ps(aSum0,_mm_mul_ps(aTap,_mm_loadu_ps(aRow+x+i)));
+      aSum1 = _mm_add_ps(aSum1,_mm_mul_ps(aTap,_mm_loadu_ps(aRow+x+4+i)));
+    }
+    _mm_storeu_ps(aResult+x,aSum0);
+    _mm_storeu_ps(aResult+x+4,aSum1);
+  }
+  #endif
+  for (; x < aCount; x++) {
+    float aSum = 0;
+    for (int i = 0; i < aTaps; i++)
+      aSum += aFilter[i]*aRow[x+i];
+    aResult[x] = aSum;
+  }
+}
+
+inline void convolveRow(const double* aRow, double* aResult, int aCount, const double* aFilter, int aTaps) {
+  int x = 0;
+  #ifdef __AVX__
+  for (; x+8 <= aCount; x += 8) {
+    __m256d aSum0 = _mm256_setzero_pd();
+    __m256d aSum1 = _mm256_setzero_pd();
+    for (int i = 0; i < aTaps; i++) {
+      __m256d aTap = _mm256_set1_pd(aFilter[i]);
+      aSum0 = _mm256_add_pd(aSum0,_mm256_mul_pd(aTap,_mm256_loadu_pd(aRow+x+i)));
+      aSum1 = _mm256_add_pd(aSum1,_mm256_mul_pd(aTap,_mm256_loadu_pd(aRow+x+4+i)));
+    }
+    _mm256_storeu_pd(aResult+x,aSum0);
+    _mm256_storeu_pd(aResult+x+4,aSum1);
+  }
+  #endif
+  #ifdef __SSE2__
+  for (; x+4 <= aCount; x += 4) {
+    __m128d aSum0 = _mm_setzero_pd();
+    __m128d aSum1 = _mm_setzero_pd();
+    for (int i = 0; i < aTaps; i++) {
+      __m128d aTap = _mm_set1_pd(aFilter[i]);
+      aSum0 = _mm_add_pd(aSum0,_mm_mul_pd(aTap,_mm_loadu_pd(aRow+x+i)));
+      aSum1 = _mm_add_pd(aSum1,_mm_mul_pd(aTap,_mm_loadu_pd(aRow+x+2+i)));
+    }
+    _mm_storeu_pd(aResult+x,aSum0);
+    _mm_storeu_pd(aResult+x+2,aSum1);
+  }
+  #endif
+  for (; x < aCount; x++) {
+    double aSum = 0;
+    for (int i = 0; i < aTaps; i++)
+      aSum += aFilter[i]*aRow[x+i];
+    aResult[x] = aSum;
   }
 }
 
 template <class T>
 inline void filter(CMatrix<T>& aMatrix, const int aDummy, const CFilter<T>& aFilter) {
-  CMatrix<T> tempMatrix(aMatrix.xSize(),aMatrix.ySize());
+  // The result takes the halo of aMatrix, so the buffers can be exchanged instead of copied
+  CMatrix<T> tempMatrix;
+  tempMatrix.setHalo(aMatrix.halo());
+  tempMatrix.setSize(aMatrix.xSize(),aMatrix.ySize());
   filter(aMatrix,tempMatrix,1,aFilter);
-  aMatrix = tempMatrix;
+  aMatrix = std::move(tempMatrix);
 }
 
 template <class T>
-void filter(const CMatrix<T>& aMatrix, CMatrix<T>& aResult, const int aDummy, const CFilter<T>& aFilter) {
+inline void filter(const CMatrixView<T>& aMatrix, const int aDummy, const CFilter<T>& aFilter) {
+  CMatrix<T> tempMatrix(aMatrix.xSize(),aMatrix.ySize());
+  filter(aMatrix,tempMatrix.view(),1,aFilter);
+  aMatrix.copy(tempMatrix.view());
+}
+
+template <class T>
+inline void filter(const CMatrix<T>& aMatrix, CMatrix<T>& aResult, const int aDummy, const CFilter<T>& aFilter) {
+  filter(aMatrix.view(),aResult.view(),aDummy,aFilter);
+}
+
+template <class T>
+void filter(const CMatrixView<T>& aMatrix, const CMatrixView<T>& aResult, const int aDummy, const CFilter<T>& aFilter) {
   if (aResult.xSize() != aMatrix.xSize() || aResult.ySize() != aMatrix.ySize())
     throw EFilterIncompatibleSize(aMatrix.xSize()*aMatrix.ySize(),aResult.xSize()*aResult.ySize());
-  int y1 = -aFilter.A();
-  int y2 = aMatrix.ySize()-aFilter.B();
-  int a2Size = 2*aMatrix.ySize()-1;
-  // Upper rim
-  for (int y = 0; y < y1; y++)
-    for (int x = 0; x < aMatrix.xSize(); x++) {
-      aResult(x,y) = 0;
-      for (int j = aFilter.A(); j < aFilter.B(); j++) {
-        if (y+j < 0) aResult(x,y) += aFilter[j]*aMatrix(x,-1-y-j);
-        else if (y+j >= aMatrix.ySize()) aResult(x,y) += aFilter[j]*aMatrix(x,a2Size-y-j);
-        else aResult(x,y) += aFilter[j]*aMatrix(x,y+j);
-      }
+  filterPlaneY(aMatrix.data(),aMatrix.pitch(),aResult.data(),aResult.pitch(),aMatrix.xSize(),aMatrix.ySize(),aFilter);
+}
+
+// Each output row is computed in one sweep over the source rows it depends on,
+// instead of walking down the columns pixel by pixel
+template <class T>
+void filterPlaneY(const T* aPlane, int aPitch, T* aResult, int aResultPitch, int aXSize, int aYSize, const CFilter<T>& aFilter) {
+  int aTaps = aFilter.B()-aFilter.A();
+  const T* aFilterData = &aFilter[aFilter.A()];
+  int a2Size = 2*aYSize-1;
+  CVector<const T*> aRows(aTaps);
+  for (int y = 0; y < aYSize; y++) {
+    // Source rows of output row y, mirrored at the upper and lower rim
+    for (int j = aFilter.A(); j < aFilter.B(); j++) {
+      int aY = y+j;
+      if (aY < 0) aY = -1-aY;
+      else if (aY >= aYSize) aY = a2Size-aY;
+      aRows(j-aFilter.A()) = aPlane+aY*aPitch;
     }
-  // Lower rim
-  for (int y = y2; y < aMatrix.ySize(); y++)
-    for (int x = 0; x < aMatrix.xSize(); x++) {
-      aResult(x,y) = 0;
-      for (int j = aFilter.A(); j < aFilter.B(); j++) {
-        if (y+j < 0) aResult(x,y) += aFilter[j]*aMatrix(x,-1-y-j);
-        else if (y+j >= aMatrix.ySize()) aResult(x,y) += aFilter[j]*aMatrix(x,a2Size-y-j);
-        else aResult(x,y) += aFilter[j]*aMatrix(x,y+j);
-      }
+    convolveColumns(aRows.data(),aResult+y*aResultPitch,aXSize,aFilterData,aTaps);
+  }
+}
+
+template <class T>
+inline void convolveColumns(const T* const* aRows, T* aResult, int aCount, const T* aFilter, int aTaps) {
+  for (int x = 0; x < aCount; x++) {
+    T aSum = 0;
+    for (int j = 0; j < aTaps; j++)
+      aSum += aFilter[j]*aRows[j][x];
+    aResult[x] = aSum;
+  }
+}
+
+// Like convolveRow, the taps are accumulated in the scalar order
+inline void convolveColumns(const float* const* aRows, float* aResult, int aCount, const float* aFilter, int aTaps) {
+  int x = 0;
+  #ifdef __AVX__
+  for (; x+16 <= aCount; x += 16) {
+    __m256 aSum0 = _mm256_setzero_ps();
+    __m256 aSum1 = _mm256_setzero_ps();
+    for (int j = 0; j < aTaps; j++) {
+      __m256 aTap = _mm256_set1_ps(aFilter[j]);
+      aSum0 = _mm256_add_ps(aSum0,_mm256_mul_ps(aTap,_mm256_loadu_ps(aRows[j]+x)));
+      aSum1 = _mm256_add_ps(aSum1,_mm256_mul_ps(aTap,_mm256_loadu_ps(aRows[j]+x+8)));
     }
-  // Center
-  for (int y = y1; y < y2; y++)
-    for (int x = 0; x < aMatrix.xSize(); x++) {
-      aResult(x,y) = 0;
-      for (int j = aFilter.A(); j < aFilter.B(); j++)
-        aResult(x,y) += aFilter[j]*aMatrix(x,y+j);
+    _mm256_storeu_ps(aResult+x,aSum0);
+    _mm256_storeu_ps(aResult+x+8,aSum1);
+  }
+  #endif
+  #ifdef __SSE2__
+  for (; x+8 <= aCount; x += 8) {
+    __m128 aSum0 = _mm_setzero_ps();
+    __m128 aSum1 = _mm_setzero_ps();
+    for (int j = 0; j < aTaps; j++) {
+      __m128 aTap = _mm_set1_ps(aFilter[j]);
+      aSum0 = _mm_add_ps(aSum0,_mm_mul_ps(aTap,_mm_loadu_ps(aRows[j]+x)));
+      aSum1 = _mm_add_ps(aSum1,_mm_mul_ps(aTap,_mm_loadu_ps(aRows[j]+x+4)));
     }
+    _mm_storeu_ps(aResult+x,aSum0);
+    _mm_storeu_ps(aResult+x+4,aSum1);
+  }
+  #endif
+  for (; x < aCount; x++) {
+    float aSum = 0;
+    for (int j = 0; j < aTaps; j++)
+      aSum += aFilter[j]*aRows[j][x];
+    aResult[x] = aSum;
+  }
+}
+
+inline void convolveColumns(const double* const* aRows, double* aResult, int aCount, const double* aFilter, int aTaps) {
+  int x = 0;
+  #ifdef __AVX__
+  for (; x+8 <= aCount; x += 8) {
+    __m256d aSum0 = _mm256_setzero_pd();
+    __m256d aSum1 = _mm256_setzero_pd();
+    for (int j = 0; j < aTaps; j++) {
+      __m256d aTap = _mm256_set1_pd(aFilter[j]);
+      aSum0 = _mm256_add_pd(aSum0,_mm256_mul_pd(aTap,_mm256_loadu_pd(aRows[j]+x)));
+      aSum1 = _mm256_add_pd(aSum1,_mm256_mul_pd(aTap,_mm256_loadu_pd(aRows[j]+x+4)));
+    }
+    _mm256_storeu_pd(aResult+x,aSum0);
+    _mm256_storeu_pd(aResult+x+4,aSum1);
+  }
+  #endif
+  #ifdef __SSE2__
+  for (; x+4 <= aCount; x += 4) {
+    __m128d aSum0 = _mm_setzero_pd();
+    __m128d aSum1 = _mm_setzero_pd();
+    for (int j = 0; j < aTaps; j++) {
+      __m128d aTap = _mm_set1_pd(aFilter[j]);
+      aSum0 = _mm_add_pd(aSum0,_mm_mul_pd(aTap,_mm_loadu_pd(aRows[j]+x)));
+      aSum1 = _mm_add_pd(aSum1,_mm_mul_pd(aTap,_mm_loadu_pd(aRows[j]+x+2)));
+    }
+    _mm_storeu_pd(aResult+x,aSum0);
+    _mm_storeu_pd(aResult+x+2,aSum1);
+  }
+  #endif
+  for (; x < aCount; x++) {
+    double aSum = 0;
+    for (int j = 0; j < aTaps; j++)
+      aSum += aFilter[j]*aRows[j][x];
+    aResult[x] = aSum;
+  }
 }
 
 template <class T>
 inline void filter(CMatrix<T>& aMatrix, const CFilter2D<T>& aFilter) {
-  CMatrix<T> tempMatrix(aMatrix.xSize(),aMatrix.ySize());
+  // The result takes the halo of aMatrix, so the buffers can be exchanged instead of copied
+  CMatrix<T> tempMatrix;
+  tempMatrix.setHalo(aMatrix.halo());
+  tempMatrix.setSize(aMatrix.xSize(),aMatrix.ySize());
   filter(aMatrix,tempMatrix,aFilter);
-  aMatrix = tempMatrix;
+  aMatrix = std::move(tempMatrix);
 }
 
 template <class T>
-void filter(const CMatrix<T>& aMatrix, CMatrix<T>& aResult, const CFilter2D<T>& aFilter) {
+inline void filter(const CMatrixView<T>& aMatrix, const CFilter2D<T>& aFilter) {
+  // aMatrix is overwritten anyway, so its halo may be written as well
+  CMatrix<T> tempMatrix(aMatrix.xSize(),aMatrix.ySize());
+  filter2D(aMatrix,tempMatrix.view(),aFilter,true);
+  aMatrix.copy(tempMatrix.view());
+}
+
+template <class T>
+inline void filter(const CMatrix<T>& aMatrix, CMatrix<T>& aResult, const CFilter2D<T>& aFilter) {
+  filter(aMatrix.view(),aResult.view(),aFilter);
+}
+
+template <class T>
+inline void filter(CMatrix<T>& aMatrix, CMatrix<T>& aResult, const CFilter2D<T>& aFilter) {
+  filter2D(aMatrix.view(),aResult.view(),aFilter,true);
+}
+
+template <class T>
+void filter(const CMatrixView<T>& aMatrix, const CMatrixView<T>& aResult, const CFilter2D<T>& aFilter) {
+  filter2D(aMatrix,aResult,aFilter,false);
+}
+
+template <class T>
+void filter2D(const CMatrixView<T>& aMatrix, const CMatrixView<T>& aResult, const CFilter2D<T>& aFilter, bool aMirror) {
   if (aResult.xSize() != aMatrix.xSize() || aResult.ySize() != aMatrix.ySize())
     throw EFilterIncompatibleSize(aMatrix.xSize()*aMatrix.ySize(),aResult.xSize()*aResult.ySize());
-  int x1 = -aFilter.AX();
-  int y1 = -aFilter.AY();
-  int x2 = aMatrix.xSize()-aFilter.BX();
-  int y2 = aMatrix.ySize()-aFilter.BY();
-  int a2XSize = 2*aMatrix.xSize()-1;
-  int a2YSize = 2*aMatrix.ySize()-1;
-  // Upper rim
-  for (int y = 0; y < y1; y++)
-    for (int x = 0; x < aMatrix.xSize(); x++) {
-      aResult(x,y) = 0;
-      for (int j = aFilter.AY(); j < aFilter.BY(); j++) {
-        int tempY;
-        if (y+j < 0) tempY = -1-y-j;
-        else if (y+j >= aMatrix.ySize()) tempY = a2YSize-y-j;
-        else tempY = y+j;
-        for (int i = aFilter.AX(); i < aFilter.BX(); i++) {
-          if (x+i < 0) aResult(x,y) += aFilter(i,j)*aMatrix(-1-x-i,tempY);
-          else if (x+i >= aMatrix.xSize()) aResult(x,y) += aFilter(i,j)*aMatrix(a2XSize-x-i,tempY);
-          else aResult(x,y) += aFilter(i,j)*aMatrix(x+i,tempY);
-        }
+  // Large filters are cheaper as separable passes if they have a low rank, or in the frequency domain
+  double aDirect = (double)aFilter.xSize()*aFilter.ySize();
+  double aFFT = fftCost(aMatrix.xSize(),aMatrix.ySize(),aFilter.xSize(),aFilter.ySize());
+  if (filterSeparable(aMatrix,aResult,aFilter,(aFFT < aDirect) ? aFFT : aDirect)) return;
+  if (aFFT < aDirect) {
+    filterFFT(aMatrix,aResult,aFilter);
+    return;
+  }
+  // With a halo the whole matrix is filtered like the center
+  if (aMirror && haloCovers(aMatrix,aFilter.AX(),aFilter.BX(),aMatrix.xSize()) && haloCovers(aMatrix,aFilter.AY(),aFilter.BY(),aMatrix.ySize())) {
+    aMatrix.mirror();
+    convolve2D(aMatrix,aResult,aFilter);
+    return;
+  }
+  // Otherwise the filter reads from a mirrored copy with a sufficient border
+  int aXReach = (-aFilter.AX() > aFilter.BX()-1) ? -aFilter.AX() : aFilter.BX()-1;
+  int aYReach = (-aFilter.AY() > aFilter.BY()-1) ? -aFilter.AY() : aFilter.BY()-1;
+  int aReach = (aXReach > aYReach) ? aXReach : aYReach;
+  if (aReach < 0) aReach = 0;
+  CMatrix<T> aPadded;
+  aPadded.setHalo(aReach);
+  aPadded.setSize(aMatrix.xSize(),aMatrix.ySize());
+  CVector<int> aColumns(aMatrix.xSize()+2*aReach);
+  for (int x = -aReach; x < aMatrix.xSize()+aReach; x++)
+    aColumns(x+aReach) = reflect(x,aMatrix.xSize());
+  for (int y = -aReach; y < aMatrix.ySize()+aReach; y++) {
+    const T* aSource = aMatrix.data()+reflect(y,aMatrix.ySize())*aMatrix.pitch();
+    T* aDest = aPadded.data()+y*aPadded.pitch()-aReach;
+    for (int x = 0; x < aColumns.size(); x++)
+      aDest[x] = aSource[aColumns(x)];
+  }
+  convolve2D(aPadded.view(),aResult,aFilter);
+}
+
+// A rank k filter costs k*(XTaps+YTaps+1) operations per pixel as separable passes
+template <class T>
+bool filterSeparable(const CMatrixView<T>& aMatrix, const CMatrixView<T>& aResult, const CFilter2D<T>& aFilter, double aBudget) {
+  int aXTaps = aFilter.xSize();
+  int aYTaps = aFilter.ySize();
+  if (aFilter.tolerance() <= 0 || aXTaps+aYTaps+1 >= aBudget) return false;
+  // The 1D filters mirror only once at the boundaries
+  if (aFilter.BX() > aMatrix.xSize() || -aFilter.AX() > aMatrix.xSize() ||
+      aFilter.BY() > aMatrix.ySize() || -aFilter.AY() > aMatrix.ySize()) return false;
+  std::vector<CFilter<T> > aFilterX,aFilterY;
+  int aRank = aFilter.separable(aFilterX,aFilterY);
+  if (aRank*(aXTaps+aYTaps+1) >= aBudget) return false;
+  if (aRank == 0) {
+    aResult.fill(0);
+    return true;
+  }
+  CMatrix<T> aTemp(aMatrix.xSize(),aMatrix.ySize());
+  CMatrix<T> aPass;
+  if (aRank > 1) aPass.setSize(aMatrix.xSize(),aMatrix.ySize());
+  for (int k = 0; k < aRank; k++) {
+    filter(aMatrix,aTemp.view(),aFilterX[k],1);
+    if (k == 0) {
+      filter(aTemp.view(),aResult,1,aFilterY[k]);
+      continue;
+    }
+    filter(aTemp.view(),aPass.view(),1,aFilterY[k]);
+    for (int y = 0; y < aResult.ySize(); y++) {
+      T* aDest = aResult.data()+y*aResult.pitch();
+      const T* aSource = aPass.data()+y*aPass.pitch();
+      for (int x = 0; x < aResult.xSize(); x++)
+        aDest[x] += aSource[x];
+    }
+  }
+  return true;
+}
+
+template <class T>
+inline void filterFFT(const CMatrix<T>& aMatrix, CMatrix<T>& aResult, const CFilter2D<T>& aFilter) {
+  filterFFT(aMatrix.view(),aResult.view(),aFilter);
+}
+
+// Each tile of N1 x N2 pixels yields (N1-XTaps+1) x (N2-YTaps+1) results that do not suffer from the
+// cyclic wrap-around. The filter is real, so a tile in the real part and one in the imaginary part
+// are filtered independently by the same transform.
+template <class T>
+void filterFFT(const CMatrixView<T>& aMatrix, const CMatrixView<T>& aResult, const CFilter2D<T>& aFilter) {
+  if (aResult.xSize() != aMatrix.xSize() || aResult.ySize() != aMatrix.ySize())
+    throw EFilterIncompatibleSize(aMatrix.xSize()*aMatrix.ySize(),aResult.xSize()*aResult.ySize());
+  int aXSize = aMatrix.xSize();
+  int aYSize = aMatrix.ySize();
+  if (aXSize == 0 || aYSize == 0) return;
+  int aXTaps = aFilter.xSize();
+  int aYTaps = aFilter.ySize();
+  int n1 = fftSize(aYSize,aYTaps);
+  int n2 = fftSize(aXSize,aXTaps);
+  int aXStep = n2-aXTaps+1;
+  int aYStep = n1-aYTaps+1;
+  int aXTiles = (aXSize+aXStep-1)/aXStep;
+  int aYTiles = (aYSize+aYStep-1)/aYStep;
+  int aTiles = aXTiles*aYTiles;
+  // Spectrum of the filter, conjugated since the convolution correlates, and scaled for the inverse transform
+  CMatrix<double> aSpectrum(2*n2,n1);
+  {
+    CFFTPlan& aPlan = CFFTPlan::cached(n2,n1);
+    for (int y = 0; y < n1; y++)
+      for (int x = 0; x < 2*n2; x++)
+        aPlan.row(y)[x] = 0;
+    for (int j = 0; j < aYTaps; j++)
+      for (int i = 0; i < aXTaps; i++)
+        aPlan.row(j)[2*i] = aFilter(i+aFilter.AX(),j+aFilter.AY());
+    aPlan.transform(-1);
+    double aScale = 1.0/((double)n1*n2);
+    for (int y = 0; y < n1; y++)
+      for (int x = 0; x < n2; x++) {
+        aSpectrum(2*x,y) = aScale*aPlan.row(y)[2*x];
+        aSpectrum(2*x+1,y) = -aScale*aPlan.row(y)[2*x+1];
+      }
+  }
+  // Mirrored column of each tile column
+  CVector<int> aColumns(aXTiles*aXStep+aXTaps-1);
+  for (int x = 0; x < aColumns.size(); x++)
+    aColumns(x) = reflect(x+aFilter.AX(),aXSize);
+  // Each thread transforms in its own plan
+  std::function<void(int)> aPair = [&](int aIndex) {
+    CFFTPlan& aPlan = CFFTPlan::cached(n2,n1);
+    for (int k = 0; k < 2; k++) {
+      int aTile = 2*aIndex+k;
+      if (aTile >= aTiles) {
+        for (int y = 0; y < n1; y++)
+          for (int x = 0; x < n2; x++)
+            aPlan.row(y)[2*x+k] = 0;
+        continue;
+      }
+      int x1 = (aTile % aXTiles)*aXStep;
+      int y1 = (aTile / aXTiles)*aYStep;
+      for (int y = 0; y < n1; y++) {
+        const T* aSource = aMatrix.data()+reflect(y1+y+aFilter.AY(),aYSize)*aMatrix.pitch();
+        const int* aColumn = aColumns.data()+x1;
+        double* aDest = aPlan.row(y)+k;
+        for (int x = 0; x < n2; x++)
+          aDest[2*x] = aSource[aColumn[x]];
       }
     }
-  // Lower rim
-  for (int y = y2; y < aMatrix.ySize(); y++)
-    for (int x = 0; x < aMatrix.xSize(); x++) {
-      aResult(x,y) = 0;
-      for (int j = aFilter.AY(); j < aFilter.BY(); j++) {
-        int tempY;
-        if (y+j < 0) tempY = -1-y-j;
-        else if (y+j >= aMatrix.ySize()) tempY = a2YSize-y-j;
-        else tempY = y+j;
-        for (int i = aFilter.AX(); i < aFilter.BX(); i++) {
-          if (x+i < 0) aResult(x,y) += aFilter(i,j)*aMatrix(-1-x-i,tempY);
-          else if (x+i >= aMatrix.xSize()) aResult(x,y) += aFilter(i,j)*aMatrix(a2XSize-x-i,tempY);
-          else aResult(x,y) += aFilter(i,j)*aMatrix(x+i,tempY);
-        }
+    aPlan.transform(-1);
+    for (int y = 0; y < n1; y++) {
+      double* aDest = aPlan.row(y);
+      const double* aFactor = aSpectrum.data()+y*aSpectrum.pitch();
+      for (int x = 0; x < 2*n2; x += 2) {
+        double aReal = aDest[x]*aFactor[x]-aDest[x+1]*aFactor[x+1];
+        aDest[x+1] = aDest[x]*aFactor[x+1]+aDest[x+1]*aFactor[x];
+        aDest[x] = aReal;
       }
     }
-  for (int y = y1; y < y2; y++) {
-    // Left rim
-    for (int x = 0; x < x1; x++) {
-      aResult(x,y) = 0;
-      for (int j = aFilter.AY(); j < aFilter.BY(); j++) {
-        for (int i = aFilter.AX(); i < aFilter.BX(); i++) {
-          if (x+i < 0) aResult(x,y) += aFilter(i,j)*aMatrix(-1-x-i,y+j);
-          else if (x+i >= aMatrix.xSize()) aResult(x,y) += aFilter(i,j)*aMatrix(a2XSize-x-i,y+j);
-          else aResult(x,y) += aFilter(i,j)*aMatrix(x+i,y+j);
-        }
+    aPlan.transform(1);
+    for (int k = 0; k < 2 && 2*aIndex+k < aTiles; k++) {
+      int aTile = 2*aIndex+k;
+      int x1 = (aTile % aXTiles)*aXStep;
+      int y1 = (aTile / aXTiles)*aYStep;
+      int aCount = (x1+aXStep < aXSize) ? aXStep : aXSize-x1;
+      int y2 = (y1+aYStep < aYSize) ? y1+aYStep : aYSize;
+      for (int y = y1; y < y2; y++) {
+        const double* aSource = aPlan.row(y-y1)+k;
+        T* aDest = aResult.data()+y*aResult.pitch()+x1;
+        for (int x = 0; x < aCount; x++)
+          aDest[x] = aSource[2*x];
       }
     }
-    // Right rim
-    for (int x = x2; x < aMatrix.xSize(); x++) {
-      aResult(x,y) = 0;
-      for (int j = aFilter.AY(); j < aFilter.BY(); j++) {
-        for (int i = aFilter.AX(); i < aFilter.BX(); i++) {
-          if (x+i < 0) aResult(x,y) += aFilter(i,j)*aMatrix(-1-x-i,y+j);
-          else if (x+i >= aMatrix.xSize()) aResult(x,y) += aFilter(i,j)*aMatrix(a2XSize-x-i,y+j);
-          else aResult(x,y) += aFilter(i,j)*aMatrix(x+i,y+j);
-        }
+  };
+  CThreadPool::parallelFor((aTiles+1)/2,aPair);
+}
+
+// fftSize
+// Tiles of four filter lengths waste a quarter of each dimension on the overlap,
+// smaller matrices only need to hold the matrix and the filter
+inline int fftSize(int aSize, int aTaps) {
+  int aTarget = 4*(aTaps-1);
+  if (aTarget < 64) aTarget = 64;
+  if (aTarget > aSize+aTaps-1) aTarget = aSize+aTaps-1;
+  int aResult = 8;
+  while (aResult < aTarget) aResult *= 2;
+  return aResult;
+}
+
+// fftCost
+// The transforms of a pair of tiles take time proportional to n1*n2*log2(n1*n2), the factor is measured
+// against the vectorized multiply-adds of convolveRow2D
+inline double fftCost(int aXSize, int aYSize, int aXTaps, int aYTaps) {
+  const double cFlop = 15.0;
+  if (aXSize == 0 || aYSize == 0) return 0;
+  int n1 = fftSize(aYSize,aYTaps);
+  int n2 = fftSize(aXSize,aXTaps);
+  double aOutputs = (double)(n1-aYTaps+1)*(n2-aXTaps+1);
+  return cFlop*n1*n2*log2((double)n1*n2)/aOutputs;
+}
+
+// Tiles keep the filtered rows in the cache and are the units of work for the threads
+template <class T>
+void convolve2D(const CMatrixView<T>& aMatrix, const CMatrixView<T>& aResult, const CFilter2D<T>& aFilter) {
+  enum { cTileWidth = 256, cTileHeight = 32 };
+  int aXTaps = aFilter.xSize();
+  int aYTaps = aFilter.ySize();
+  int aSquare = (aXTaps == aYTaps) ? aXTaps : 0;
+  const T* aFilterData = aFilter.data();
+  int aXTiles = (aMatrix.xSize()+cTileWidth-1)/cTileWidth;
+  int aYTiles = (aMatrix.ySize()+cTileHeight-1)/cTileHeight;
+  std::function<void(int)> aTile = [&](int aIndex) {
+    int x1 = (aIndex % aXTiles)*cTileWidth;
+    int y1 = (aIndex / aXTiles)*cTileHeight;
+    int aCount = (x1+cTileWidth < aMatrix.xSize()) ? cTileWidth : aMatrix.xSize()-x1;
+    int y2 = (y1+cTileHeight < aMatrix.ySize()) ? y1+cTileHeight : aMatrix.ySize();
+    for (int y = y1; y < y2; y++) {
+      const T* aSource = aMatrix.data()+(y+aFilter.AY())*aMatrix.pitch()+x1+aFilter.AX();
+      T* aDest = aResult.data()+y*aResult.pitch()+x1;
+      switch (aSquare) {
+        case 3: convolveRow2D<3>(aSource,aMatrix.pitch(),aDest,aCount,aFilterData,aXTaps,aYTaps); break;
+        case 5: convolveRow2D<5>(aSource,aMatrix.pitch(),aDest,aCount,aFilterData,aXTaps,aYTaps); break;
+        case 7: convolveRow2D<7>(aSource,aMatrix.pitch(),aDest,aCount,aFilterData,aXTaps,aYTaps); break;
+        default: convolveRow2D<0>(aSource,aMatrix.pitch(),aDest,aCount,aFilterData,aXTaps,aYTaps);
       }
     }
+  };
+  // Small jobs are not worth waking up the threads
+  if ((double)aMatrix.size()*aXTaps*aYTaps < (1 << 20)) {
+    for (int i = 0; i < aXTiles*aYTiles; i++)
+      aTile(i);
   }
-  // Center
-  for (int y = y1; y < y2; y++)
-    for (int x = x1; x < x2; x++) {
-      aResult(x,y) = 0;
-      for (int j = aFilter.AY(); j < aFilter.BY(); j++)
-        for (int i = aFilter.AX(); i < aFilter.BX(); i++)
-          aResult(x,y) += aFilter(i,j)*aMatrix(x+i,y+j);
+  else CThreadPool::parallelFor(aXTiles*aYTiles,aTile);
+}
+
+template <int cTaps, class T>
+inline void convolveRow2D(const T* aSource, int aPitch, T* aResult, int aCount, const T* aFilter, int aXTaps, int aYTaps) {
+  if (cTaps > 0) aXTaps = aYTaps = cTaps;
+  for (int x = 0; x < aCount; x++) {
+    T aSum = 0;
+    for (int j = 0; j < aYTaps; j++)
+      for (int i = 0; i < aXTaps; i++)
+        aSum += aFilter[j*aXTaps+i]*aSource[j*aPitch+x+i];
+    aResult[x] = aSum;
+  }
+}
+
+// Like convolveRow, the taps are accumulated in the scalar order
+template <int cTaps>
+inline void convolveRow2D(const float* aSource, int aPitch, float* aResult, int aCount, const float* aFilter, int aXTaps, int aYTaps) {
+  if (cTaps > 0) aXTaps = aYTaps = cTaps;
+  int x = 0;
+  #ifdef __AVX__
+  for (; x+16 <= aCount; x += 16) {
+    __m256 aSum0 = _mm256_setzero_ps();
+    __m256 aSum1 = _mm256_setzero_ps();
+    for (int j = 0; j < aYTaps; j++) {
+      const float* aRow = aSource+j*aPitch+x;
+      const float* aTaps = aFilter+j*aXTaps;
+      for (int i = 0; i < aXTaps; i++) {
+        __m256 aTap = _mm256_set1_ps(aTaps[i]);
+        aSum0 = _mm256_add_ps(aSum0,_mm256_mul_ps(aTap,_mm256_loadu_ps(aRow+i)));
+        aSum1 = _mm256_add_ps(aSum1,_mm256_mul_ps(aTap,_mm256_loadu_ps(aRow+8+i)));
+      }
+    }
+    _mm256_storeu_ps(aResult+x,aSum0);
+    _mm256_storeu_ps(aResult+x+8,aSum1);
+  }
+  #endif
+  #ifdef __SSE2__
+  for (; x+8 <= aCount; x += 8) {
+    __m128 aSum0 = _mm_setzero_ps();
+    __m128 aSum1 = _mm_setzero_ps();
+    for (int j = 0; j < aYTaps; j++) {
+      const float* aRow = aSource+j*aPitch+x;
+      const float* aTaps = aFilter+j*aXTaps;
+      for (int i = 0; i < aXTaps; i++) {
+        __m128 aTap = _mm_set1_ps(aTaps[i]);
+        aSum0 = _mm_add_ps(aSum0,_mm_mul_ps(aTap,_mm_loadu_ps(aRow+i)));
+        aSum1 = _mm_add_ps(aSum1,_mm_mul_ps(aTap,_mm_loadu_ps(aRow+4+i)));
+      }
     }
+    _mm_storeu_ps(aResult+x,aSum0);
+    _mm_storeu_ps(aResult+x+4,aSum1);
+  }
+  #endif
+  for (; x < aCount; x++) {
+    float aSum = 0;
+    for (int j = 0; j < aYTaps; j++)
+      for (int i = 0; i < aXTaps; i++)
+        aSum += aFilter[j*aXTaps+i]*aSource[j*aPitch+x+i];
+    aResult[x] = aSum;
+  }
+}
+
+template <int cTaps>
+inline void convolveRow2D(const double* aSource, int aPitch, double* aResult, int aCount, const double* aFilter, int aXTaps, int aYTaps) {
+  if (cTaps > 0) aXTaps = aYTaps = cTaps;
+  int x = 0;
+  #ifdef __AVX__
+  for (; x+8 <= aCount; x += 8) {
+    __m256d aSum0 = _mm256_setzero_pd();
+    __m256d aSum1 = _mm256_setzero_pd();
+    for (int j = 0; j < aYTaps; j++) {
+      const double* aRow = aSource+j*aPitch+x;
+      const double* aTaps = aFilter+j*aXTaps;
+      for (int i = 0; i < aXTaps; i++) {
+        __m256d aTap = _mm256_set1_pd(aTaps[i]);
+        aSum0 = _mm256_add_pd(aSum0,_mm256_mul_pd(aTap,_mm256_loadu_pd(aRow+i)));
+        aSum1 = _mm256_add_pd(aSum1,_mm256_mul_pd(aTap,_mm256_loadu_pd(aRow+4+i)));
+      }
+    }
+    _mm256_storeu_pd(aResult+x,aSum0);
+    _mm256_storeu_pd(aResult+x+4,aSum1);
+  }
+  #endif
+  #ifdef __SSE2__
+  for (; x+4 <= aCount; x += 4) {
+    __m128d aSum0 = _mm_setzero_pd();
+    __m128d aSum1 = _mm_setzero_pd();
+    for (int j = 0; j < aYTaps; j++) {
+      const double* aRow = aSource+j*aPitch+x;
+      const double* aTaps = aFilter+j*aXTaps;
+      for (int i = 0; i < aXTaps; i++) {
+        __m128d aTap = _mm_set1_pd(aTaps[i]);
+        aSum0 = _mm_add_pd(aSum0,_mm_mul_pd(aTap,_mm_loadu_pd(aRow+i)));
+        aSum1 = _mm_add_pd(aSum1,_mm_mul_pd(aTap,_mm_loadu_pd(aRow+2+i)));
+      }
+    }
+    _mm_storeu_pd(aResult+x,aSum0);
+    _mm_storeu_pd(aResult+x+2,aSum1);
+  }
+  #endif
+  for (; x < aCount; x++) {
+    double aSum = 0;
+    for (int j = 0; j < aYTaps; j++)
+      for (int i = 0; i < aXTaps; i++)
+        aSum += aFilter[j*aXTaps+i]*aSource[j*aPitch+x+i];
+    aResult[x] = aSum;
+  }
+}
+
+inline int reflect(int i, int aSize) {
+  int a2Size = 2*aSize;
+  i %= a2Size;
+  if (i < 0) i += a2Size;
+  return (i < aSize) ? i : a2Size-1-i;
 }
 
 // boxfilterX
 template <class T>
 inline void boxFilterX(CMatrix<T>& aMatrix, int aWidth) {
-  CMatrix<T> aTemp(aMatrix);
-  boxFilterX(aTemp,aMatrix,aWidth);
+  CMatrix<T> aTemp;
+  aTemp.setHalo(aMatrix.halo());
+  aTemp.setSize(aMatrix.xSize(),aMatrix.ySize());
+  boxFilterX(aMatrix,aTemp,aWidth);
+  aMatrix = std::move(aTemp);
 }
 
 template <class T>
-void boxFilterX(const CMatrix<T>& aMatrix, CMatrix<T>& aResult, int aWidth) {
+inline void boxFilterX(const CMatrixView<T>& aMatrix, int aWidth) {
+  CMatrix<T> tempMatrix(aMatrix.xSize(),aMatrix.ySize());
+  boxFilterX(aMatrix,tempMatrix.view(),aWidth);
+  aMatrix.copy(tempMatrix.view());
+}
+
+template <class T>
+inline void boxFilterX(const CMatrix<T>& aMatrix, CMatrix<T>& aResult, int aWidth) {
+  boxFilterX(aMatrix.view(),aResult.view(),aWidth);
+}
+
+template <class T>
+void boxFilterX(const CMatrixView<T>& aMatrix, const CMatrixView<T>& aResult, int aWidth) {
   if (aWidth & 1 == 0) aWidth += 1;
   T invWidth = 1.0/aWidth;
   int halfWidth = (aWidth >> 1);
   int aRight = halfWidth;
   if (aRight >= aMatrix.xSize()) aRight = aMatrix.xSize()-1;
   for (int y = 0; y < aMatrix.ySize(); y++) {
-    int aOffset = y*aMatrix.xSize();
+    const T* aRow = aMatrix.data()+y*aMatrix.pitch();
+    T* aResultRow = aResult.data()+y*aResult.pitch();
     // Initialize
     T aSum = 0.0f;
     for (int x = aRight-aWidth+1; x <= aRight; x++)
-      if (x < 0) aSum += aMatrix.data()[aOffset-x-1];
-      else aSum += aMatrix.data()[aOffset+x];
+      if (x < 0) aSum += aRow[-x-1];
+      else aSum += aRow[x];
     // Shift
     int xm = -halfWidth;
     int xp = halfWidth+1;
     for (int x = 0; x < aMatrix.xSize(); x++,xm++,xp++) {
-      aResult.data()[aOffset+x] = aSum*invWidth;
-      if (xm < 0) aSum -= aMatrix.data()[aOffset-xm-1];
-      else aSum -= aMatrix.data()[aOffset+xm];
-      if (xp >= aMatrix.xSize()) aSum += aMatrix.data()[aOffset+2*aMatrix.xSize()-1-xp];
-      else aSum += aMatrix.data()[aOffset+xp];
+      aResultRow[x] = aSum*invWidth;
+      if (xm < 0) aSum -= aRow[-xm-1];
+      else aSum -= aRow[xm];
+      if (xp >= aMatrix.xSize()) aSum += aRow[2*aMatrix.xSize()-1-xp];
+      else aSum += aRow[xp];
     }
   }
 }
@@ -1263,12 +2051,27 @@ void boxFilterX(const CMatrix<T>& aMatrix, CMatrix<T>& aResult, int aWidth) {
 // boxfilterY
 template <class T>
 inline void boxFilterY(CMatrix<T>& aMatrix, int aWidth) {
-  CMatrix<T> aTemp(aMatrix);
-  boxFilterY(aTemp,aMatrix,aWidth);
+  CMatrix<T> aTemp;
+  aTemp.setHalo(aMatrix.halo());
+  aTemp.setSize(aMatrix.xSize(),aMatrix.ySize());
+  boxFilterY(aMatrix,aTemp,aWidth);
+  aMatrix = std::move(aTemp);
+}
+
+template <class T>
+inline void boxFilterY(const CMatrixView<T>& aMatrix, int aWidth) {
+  CMatrix<T> tempMatrix(aMatrix.xSize(),aMatrix.ySize());
+  boxFilterY(aMatrix,tempMatrix.view(),aWidth);
+  aMatrix.copy(tempMatrix.view());
+}
+
+template <class T>
+inline void boxFilterY(const CMatrix<T>& aMatrix, CMatrix<T>& aResult, int aWidth) {
+  boxFilterY(aMatrix.view(),aResult.view(),aWidth);
 }
 
 template <class T>
-void boxFilterY(const CMatrix<T>& aMatrix, CMatrix<T>& aResult, int aWidth) {
+void boxFilterY(const CMatrixView<T>& aMatrix, const CMatrixView<T>& aResult, int aWidth) {
   if (aWidth & 1 == 0) aWidth += 1;
   T invWidth = 1.0/aWidth;
   int halfWidth = (aWidth >> 1);
@@ -1294,7 +2097,12 @@ void boxFilterY(const CMatrix<T>& aMatrix, CMatrix<T>& aResult, int aWidth) {
 }
 
 template <class T>
-void recursiveSmoothX(CMatrix<T>& aMatrix, float aSigma) {
+inline void recursiveSmoothX(CMatrix<T>& aMatrix, float aSigma) {
+  recursiveSmoothX(aMatrix.view(),aSigma);
+}
+
+template <class T>
+void recursiveSmoothX(const CMatrixView<T>& aMatrix, float aSigma) {
   CVector<T> aVals1(aMatrix.xSize());
   CVector<T> aVals2(aMatrix.xSize());
   float aAlpha = 2.5/(sqrt(NMath::Pi)*aSigma);
@@ -1319,7 +2127,12 @@ void recursiveSmoothX(CMatrix<T>& aMatrix, float aSigma) {
 }
 
 template <class T>
-void recursiveSmoothY(CMatrix<T>& aMatrix, float aSigma) {
+inline void recursiveSmoothY(CMatrix<T>& aMatrix, float aSigma) {
+  recursiveSmoothY(aMatrix.view(),aSigma);
+}
+
+template <class T>
+void recursiveSmoothY(const CMatrixView<T>& aMatrix, float aSigma) {
   CVector<T> aVals1(aMatrix.ySize());
   CVector<T> aVals2(aMatrix.ySize());
   float aAlpha = 2.5/(sqrt(NMath::Pi)*aSigma);
@@ -1349,6 +2162,12 @@ inline void recursiveSmooth(CMatrix<T>& aMatrix, float aSigma) {
   recursiveSmoothY(aMatrix,aSigma);
 }
 
+template <class T>
+inline void recursiveSmooth(const CMatrixView<T>& aMatrix, float aSigma) {
+  recursiveSmoothX(aMatrix,aSigma);
+  recursiveSmoothY(aMatrix,aSigma);
+}
+
 // Linear 3D filtering ---------------------------------------------------------
 
 template <class T>
@@ -1357,7 +2176,7 @@ inline void filter(CTensor<T>& aTensor, const CFilter<T>& aFilterX, const CFilte
   filter(aTensor,tempTensor,aFilterX,1,1);
   filter(tempTensor,aTensor,1,aFilterY,1);
   filter(aTensor,tempTensor,1,1,aFilterZ);
-  aTensor = tempTensor;
+  aTensor = std::move(tempTensor);
 }
 
 template <class T>
@@ -1372,96 +2191,40 @@ template <class T>
 inline void filter(CTensor<T>& aTensor, const CFilter<T>& aFilter, const int aDummy1, const int aDummy2) {
   CTensor<T> tempTensor(aTensor.xSize(),aTensor.ySize(),aTensor.zSize());
   filter(aTensor,tempTensor,aFilter,1,1);
-  aTensor = tempTensor;
+  aTensor = std::move(tempTensor);
 }
 
 template <class T>
 void filter(const CTensor<T>& aTensor, CTensor<T>& aResult, const CFilter<T>& aFilter, const int aDummy1, const int aDummy2) {
   if (aResult.xSize() != aTensor.xSize() || aResult.ySize() != aTensor.ySize() || aResult.zSize() != aTensor.zSize())
     throw EFilterIncompatibleSize(aTensor.xSize()*aTensor.ySize()*aTensor.zSize(),aResult.xSize()*aResult.ySize()*aResult.zSize());
-  int x1 = -aFilter.A();
-  int x2 = aTensor.xSize()-aFilter.B();
-  int a2Size = 2*aTensor.xSize()-1;
-  for (int z = 0; z < aTensor.zSize(); z++)
-    for (int y = 0; y < aTensor.ySize(); y++) {
-      // Left rim
-      for (int x = 0; x < x1; x++) {
-        aResult(x,y,z) = 0;
-        for (int i = aFilter.A(); i < aFilter.B(); i++) {
-          if (x+i < 0) aResult(x,y,z) += aFilter[i]*aTensor(-1-x-i,y,z);
-          else if (x+i >= aTensor.xSize()) aResult(x,y,z) += aFilter[i]*aTensor(a2Size-x-i,y,z);
-          else aResult(x,y,z) += aFilter[i]*aTensor(x+i,y,z);
-        }
-      }
-      // Center
-      for (int x = x1; x < x2; x++) {
-        aResult(x,y,z) = 0;
-        for (int i = aFilter.A(); i < aFilter.B(); i++)
-          aResult(x,y,z) += aFilter[i]*aTensor(x+i,y,z);
-      }
-      // Right rim
-      for (int x = x2; x < aTensor.xSize(); x++) {
-        aResult(x,y,z) = 0;
-        for (int i = aFilter.A(); i < aFilter.B(); i++) {
-          if (x+i < 0) aResult(x,y,z) += aFilter[i]*aTensor(-1-x-i,y,z);
-          else if (x+i >= aTensor.xSize()) aResult(x,y,z) += aFilter[i]*aTensor(a2Size-x-i,y,z);
-          else aResult(x,y,z) += aFilter[i]*aTensor(x+i,y,z);
-        }
-      }
-    }
+  int aRows = aTensor.ySize()*aTensor.zSize();
+  for (int y = 0; y < aRows; y++) {
+    int aOffset = y*aTensor.xSize();
+    filterRowX(aTensor.data()+aOffset,aResult.data()+aOffset,aTensor.xSize(),aFilter);
+  }
 }
 
 template <class T>
 inline void filter(CTensor<T>& aTensor, const int aDummy1, const CFilter<T>& aFilter, const int aDummy2) {
   CTensor<T> tempTensor(aTensor.xSize(),aTensor.ySize(),aTensor.zSize());
   filter(aTensor,tempTensor,1,aFilter,1);
-  aTensor = tempTensor;
+  aTensor = std::move(tempTensor);
 }
 
 template <class T>
 void filter(const CTensor<T>& aTensor, CTensor<T>& aResult, const int aDummy1, const CFilter<T>& aFilter, const int aDummy2) {
   if (aResult.xSize() != aTensor.xSize() || aResult.ySize() != aTensor.ySize() || aResult.zSize() != aTensor.zSize())
     throw EFilterIncompatibleSize(aTensor.xSize()*aTensor.ySize()*aTensor.zSize(),aResult.xSize()*aResult.ySize()*aResult.zSize());
-  int y1 = -aFilter.A();
-  int y2 = aTensor.ySize()-aFilter.B();
-  int a2Size = 2*aTensor.ySize()-1;
-  for (int z = 0; z < aTensor.zSize(); z++) {
-    // Upper rim
-    for (int y = 0; y < y1; y++)
-      for (int x = 0; x < aTensor.xSize(); x++) {
-        aResult(x,y,z) = 0;
-        for (int i = aFilter.A(); i < aFilter.B(); i++) {
-          if (y+i < 0) aResult(x,y,z) += aFilter[i]*aTensor(x,-1-y-i,z);
-          else if (y+i >= aTensor.ySize()) aResult(x,y,z) += aFilter[i]*aTensor(x,a2Size-y-i,z);
-          else aResult(x,y,z) += aFilter[i]*aTensor(x,y+i,z);
-        }
-      }
-    // Lower rim
-    for (int y = y2; y < aTensor.ySize(); y++)
-      for (int x = 0; x < aTensor.xSize(); x++) {
-        aResult(x,y,z) = 0;
-        for (int i = aFilter.A(); i < aFilter.B(); i++) {
-          if (y+i < 0) aResult(x,y,z) += aFilter[i]*aTensor(x,-1-y-i,z);
-          else if (y+i >= aTensor.ySize()) aResult(x,y,z) += aFilter[i]*aTensor(x,a2Size-y-i,z);
-          else aResult(x,y,z) += aFilter[i]*aTensor(x,y+i,z);
-        }
-      }
-  }
-  // Center
   for (int z = 0; z < aTensor.zSize(); z++)
-    for (int y = y1; y < y2; y++)
-      for (int x = 0; x < aTensor.xSize(); x++) {
-        aResult(x,y,z) = 0;
-        for (int i = aFilter.A(); i < aFilter.B(); i++)
-          aResult(x,y,z) += aFilter[i]*aTensor(x,y+i,z);
-      }
+    filter(aTensor.layer(z),aResult.layer(z),1,aFilter);
 }
 
 template <class T>
 inline void filter(CTensor<T>& aTensor, const int aDummy1, const int aDummy2, const CFilter<T>& aFilter) {
   CTensor<T> tempTensor(aTensor.xSize(),aTensor.ySize(),aTensor.zSize());
   filter(aTensor,tempTensor,1,1,aFilter);
-  aTensor = tempTensor;
+  aTensor = std::move(tempTensor);
 }
 
 template <class T>
@@ -1507,8 +2270,9 @@ void filter(const CTensor<T>& aTensor, CTensor<T>& aResult, const int aDummy1, c
 // boxfilterX
 template <class T>
 inline void boxFilterX(CTensor<T>& aTensor, int aWidth) {
-  CTensor<T> aTemp(aTensor);
-  boxFilterX(aTemp,aTensor,aWidth);
+  CTensor<T> aTemp(aTensor.xSize(),aTensor.ySize(),aTensor.zSize());
+  boxFilterX(aTensor,aTemp,aWidth);
+  aTensor = std::move(aTemp);
 }
 
 template <class T>
@@ -1547,8 +2311,9 @@ void boxFilterX(const CTensor<T>& aTensor, CTensor<T>& aResult, int aWidth) {
 // boxfilterY
 template <class T>
 inline void boxFilterY(CTensor<T>& aTensor, int aWidth) {
-  CTensor<T> aTemp(aTensor);
-  boxFilterY(aTemp,aTensor,aWidth);
+  CTensor<T> aTemp(aTensor.xSize(),aTensor.ySize(),aTensor.zSize());
+  boxFilterY(aTensor,aTemp,aWidth);
+  aTensor = std::move(aTemp);
 }
 
 template <class T>
@@ -1586,8 +2351,9 @@ void boxFilterY(const CTensor<T>& aTensor, CTensor<T>& aResult, int aWidth) {
 // boxfilterZ
 template <class T>
 inline void boxFilterZ(CTensor<T>& aTensor, int aWidth) {
-  CTensor<T> aTemp(aTensor);
-  boxFilterZ(aTemp,aTensor,aWidth);
+  CTensor<T> aTemp(aTensor.xSize(),aTensor.ySize(),aTensor.zSize());
+  boxFilterZ(aTensor,aTemp,aWidth);
+  aTensor = std::move(aTemp);
 }
 
 template <class T>
@@ -1716,7 +2482,7 @@ template <class T>
 inline void filter(CTensor4D<T>& aTensor, const CFilter<T>& aFilter, const int aDummy1, const int aDummy2, const int aDummy3) {
   CTensor4D<T> tempTensor(aTensor.xSize(),aTensor.ySize(),aTensor.zSize(),aTensor.aSize());
   filter(aTensor,tempTensor,aFilter,1,1,1);
-  aTensor = tempTensor;
+  aTensor = std::move(tempTensor);
 }
 
 template <class T>
@@ -1756,7 +2522,7 @@ template <class T>
 inline void filter(CTensor4D<T>& aTensor, const int aDummy1, const CFilter<T>& aFilter, const int aDummy2, const int aDummy3) {
   CTensor4D<T> tempTensor(aTensor.xSize(),aTensor.ySize(),aTensor.zSize(),aTensor.aSize());
   filter(aTensor,tempTensor,1,aFilter,1,1);
-  aTensor = tempTensor;
+  aTensor = std::move(tempTensor);
 }
 
 template <class T>
@@ -1799,7 +2565,7 @@ template <class T>
 inline void filter(CTensor4D<T>& aTensor, const int aDummy1, const int aDummy2, const CFilter<T>& aFilter, const int aDummy3) {
   CTensor4D<T> tempTensor(aTensor.xSize(),aTensor.ySize(),aTensor.zSize(),aTensor.aSize());
   filter(aTensor,tempTensor,1,1,aFilter,1);
-  aTensor = tempTensor;
+  aTensor = std::move(tempTensor);
 }
 
 template <class T>
@@ -1842,7 +2608,7 @@ template <class T>
 inline void filter(CTensor4D<T>& aTensor, const int aDummy1, const int aDummy2, const int aDummy3, const CFilter<T>& aFilter) {
   CTensor4D<T> tempTensor(aTensor.xSize(),aTensor.ySize(),aTensor.zSize(),aTensor.aSize());
   filter(aTensor,tempTensor,1,1,1,aFilter);
-  aTensor = tempTensor;
+  aTensor = std::move(tempTensor);
 }
 
 template <class T>
@@ -2073,8 +2839,9 @@ void osher(CMatrix<T>& aData, int aIterations) {
           aDiff(x,y) = -sqrt(aSum);
         }
       }
-    for (int i = 0; i < aData.size(); i++)
-      aData.data()[i] += 0.25*aDiff.data()[i];
+    for (int y = 0; y < aData.ySize(); y++)
+      for (int x = 0; x < aData.xSize(); x++)
+        aData(x,y) += 0.25*aDiff(x,y);
   }
 }
 
@@ -22,6 +22,59 @@
   #include <sstream>
 #endif
 #include "CVector.h"
+#include "NMemory.h"
+#include "NPNM.h"
+
+// CMatrixView describes a two-dimensional array in memory it does not own, e.g.
+// a layer of a CTensor or the data of a CMatrix. Element (x,y) is at
+// data()[y*pitch()+x], a view with a halo may also be accessed up to halo()
+// elements beyond its boundaries. A view neither allocates nor releases memory
+// and copying it copies the description only, so the memory must outlive the view.
+// All methods that write change the viewed memory, not the view, and are const.
+//
+// Example:
+// CTensor<float> aImage(640,480,3);
+// NFilter::filter(aImage.layer(1),CSmooth<float>(2.0,2.0),CSmooth<float>(2.0,2.0));
+// aImage.layer(1).writeToPGM("green.pgm");
+
+template <class T>
+class CMatrixView {
+public:
+  // standard constructor, the view is empty
+  inline CMatrixView();
+  // constructor, rows are aPitch elements apart, aPitch = 0 stands for densely packed rows
+  inline CMatrixView(T* aData, int aXSize, int aYSize, int aPitch = 0, int aHalo = 0);
+
+  // Fills the halo with the values mirrored at the boundaries (see CMatrix::mirror())
+  void mirror() const;
+  // Transforms the values so that they are all between aMin and aMax
+  void normalize(T aMin, T aMax) const;
+  // Clips values that exceed the given range
+  void clip(T aMin, T aMax) const;
+  // Fills the view with the value aValue
+  void fill(const T aValue) const;
+  // Copies the values of a view of the same size into this view
+  void copy(const CMatrixView<T>& aCopyFrom) const;
+  // Saves the view as a picture in pgm-Format
+  void writeToPGM(const char* aFilename) const;
+
+  // Gives full access to the viewed values
+  inline T& operator()(const int ax, const int ay) const;
+  // Gives access to the view's size
+  inline int xSize() const;
+  inline int ySize() const;
+  inline int size() const;
+  // Gives access to the width of the accessible border around the view
+  inline int halo() const;
+  // Gives access to the distance between two rows in memory
+  inline int pitch() const;
+  // Gives access to element (0,0)
+  inline T* data() const;
+protected:
+  T* mData;
+  int mXSize,mYSize;
+  int mPitch,mHalo;
+};
 
 template <class T>
 class CMatrix {
@@ -32,13 +85,24 @@ public:
   inline CMatrix(const int aXSize, const int aYSize);
   // copy constructor
   CMatrix(const CMatrix<T>& aCopyFrom);
+  // move constructor, aMoveFrom is left empty
+  CMatrix(CMatrix<T>&& aMoveFrom);
   // constructor with implicit filling
   CMatrix(const int aXSize, const int aYSize, const T aFillValue);
+  // Wraps aXSize x aYSize elements of memory owned by the caller, rows are aPitchBytes bytes apart
+  // (0 for densely packed rows). The memory is neither copied nor released and must outlive the matrix.
+  // Assigning a matrix of the same size writes into this memory, resizing the matrix or giving it
+  // a halo moves the matrix to memory of its own.
+  CMatrix(T* aData, const int aXSize, const int aYSize, const int aPitchBytes = 0);
   // destructor
   virtual ~CMatrix();
 
   // Changes the size of the matrix, data will be lost
   void setSize(int aXSize, int aYSize);
+  // Surrounds the matrix with a border of aHalo elements on each side, data is kept.
+  // The border is not part of the matrix, it can be filled with mirror() so that
+  // filters read beyond the boundaries without special treatment of the rims.
+  void setHalo(int aHalo);
   // Downsamples the matrix
   void downsampleBool(int aNewXSize, int aNewYSize, float aThreshold = 0.5);
   void downsampleInt(int aNewXSize, int aNewYSize);
@@ -64,6 +128,10 @@ public:
   // Mirrors the boundaries, aFrom is the distance from the boundaries where the pixels are copied from,
   // aTo is the distance from the boundaries they are copied to
   void mirror(int aFrom, int aTo);
+  // Fills the halo with the values mirrored at the boundaries, (-1-i,y) is a copy of (i,y)
+  // and (xSize()+i,y) a copy of (xSize()-1-i,y), the same in y-direction.
+  // Only the halo is written, the matrix' values do not change.
+  void mirror();
   // Transforms the values so that they are all between aMin and aMax
   // aInitialMin/Max are initializations for seeking the minimum and maximum, change if your
   // data is not in this range or the data type T cannot hold these values
@@ -95,6 +163,9 @@ public:
   
   // Reads a picture from a pgm-File
   void readFromPGM(const char* aFilename);
+  // Reads one layer of a ppm-File: channel aChannel (0,1,2) or the luma if aChannel < 0,
+  // aFactor > 1 averages aFactor x aFactor blocks while decoding, it must not exceed the image size
+  void readFromPPM(const char* aFilename, int aChannel = -1, int aFactor = 1);
   // Saves the matrix as a picture in pgm-Format
   void writeToPGM(const char *aFilename);
   // Read matrix from text file
@@ -112,6 +183,9 @@ public:
   inline CMatrix<T>& operator=(const T aValue);
   // Copies the matrix aCopyFrom to this matrix (size of matrix might change)
   CMatrix<T>& operator=(const CMatrix<T>& aCopyFrom);
+  // Takes over the data of aMoveFrom if both matrices have the same halo, copies otherwise.
+  // aMoveFrom is left empty.
+  CMatrix<T>& operator=(CMatrix<T>&& aMoveFrom);
   // matrix sum
   CMatrix<T>& operator+=(const CMatrix<T>& aMatrix);
   // Adds a constant to the matrix
@@ -138,11 +212,33 @@ public:
   inline int size() const;
   // Returns one row from the matrix
   void getVector(CVector<T>& aVector, int ay);
-  // Gives access to the internal data representation
+  // Gives access to the width of the border around the matrix
+  inline int halo() const;
+  // Gives access to the distance between two rows in memory in elements,
+  // xSize()+2*halo() unless the matrix wraps memory of the caller
+  inline int pitch() const;
+  // Gives access to the internal data representation, data() points to element (0,0),
+  // element (x,y) is at data()[y*pitch()+x]
   inline T* data() const;
+  // Returns a view of the matrix including its halo
+  inline CMatrixView<T> view() const;
 protected:
+  // Allocates aXSize x aYSize elements plus the halo, data will be lost
+  void allocate(int aXSize, int aYSize);
+  // Removes the halo and returns its former width, for methods that only work on the plain layout
+  int compact();
+  // Counterpart of compact() after the plain layout has been resized, restores a halo of width aHalo
+  void expand(int aHalo);
+  // Beginning of the allocated memory including the halo
+  inline T* base() const;
+  // Moves wrapped memory of the caller to memory owned by the matrix
+  void own();
+
   int mXSize,mYSize;
   T *mData;
+  int mHalo,mPitch;
+  // False while the matrix wraps memory of the caller
+  bool mOwner;
 };
 
 // Returns a matrix where all negative elements are turned positive
@@ -203,6 +299,16 @@ struct ENonPositiveDefinite {
   }
 };
 
+// Thrown when wrapped memory has a row pitch that is not a whole number of elements
+// or shorter than a row
+struct EInvalidPitch {
+  EInvalidPitch(const int aPitchBytes, const int aElementSize, const int aXSize) {
+    using namespace std;
+    cerr << "Exception EInvalidPitch: " << aPitchBytes << " bytes per row, " << aXSize;
+    cerr << " elements of " << aElementSize << " bytes" << endl;
+  }
+};
+
 // Thrown when reading a file which does not keep to the PGM specification
 struct EInvalidFileFormat {
   EInvalidFileFormat(const char* s) {
@@ -211,6 +317,30 @@ struct EInvalidFileFormat {
   }
 };
 
+// Thrown when a file to be read cannot be opened
+struct EFileNotFound {
+  EFileNotFound(const char* s) {
+    using namespace std;
+    cerr << "File not found: " << s << endl;
+  }
+};
+
+// Thrown when an image is to be reduced by a factor larger than its size
+struct EInvalidReduction {
+  EInvalidReduction(int aFactor, int aXSize, int aYSize) {
+    using namespace std;
+    cerr << "Exception EInvalidReduction: Factor " << aFactor << " exceeds the image size " << aXSize << "x" << aYSize << endl;
+  }
+};
+
+// Thrown when a file to be written cannot be created
+struct EFileNotWritable {
+  EFileNotWritable(const char* s) {
+    using namespace std;
+    cerr << "File cannot be written: " << s << endl;
+  }
+};
+
 // I M P L E M E N T A T I O N --------------------------------------------
 //
 // You might wonder why there is implementation code in a header file.
@@ -227,69 +357,120 @@ struct EInvalidFileFormat {
 template <class T>
 inline CMatrix<T>::CMatrix() {
   mData = 0; mXSize = mYSize = 0;
+  mHalo = mPitch = 0;
+  mOwner = true;
 }
 
 // constructor
 template <class T>
 inline CMatrix<T>::CMatrix(const int aXSize, const int aYSize)
-  : mXSize(aXSize), mYSize(aYSize) {
-  mData = new T[aXSize*aYSize];
+  : mXSize(aXSize), mYSize(aYSize), mHalo(0), mPitch(aXSize), mOwner(true) {
+  mData = NMemory::allocate<T>(aXSize*aYSize);
 }
 
 // copy constructor
 template <class T>
 CMatrix<T>::CMatrix(const CMatrix<T>& aCopyFrom)
-  : mXSize(aCopyFrom.mXSize), mYSize(aCopyFrom.mYSize) {
+  : mXSize(aCopyFrom.mXSize), mYSize(aCopyFrom.mYSize), mHalo(aCopyFrom.mHalo), mPitch(aCopyFrom.mXSize+2*aCopyFrom.mHalo), mOwner(true) {
   if (aCopyFrom.mData == 0) mData = 0;
   else {
-    int wholeSize = mXSize*mYSize;
-    mData = new T[wholeSize];
-    for (register int i = 0; i < wholeSize; i++)
-      mData[i] = aCopyFrom.mData[i];
+    // The halo is copied as well, so a mirrored halo stays valid.
+    // Row by row, since wrapped memory may have a different pitch.
+    int aRows = mYSize+2*mHalo;
+    T* aBase = NMemory::allocate<T>(mPitch*aRows);
+    const T* aCopyBase = aCopyFrom.base();
+    for (int y = 0; y < aRows; y++) {
+      T* aDest = aBase+y*mPitch;
+      const T* aSource = aCopyBase+y*aCopyFrom.mPitch;
+      for (register int x = 0; x < mPitch; x++)
+        aDest[x] = aSource[x];
+    }
+    mData = aBase+mHalo*mPitch+mHalo;
   }
 }
 
+// move constructor
+template <class T>
+CMatrix<T>::CMatrix(CMatrix<T>&& aMoveFrom)
+  : mXSize(aMoveFrom.mXSize), mYSize(aMoveFrom.mYSize), mData(aMoveFrom.mData), mHalo(aMoveFrom.mHalo), mPitch(aMoveFrom.mPitch), mOwner(aMoveFrom.mOwner) {
+  aMoveFrom.mData = 0;
+  aMoveFrom.mXSize = aMoveFrom.mYSize = 0;
+  aMoveFrom.mPitch = 2*aMoveFrom.mHalo;
+  aMoveFrom.mOwner = true;
+}
+
 // constructor with implicit filling
 template <class T>
 CMatrix<T>::CMatrix(const int aXSize, const int aYSize, const T aFillValue)
-  : mXSize(aXSize), mYSize(aYSize) {
-  mData = new T[aXSize*aYSize];
+  : mXSize(aXSize), mYSize(aYSize), mHalo(0), mPitch(aXSize), mOwner(true) {
+  mData = NMemory::allocate<T>(aXSize*aYSize);
   fill(aFillValue);
 }
 
+// constructor wrapping memory of the caller
+template <class T>
+CMatrix<T>::CMatrix(T* aData, const int aXSize, const int aYSize, const int aPitchBytes)
+  : mXSize(aXSize), mYSize(aYSize), mData(aData), mHalo(0), mPitch(aXSize), mOwner(false) {
+  if (aPitchBytes != 0) {
+    if (aPitchBytes % (int)sizeof(T) != 0 || aPitchBytes < aXSize*(int)sizeof(T))
+      throw EInvalidPitch(aPitchBytes,sizeof(T),aXSize);
+    mPitch = aPitchBytes/sizeof(T);
+  }
+}
+
 // destructor
 template <class T>
 CMatrix<T>::~CMatrix() {
-  delete [] mData;
+  if (mOwner) NMemory::release(base());
 }
 
 // setSize
 template <class T>
 void CMatrix<T>::setSize(int aXSize, int aYSize) {
-  if (mData != 0) delete[] mData;
-  mData = new T[aXSize*aYSize];
-  mXSize = aXSize;
-  mYSize = aYSize;
+  allocate(aXSize,aYSize);
+}
+
+// setHalo
+template <class T>
+void CMatrix<T>::setHalo(int aHalo) {
+  if (aHalo < 0) aHalo = 0;
+  if (aHalo == mHalo) return;
+  T* aOldBase = base();
+  T* aOldData = mData;
+  int aOldPitch = mPitch;
+  mHalo = aHalo;
+  mPitch = mXSize+2*mHalo;
+  if (aOldData == 0) return;
+  mData = NMemory::allocate<T>(mPitch*(mYSize+2*mHalo))+mHalo*mPitch+mHalo;
+  for (int y = 0; y < mYSize; y++) {
+    const T* aSource = aOldData+y*aOldPitch;
+    T* aDest = mData+y*mPitch;
+    for (int x = 0; x < mXSize; x++)
+      aDest[x] = aSource[x];
+  }
+  if (mOwner) NMemory::release(aOldBase);
+  mOwner = true;
 }
 
 // downsampleBool
 template <class T>
 void CMatrix<T>::downsampleBool(int aNewXSize, int aNewYSize, float aThreshold) {
   CMatrix<float> aTemp(mXSize,mYSize);
-  int aSize = size();
-  for (int i = 0; i < aSize; i++)
-    aTemp.data()[i] = mData[i];
+  for (int y = 0; y < mYSize; y++)
+    for (int x = 0; x < mXSize; x++)
+      aTemp(x,y) = operator()(x,y);
   aTemp.downsample(aNewXSize,aNewYSize);
   setSize(aNewXSize,aNewYSize);
-  aSize = size();
-  for (int i = 0; i < aSize; i++)
-    mData[i] = (aTemp.data()[i] >= aThreshold);
+  for (int y = 0; y < mYSize; y++)
+    for (int x = 0; x < mXSize; x++)
+      operator()(x,y) = (aTemp(x,y) >= aThreshold);
 }
 
 // downsampleInt
 template <class T>
 void CMatrix<T>::downsampleInt(int aNewXSize, int aNewYSize) {
-  T* newData = new int[aNewXSize*aNewYSize];
+  int aHalo = compact();
+  T* newData = NMemory::allocate<T>(aNewXSize*aNewYSize);
   float factorX = ((float)mXSize)/aNewXSize;
   float factorY = ((float)mYSize)/aNewYSize;
   float ay = 0.0;
@@ -319,16 +500,18 @@ void CMatrix<T>::downsampleInt(int aNewXSize, int aNewYSize) {
     }
     ay += factorY;
   }
-  delete[] mData;
+  NMemory::release(mData);
   mData = newData;
   mXSize = aNewXSize; mYSize = aNewYSize;
+  expand(aHalo);
 }
 
 template <class T>
 void CMatrix<T>::downsample(int aNewXSize, int aNewYSize) {
+  int aHalo = compact();
   // Downsample in x-direction
   int aIntermedSize = aNewXSize*mYSize;
-  T* aIntermedData = new T[aIntermedSize];
+  T* aIntermedData = NMemory::allocate<T>(aIntermedSize);
   if (aNewXSize < mXSize) {
     for (int i = 0; i < aIntermedSize; i++)
       aIntermedData[i] = 0.0;
@@ -369,9 +552,9 @@ void CMatrix<T>::downsample(int aNewXSize, int aNewYSize) {
     mData = aTemp;
   }
   // Downsample in y-direction
-  delete[] mData;
+  NMemory::release(mData);
   int aDataSize = aNewXSize*aNewYSize;
-  mData = new T[aDataSize];
+  mData = NMemory::allocate<T>(aDataSize);
   if (aNewYSize < mYSize) {
     for (int i = 0; i < aDataSize; i++)
       mData[i] = 0.0;
@@ -416,13 +599,15 @@ void CMatrix<T>::downsample(int aNewXSize, int aNewYSize) {
   // Adapt size of matrix
   mXSize = aNewXSize;
   mYSize = aNewYSize;
-  delete[] aIntermedData;
+  NMemory::release(aIntermedData);
+  expand(aHalo);
 }
 
 template <class T>
 void CMatrix<T>::downsample(int aNewXSize, int aNewYSize, CMatrix<float>& aConfidence) {
+  int aHalo = compact();
   int aNewSize = aNewXSize*aNewYSize;
-  T* newData = new T[aNewSize];
+  T* newData = NMemory::allocate<T>(aNewSize);
   float* aCounter = new float[aNewSize];
   for (int i = 0; i < aNewSize; i++) {
     newData[i] = 0;
@@ -469,16 +654,18 @@ void CMatrix<T>::downsample(int aNewXSize, int aNewYSize, CMatrix<float>& aConfi
   // Adapt size of matrix
   mXSize = aNewXSize;
   mYSize = aNewYSize;
-  delete[] mData;
+  NMemory::release(mData);
   delete[] aCounter;
   mData = newData;
+  expand(aHalo);
 }
 
 // downsampleBilinear
 template <class T>
 void CMatrix<T>::downsampleBilinear(int aNewXSize, int aNewYSize) {
+  int aHalo = compact();
   int aNewSize = aNewXSize*aNewYSize;
-  T* aNewData = new T[aNewSize];
+  T* aNewData = NMemory::allocate<T>(aNewSize);
   float factorX = ((float)mXSize)/aNewXSize;
   float factorY = ((float)mYSize)/aNewYSize;
   for (int y = 0; y < aNewYSize; y++)
@@ -501,17 +688,19 @@ void CMatrix<T>::downsampleBilinear(int aNewXSize, int aNewYSize) {
       float b = (1.0-alphaX)*mData[x1+y2*mXSize]+alphaX*mData[x2+y2*mXSize];
       aNewData[x+y*aNewXSize] = (1.0-alphaY)*a+alphaY*b;
     }
-  delete[] mData;
+  NMemory::release(mData);
   mData = aNewData;
   mXSize = aNewXSize;
   mYSize = aNewYSize;
+  expand(aHalo);
 }
 
 template <class T>
 void CMatrix<T>::upsample(int aNewXSize, int aNewYSize) {
+  int aHalo = compact();
   // Upsample in x-direction
   int aIntermedSize = aNewXSize*mYSize;
-  T* aIntermedData = new T[aIntermedSize];
+  T* aIntermedData = NMemory::allocate<T>(aIntermedSize);
   if (aNewXSize > mXSize) {
     for (int i = 0; i < aIntermedSize; i++)
       aIntermedData[i] = 0.0;
@@ -552,9 +741,9 @@ void CMatrix<T>::upsample(int aNewXSize, int aNewYSize) {
     mData = aTemp;
   }
   // Upsample in y-direction
-  delete[] mData;
+  NMemory::release(mData);
   int aDataSize = aNewXSize*aNewYSize;
-  mData = new T[aDataSize];
+  mData = NMemory::allocate<T>(aDataSize);
   if (aNewYSize > mYSize) {
     for (int i = 0; i < aDataSize; i++)
       mData[i] = 0.0;
@@ -595,14 +784,16 @@ void CMatrix<T>::upsample(int aNewXSize, int aNewYSize) {
   // Adapt size of matrix
   mXSize = aNewXSize;
   mYSize = aNewYSize;
-  delete[] aIntermedData;
+  NMemory::release(aIntermedData);
+  expand(aHalo);
 }
 
 // upsampleBilinear
 template <class T>
 void CMatrix<T>::upsampleBilinear(int aNewXSize, int aNewYSize) {
+  int aHalo = compact();
   int aNewSize = aNewXSize*aNewYSize;
-  T* aNewData = new T[aNewSize];
+  T* aNewData = NMemory::allocate<T>(aNewSize);
   float factorX = (float)(mXSize)/(aNewXSize);
   float factorY = (float)(mYSize)/(aNewYSize);
   for (int y = 0; y < aNewYSize; y++)
@@ -625,10 +816,11 @@ void CMatrix<T>::upsampleBilinear(int aNewXSize, int aNewYSize) {
       float b = (1.0-alphaX)*mData[x1+y2*mXSize]+alphaX*mData[x2+y2*mXSize];
       aNewData[x+y*aNewXSize] = (1.0-alphaY)*a+alphaY*b;
     }
-  delete[] mData;
+  NMemory::release(mData);
   mData = aNewData;
   mXSize = aNewXSize;
   mYSize = aNewYSize;
+  expand(aHalo);
 }
 
 template <class T>
@@ -652,12 +844,7 @@ void CMatrix<T>::rescale(int aNewXSize, int aNewYSize) {
 // identity
 template <class T>
 void CMatrix<T>::identity(int aSize) {
-  if (aSize != mXSize || aSize != mYSize) {
-    delete[] mData;
-    mData = new T[aSize*aSize];
-    mXSize = aSize;
-    mYSize = aSize;
-  }
+  if (aSize != mXSize || aSize != mYSize) allocate(aSize,aSize);
   fill(0);
   for (int i = 0; i < aSize; i++)
     operator()(i,i) = 1;
@@ -666,9 +853,11 @@ void CMatrix<T>::identity(int aSize) {
 // fill
 template <class T>
 void CMatrix<T>::fill(const T aValue) {
-  int wholeSize = mXSize*mYSize;
-  for (register int i = 0; i < wholeSize; i++)
-    mData[i] = aValue;
+  for (int y = 0; y < mYSize; y++) {
+    T* aRow = mData+y*mPitch;
+    for (register int x = 0; x < mXSize; x++)
+      aRow[x] = aValue;
+  }
 }
 
 // fillRect
@@ -682,10 +871,7 @@ void CMatrix<T>::fillRect(const T aValue, int ax1, int ay1, int ax2, int ay2) {
 // cut
 template <class T>
 void CMatrix<T>::cut(CMatrix<T>& aResult,const int x1, const int y1, const int x2, const int y2) {
-  aResult.mXSize = x2-x1+1;
-  aResult.mYSize = y2-y1+1;
-  delete[] aResult.mData;
-  aResult.mData = new T[aResult.mXSize*aResult.mYSize];
+  aResult.allocate(x2-x1+1,y2-y1+1);
   for (int y = y1; y <= y2; y++)
     for (int x = x1; x <= x2; x++)
       aResult(x-x1,y-y1) = operator()(x,y);
@@ -716,34 +902,21 @@ void CMatrix<T>::mirror(int aFrom, int aTo) {
   }
 }
 
+template <class T>
+void CMatrix<T>::mirror() {
+  view().mirror();
+}
+
 // normalize
 template <class T>
 void CMatrix<T>::normalize(T aMin, T aMax, T aInitialMin, T aInitialMax) {
-  int aSize = mXSize*mYSize;
-  T aCurrentMin = mData[0];
-  T aCurrentMax = mData[0];
-  for (int i = 0; i < aSize; i++)
-  {
-    if (mData[i] > aCurrentMax) aCurrentMax = mData[i];
-    if (mData[i] < aCurrentMin) aCurrentMin = mData[i];
-  }
-  T aTemp = (aCurrentMax-aCurrentMin);
-  if (aTemp == 0) aTemp = 1;
-  else aTemp = (aMax-aMin)/aTemp;
-  for (int i = 0; i < aSize; i++) {
-    mData[i] -= aCurrentMin;
-    mData[i] *= aTemp;
-    mData[i] += aMin;
-  }
+  view().normalize(aMin,aMax);
 }
 
 // clip
 template <class T>
 void CMatrix<T>::clip(T aMin, T aMax) {
-  int aSize = size();
-  for (int i = 0; i < aSize; i++)
-    if (mData[i] < aMin) mData[i] = aMin;
-    else if (mData[i] > aMax) mData[i] = aMax;
+  view().clip(aMin,aMax);
 }
 
 // applySimilarityTransform
@@ -754,21 +927,20 @@ void CMatrix<T>::applySimilarityTransform(CMatrix<T>& aWarped, CMatrix<bool>& aO
   float ctx = cx+tx-cx*cosphi+cy*sinphi;
   float cty = cy+ty-cy*cosphi-cx*sinphi;
   aOutside = false;
-  int i = 0;
   for (int y = 0; y < aWarped.ySize(); y++)
-    for (int x = 0; x < aWarped.xSize(); x++,i++) {
+    for (int x = 0; x < aWarped.xSize(); x++) {
       float xf = x; float yf = y;
       float ax = xf*cosphi-yf*sinphi+ctx;
       float ay = yf*cosphi+xf*sinphi+cty;
       int x1 = (int)ax; int y1 = (int)ay;
       float alphaX = ax-x1; float alphaY = ay-y1;
       float betaX = 1.0-alphaX; float betaY = 1.0-alphaY;
-      if (x1 < 0 || y1 < 0 || x1+1 >= mXSize || y1+1 >= mYSize) aOutside.data()[i] = true;
+      if (x1 < 0 || y1 < 0 || x1+1 >= mXSize || y1+1 >= mYSize) aOutside(x,y) = true;
       else {
-        int j = y1*mXSize+x1;
+        int j = y1*mPitch+x1;
         float a = betaX*mData[j]       +alphaX*mData[j+1];
-        float b = betaX*mData[j+mXSize]+alphaX*mData[j+1+mXSize];
-        aWarped.data()[i] = betaY*a+alphaY*b;
+        float b = betaX*mData[j+mPitch]+alphaX*mData[j+1+mPitch];
+        aWarped(x,y) = betaY*a+alphaY*b;
       }
     }
 }
@@ -776,26 +948,24 @@ void CMatrix<T>::applySimilarityTransform(CMatrix<T>& aWarped, CMatrix<bool>& aO
 // applyHomography
 template <class T>
 void CMatrix<T>::applyHomography(CMatrix<T>& aWarped, CMatrix<bool>& aOutside, const CMatrix<float>& H) {
-  int aSize = size();
   aOutside = false;
-  int i = 0;
   for (int y = 0; y < aWarped.ySize(); y++)
-    for (int x = 0; x < aWarped.xSize(); x++,i++) {
+    for (int x = 0; x < aWarped.xSize(); x++) {
       float xf = x; float yf = y;
-      float ax = H.data()[0]*xf+H.data()[1]*yf+H.data()[2];
-      float ay = H.data()[3]*xf+H.data()[4]*yf+H.data()[5];
-      float az = H.data()[6]*xf+H.data()[7]*yf+H.data()[8];
+      float ax = H(0,0)*xf+H(1,0)*yf+H(2,0);
+      float ay = H(0,1)*xf+H(1,1)*yf+H(2,1);
+      float az = H(0,2)*xf+H(1,2)*yf+H(2,2);
       float invaz = 1.0/az;
       ax *= invaz; ay *= invaz;
       int x1 = (int)ax; int y1 = (int)ay;
       float alphaX = ax-x1; float alphaY = ay-y1;
       float betaX = 1.0-alphaX; float betaY = 1.0-alphaY;
-      if (x1 < 0 || y1 < 0 || x1+1 >= mXSize || y1+1 >= mYSize) aOutside.data()[i] = true;
+      if (x1 < 0 || y1 < 0 || x1+1 >= mXSize || y1+1 >= mYSize) aOutside(x,y) = true;
       else {
-        int j = y1*mXSize+x1;
+        int j = y1*mPitch+x1;
         float a = betaX*mData[j]       +alphaX*mData[j+1];
-        float b = betaX*mData[j+mXSize]+alphaX*mData[j+1+mXSize];
-        aWarped.data()[i] = betaY*a+alphaY*b;
+        float b = betaX*mData[j+mPitch]+alphaX*mData[j+1+mPitch];
+        aWarped(x,y) = betaY*a+alphaY*b;
       }
     }
 }
@@ -809,11 +979,11 @@ void CMatrix<T>::drawLine(int dStartX, int dStartY, int dEndX, int dEndY, T aVal
         int x = dStartX;
         if (dStartY < dEndY) {
             for (int y = dStartY; y <= dEndY; y++)
-                if (y >= 0 && y < mYSize) mData[x+y*mXSize] = aValue;
+                if (y >= 0 && y < mYSize) mData[x+y*mPitch] = aValue;
     }
         else {
             for (int y = dStartY; y >= dEndY; y--)
-                if (y >= 0 && y < mYSize) mData[x+y*mXSize] = aValue;
+                if (y >= 0 && y < mYSize) mData[x+y*mPitch] = aValue;
     }
     return;
   }
@@ -823,11 +993,11 @@ void CMatrix<T>::drawLine(int dStartX, int dStartY, int dEndX, int dEndY, T aVal
         int y = dStartY;
         if (dStartX < dEndX) {
             for (int x = dStartX; x <= dEndX; x++)
-                if (x >= 0 && x < mXSize) mData[x+y*mXSize] = aValue;
+                if (x >= 0 && x < mXSize) mData[x+y*mPitch] = aValue;
     }
         else {
             for (int x = dStartX; x >= dEndX; x--)
-                if (x >= 0 && x < mXSize) mData[x+y*mXSize] = aValue;
+                if (x >= 0 && x < mXSize) mData[x+y*mPitch] = aValue;
     }
     return;
   }
@@ -838,14 +1008,14 @@ void CMatrix<T>::drawLine(int dStartX, int dStartY, int dEndX, int dEndY, T aVal
       for (int y = dStartY; y <= dEndY; y++) {
         int x = (int)(0.5+dStartX+(y-dStartY)*invm);
         if (x >= 0 && x < mXSize && y >= 0 && y < mYSize)
-          mData[x+y*mXSize] = aValue;
+          mData[x+y*mPitch] = aValue;
       }
     }
     else {
       for (int y = dStartY; y >= dEndY; y--) {
         int x = (int)(0.5+dStartX+(y-dStartY)*invm);
         if (x >= 0 && x < mXSize && y >= 0 && y < mYSize)
-          mData[x+y*mXSize] = aValue;
+          mData[x+y*mPitch] = aValue;
       }
     }
   }
@@ -854,14 +1024,14 @@ void CMatrix<T>::drawLine(int dStartX, int dStartY, int dEndX, int dEndY, T aVal
       for (int x = dStartX; x <= dEndX; x++) {
         int y = (int)(0.5+dStartY+(x-dStartX)*m);
         if (x >= 0 && x < mXSize && y >= 0 && y < mYSize)
-          mData[x+y*mXSize] = aValue;
+          mData[x+y*mPitch] = aValue;
       }
     }
     else {
       for (int x = dStartX; x >= dEndX; x--) {
         int y = (int)(0.5+dStartY+(x-dStartX)*m);
         if (x >= 0 && x < mXSize && y >= 0 && y < mYSize)
-          mData[x+y*mXSize] = aValue;
+          mData[x+y*mPitch] = aValue;
       }
     }
   }
@@ -870,9 +1040,11 @@ void CMatrix<T>::drawLine(int dStartX, int dStartY, int dEndX, int dEndY, T aVal
 // invertImage
 template <class T>
 void CMatrix<T>::invertImage() {
-  int aSize = mXSize*mYSize;
-  for (int i = 0; i < aSize; i++)
-    mData[i] = 255-mData[i];
+  for (int y = 0; y < mYSize; y++) {
+    T* aRow = mData+y*mPitch;
+    for (int x = 0; x < mXSize; x++)
+      aRow[x] = 255-aRow[x];
+  }
 }
 
 // connectedComponent
@@ -907,10 +1079,10 @@ void CMatrix<T>::connectedComponent (int x, int y) {
 	  }
     while (x <= x2);
   }
-  int aSize = size();
-  for (int i = 0; i < aSize; i++)
-	  if (aConnected.data()[i]) mData[i] = 255;
-	  else mData[i] = 0;
+  for (int y = 0; y < mYSize; y++)
+    for (int x = 0; x < mXSize; x++)
+	    if (aConnected(x,y)) operator()(x,y) = 255;
+	    else operator()(x,y) = 0;
   #undef PUSH
   #undef POP
 }
@@ -921,16 +1093,18 @@ void CMatrix<T>::append(CMatrix<T>& aMatrix) {
   #ifdef _DEBUG
   if (aMatrix.xSize() != mXSize) throw EIncompatibleMatrices(mXSize,mYSize,aMatrix.xSize(),aMatrix.ySize());
   #endif
-  T* aNew = new T[mXSize*(mYSize+aMatrix.ySize())];
+  int aHalo = compact();
+  T* aNew = NMemory::allocate<T>(mXSize*(mYSize+aMatrix.ySize()));
   int aSize = mXSize*mYSize;
   for (int i = 0; i < aSize; i++)
     aNew[i] = mData[i];
-  int aSize2 = mXSize*aMatrix.ySize();
-  for (int i = 0; i < aSize2; i++)
-    aNew[i+aSize] = aMatrix.data()[i];
-  delete[] mData;
+  for (int y = 0; y < aMatrix.ySize(); y++)
+    for (int x = 0; x < mXSize; x++)
+      aNew[aSize+y*mXSize+x] = aMatrix(x,y);
+  NMemory::release(mData);
   mData = aNew;
   mYSize += aMatrix.ySize();
+  expand(aHalo);
 }
 
 // inv
@@ -938,7 +1112,7 @@ template <class T>
 void CMatrix<T>::inv() {
   if (mXSize != mYSize) throw ENonquadraticMatrix(mXSize,mYSize);
   int* p = new int[mXSize];
-  T* hv = new T[mXSize];
+  T* hv = NMemory::allocate<T>(mXSize);
     CMatrix<T>& I(*this);
     int n = mYSize;
     for (int j = 0; j < n; j++)
@@ -983,7 +1157,7 @@ void CMatrix<T>::inv() {
       I(k,i) = hv[k];
   }
   delete[] p;
-  delete[] hv;
+  NMemory::release(hv);
 }
 
 template <class T>
@@ -1002,9 +1176,9 @@ float CMatrix<T>::scalar(CVector<T>& aLeft, CVector<T>& aRight) {
   if ((aLeft.size() != mYSize) || (aRight.size() != mXSize))
     throw EIncompatibleMatrices(mXSize,mYSize,aRight.size(),aLeft.size());
   #endif
-  T* vec = new T[mYSize];
-  T* dat = mData;
+  T* vec = NMemory::allocate<T>(mYSize);
   for (int y = 0; y < mYSize; y++) {
+    T* dat = mData+y*mPitch;
     vec[y] = 0;
     for (int x = 0; x < mXSize; x++)
       vec[y] += *(dat++)*aRight(x);
@@ -1012,65 +1186,55 @@ float CMatrix<T>::scalar(CVector<T>& aLeft, CVector<T>& aRight) {
   T aResult = 0.0;
   for (int y = 0; y < mYSize; y++)
     aResult += vec[y]*aLeft(y);
-  delete[] vec;
+  NMemory::release(vec);
   return aResult;
 }
 
 // readFromPGM
 template <class T>
 void CMatrix<T>::readFromPGM(const char* aFilename) {
-  FILE *aStream;
-  aStream = fopen(aFilename,"rb");
-  if (aStream == 0) std::cerr << "File not found: " << aFilename << std::endl;
-  int dummy;
-  // Find beginning of file (P5)
-  while (getc(aStream) != 'P');
-  if (getc(aStream) != '5') throw EInvalidFileFormat("PGM");
-  do dummy = getc(aStream); while (dummy != '\n' && dummy != ' ');
-  // Remove comments and empty lines
-  dummy = getc(aStream);
-  while (dummy == '#') {
-    while (getc(aStream) != '\n');
-    dummy = getc(aStream);
-  }
-  while (dummy == '\n')
-    dummy = getc(aStream);
-  // Read image size
-  mXSize = dummy-48;
-  while ((dummy = getc(aStream)) >= 48 && dummy < 58)
-    mXSize = 10*mXSize+dummy-48;
-  while ((dummy = getc(aStream)) < 48 || dummy >= 58);
-  mYSize = dummy-48;
-  while ((dummy = getc(aStream)) >= 48 && dummy < 58)
-    mYSize = 10*mYSize+dummy-48;
-  while (dummy != '\n' && dummy != ' ')
-    dummy = getc(aStream);
-  while ((dummy = getc(aStream)) >= 48 && dummy < 58);
-  if (dummy != '\n') while (getc(aStream) != '\n');
+  int aXSize,aYSize;
+  const unsigned char* aPixels;
+  NPNM::EStatus aStatus = NPNM::read(aFilename,'5',aXSize,aYSize,aPixels);
+  if (aStatus == NPNM::cNotFound) throw EFileNotFound(aFilename);
+  if (aStatus != NPNM::cOK) throw EInvalidFileFormat("PGM");
   // Adjust size of data structure
-  delete[] mData;
-  mData = new T[mXSize*mYSize];
+  if (mXSize != aXSize || mYSize != aYSize) allocate(aXSize,aYSize);
   // Read image data
-  for (int i = 0; i < mXSize*mYSize; i++)
-    mData[i] = getc(aStream);
-  fclose(aStream);
+  // Rows without gaps in between are converted at once
+  if (mPitch == mXSize) NPNM::widen(aPixels,mData,mXSize*mYSize);
+  else for (int y = 0; y < mYSize; y++)
+    NPNM::widen(aPixels+y*mXSize,mData+y*mPitch,mXSize);
+}
+
+// readFromPPM
+template <class T>
+void CMatrix<T>::readFromPPM(const char* aFilename, int aChannel, int aFactor) {
+  int aXSize,aYSize;
+  const unsigned char* aPixels;
+  NPNM::EStatus aStatus = NPNM::read(aFilename,'6',aXSize,aYSize,aPixels);
+  if (aStatus == NPNM::cNotFound) throw EFileNotFound(aFilename);
+  if (aStatus != NPNM::cOK) throw EInvalidFileFormat("PPM");
+  if (aFactor < 1) aFactor = 1;
+  if (aFactor > aXSize || aFactor > aYSize) throw EInvalidReduction(aFactor,aXSize,aYSize);
+  int aNewXSize = aXSize/aFactor;
+  int aNewYSize = aYSize/aFactor;
+  // Adjust size of data structure
+  if (mXSize != aNewXSize || mYSize != aNewYSize) allocate(aNewXSize,aNewYSize);
+  // Read image data
+  if (aFactor > 1) NPNM::boxReduce(aPixels,aXSize,aYSize,aChannel,aFactor,mData,mPitch);
+  else for (int y = 0; y < (mPitch == mXSize ? 1 : mYSize); y++) {
+    // Rows without gaps in between (no halo, no padded pitch) are converted at once
+    int aCount = (mPitch == mXSize) ? mXSize*mYSize : mXSize;
+    if (aChannel < 0) NPNM::luma(aPixels+3*y*mXSize,mData+y*mPitch,aCount);
+    else NPNM::extractChannel(aPixels+3*y*mXSize,aChannel,mData+y*mPitch,aCount);
+  }
 }
 
 // writeToPGM
 template <class T>
 void CMatrix<T>::writeToPGM(const char *aFilename) {
-  FILE *aStream;
-  aStream = fopen(aFilename,"wb");
-  // write header
-  char line[60];
-  sprintf(line,"P5\n%d %d\n255\n",mXSize,mYSize);
-  fwrite(line,strlen(line),1,aStream);
-  // write data
-  for (int i = 0; i < mXSize*mYSize; i++) {
-    char dummy = (char)mData[i];
-    fwrite(&dummy,1,1,aStream);
-  }
-  fclose(aStream);
+  view().writeToPGM(aFilename);
 }
 
 // readFromTXT
@@ -1083,11 +1247,11 @@ void CMatrix<T>::readFromTXT(const char* aFilename, bool aHeader, int aXSize, in
     mXSize = aXSize; mYSize = aYSize;
   }
   // Adjust size of data structure
-  delete[] mData;
-  mData = new T[mXSize*mYSize];
+  allocate(mXSize,mYSize);
   // read data
-  for (int i = 0; i < mXSize*mYSize; i++)
-    aStream >> mData[i];
+  for (int y = 0; y < mYSize; y++)
+    for (int x = 0; x < mXSize; x++)
+      aStream >> mData[y*mPitch+x];
 }
 
 // readFromMatlabTXT
@@ -1104,11 +1268,11 @@ void CMatrix<T>::readFromMatlabTXT(const char* aFilename, bool aHeader, int aXSi
     mXSize = aXSize; mYSize = aYSize;
   }
   // Adjust size of data structure
-  delete[] mData;
-  mData = new T[mXSize*mYSize];
+  allocate(mXSize,mYSize);
   // read data
-  for (int i = 0; i < mXSize*mYSize; i++)
-    aStream >> mData[i];
+  for (int y = 0; y < mYSize; y++)
+    for (int x = 0; x < mXSize; x++)
+      aStream >> mData[y*mPitch+x];
 }
 
 //writeToTXT
@@ -1118,10 +1282,9 @@ void CMatrix<T>::writeToTXT(const char* aFilename, bool aHeader) {
   // write header
   if (aHeader) aStream << mXSize << " " << mYSize << std::endl;
   // write data
-  int i = 0;
   for (int y = 0; y < mYSize; y++) {
-    for (int x = 0; x < mXSize; x++, i++)
-      aStream << mData[i] << " ";
+    for (int x = 0; x < mXSize; x++)
+      aStream << mData[y*mPitch+x] << " ";
     aStream << std::endl;
   }
 }
@@ -1139,7 +1302,7 @@ inline T& CMatrix<T>::operator()(const int ax, const int ay) const {
     if (ax >= mXSize || ay >= mYSize || ax < 0 || ay < 0)
       throw EMatrixRangeOverflow(ax,ay);
   #endif
-  return mData[mXSize*ay+ax];
+  return mData[mPitch*ay+ax];
 }
 
 // operator =
@@ -1152,36 +1315,73 @@ inline CMatrix<T>& CMatrix<T>::operator=(const T aValue) {
 template <class T>
 CMatrix<T>& CMatrix<T>::operator=(const CMatrix<T>& aCopyFrom) {
   if (this != &aCopyFrom) {
-    if (mData != 0) delete[] mData;
-    mXSize = aCopyFrom.mXSize;
-    mYSize = aCopyFrom.mYSize;
-    if (aCopyFrom.mData == 0) mData = 0;
+    // The halo of this matrix is kept, only the values are copied
+    if (aCopyFrom.mData == 0) {
+      if (mOwner) NMemory::release(base());
+      mData = 0;
+      mOwner = true;
+      mXSize = aCopyFrom.mXSize;
+      mYSize = aCopyFrom.mYSize;
+      mPitch = mXSize+2*mHalo;
+    }
     else {
-      int wholeSize = mXSize*mYSize;
-      mData = new T[wholeSize];
-      for (register int i = 0; i < wholeSize; i++)
-        mData[i] = aCopyFrom.mData[i];
+      if (mData == 0 || mXSize != aCopyFrom.mXSize || mYSize != aCopyFrom.mYSize)
+        allocate(aCopyFrom.mXSize,aCopyFrom.mYSize);
+      for (int y = 0; y < mYSize; y++) {
+        T* aDest = mData+y*mPitch;
+        const T* aSource = aCopyFrom.mData+y*aCopyFrom.mPitch;
+        for (register int x = 0; x < mXSize; x++)
+          aDest[x] = aSource[x];
+      }
     }
   }
   return *this;
 }
 
+template <class T>
+CMatrix<T>& CMatrix<T>::operator=(CMatrix<T>&& aMoveFrom) {
+  if (this == &aMoveFrom) return *this;
+  if (mHalo != aMoveFrom.mHalo || !mOwner || !aMoveFrom.mOwner) {
+    // The halo of this matrix is kept, as with the copy assignment,
+    // and wrapped memory is written to instead of being replaced
+    operator=((const CMatrix<T>&)aMoveFrom);
+    if (aMoveFrom.mOwner) NMemory::release(aMoveFrom.base());
+  }
+  else {
+    NMemory::release(base());
+    mXSize = aMoveFrom.mXSize;
+    mYSize = aMoveFrom.mYSize;
+    mData = aMoveFrom.mData;
+    mPitch = aMoveFrom.mPitch;
+  }
+  aMoveFrom.mData = 0;
+  aMoveFrom.mXSize = aMoveFrom.mYSize = 0;
+  aMoveFrom.mPitch = 2*aMoveFrom.mHalo;
+  aMoveFrom.mOwner = true;
+  return *this;
+}
+
 // operator +=
 template <class T>
 CMatrix<T>& CMatrix<T>::operator+=(const CMatrix<T>& aMatrix) {
   if ((mXSize != aMatrix.mXSize) || (mYSize != aMatrix.mYSize))
     throw EIncompatibleMatrices(mXSize,mYSize,aMatrix.mXSize,aMatrix.mYSize);
-  int wholeSize = mXSize*mYSize;
-  for (int i = 0; i < wholeSize; i++)
-    mData[i] += aMatrix.mData[i];
+  for (int y = 0; y < mYSize; y++) {
+    T* aRow = mData+y*mPitch;
+    const T* aRow2 = aMatrix.mData+y*aMatrix.mPitch;
+    for (int x = 0; x < mXSize; x++)
+      aRow[x] += aRow2[x];
+  }
   return *this;
 }
 
 template <class T>
 CMatrix<T>& CMatrix<T>::operator+=(const T aValue) {
-  int wholeSize = mXSize*mYSize;
-  for (int i = 0; i < wholeSize; i++)
-    mData[i] += aValue;
+  for (int y = 0; y < mYSize; y++) {
+    T* aRow = mData+y*mPitch;
+    for (int x = 0; x < mXSize; x++)
+      aRow[x] += aValue;
+  }
   return *this;
 }
 
@@ -1190,9 +1390,12 @@ template <class T>
 CMatrix<T>& CMatrix<T>::operator-=(const CMatrix<T>& aMatrix) {
   if ((mXSize != aMatrix.mXSize) || (mYSize != aMatrix.mYSize))
     throw EIncompatibleMatrices(mXSize,mYSize,aMatrix.mXSize,aMatrix.mYSize);
-  int wholeSize = mXSize*mYSize;
-  for (int i = 0; i < wholeSize; i++)
-    mData[i] -= aMatrix.mData[i];
+  for (int y = 0; y < mYSize; y++) {
+    T* aRow = mData+y*mPitch;
+    const T* aRow2 = aMatrix.mData+y*aMatrix.mPitch;
+    for (int x = 0; x < mXSize; x++)
+      aRow[x] -= aRow2[x];
+  }
   return *this;
 }
 
@@ -1201,24 +1404,28 @@ template <class T>
 CMatrix<T>& CMatrix<T>::operator*=(const CMatrix<T>& aMatrix) {
   if (mXSize != aMatrix.mYSize)
     throw EIncompatibleMatrices(mXSize,mYSize,aMatrix.mXSize,aMatrix.mYSize);
+  int aHalo = compact();
   T* oldData = mData;
-  mData = new T[mYSize*aMatrix.mXSize];
+  mData = NMemory::allocate<T>(mYSize*aMatrix.mXSize);
   for (int y = 0; y < mYSize; y++)
     for (int x = 0; x < aMatrix.mXSize; x++) {
       mData[aMatrix.mXSize*y+x] = 0;
       for (int i = 0; i < mXSize; i++)
         mData[aMatrix.mXSize*y+x] += oldData[mXSize*y+i]*aMatrix(x,i);
     }
-  delete[] oldData;
+  NMemory::release(oldData);
   mXSize = aMatrix.mXSize;
+  expand(aHalo);
   return *this;
 }
 
 template <class T>
 CMatrix<T>& CMatrix<T>::operator*=(const T aValue) {
-  int wholeSize = mXSize*mYSize;
-  for (int i = 0; i < wholeSize; i++)
-    mData[i] *= aValue;
+  for (int y = 0; y < mYSize; y++) {
+    T* aRow = mData+y*mPitch;
+    for (int x = 0; x < mXSize; x++)
+      aRow[x] *= aValue;
+  }
   return *this;
 }
 
@@ -1226,9 +1433,11 @@ CMatrix<T>& CMatrix<T>::operator*=(const T aValue) {
 template <class T>
 T CMatrix<T>::min() const {
   T aMin = mData[0];
-  int aSize = mXSize*mYSize;
-  for (int i = 1; i < aSize; i++)
-    if (mData[i] < aMin) aMin = mData[i];
+  for (int y = 0; y < mYSize; y++) {
+    const T* aRow = mData+y*mPitch;
+    for (int x = 0; x < mXSize; x++)
+      if (aRow[x] < aMin) aMin = aRow[x];
+  }
   return aMin;
 }
 
@@ -1236,9 +1445,11 @@ T CMatrix<T>::min() const {
 template <class T>
 T CMatrix<T>::max() const {
   T aMax = mData[0];
-  int aSize = mXSize*mYSize;
-  for (int i = 1; i < aSize; i++)
-    if (mData[i] > aMax) aMax = mData[i];
+  for (int y = 0; y < mYSize; y++) {
+    const T* aRow = mData+y*mPitch;
+    for (int x = 0; x < mXSize; x++)
+      if (aRow[x] > aMax) aMax = aRow[x];
+  }
   return aMax;
 }
 
@@ -1246,10 +1457,12 @@ T CMatrix<T>::max() const {
 template <class T>
 T CMatrix<T>::avg() const {
   T aAvg = 0;
-  int aSize = mXSize*mYSize;
-  for (int i = 0; i < aSize; i++)
-    aAvg += mData[i];
-  return aAvg/aSize;
+  for (int y = 0; y < mYSize; y++) {
+    const T* aRow = mData+y*mPitch;
+    for (int x = 0; x < mXSize; x++)
+      aAvg += aRow[x];
+  }
+  return aAvg/size();
 }
 
 // xSize
@@ -1273,28 +1486,100 @@ inline int CMatrix<T>::size() const {
 // getVector
 template <class T>
 void CMatrix<T>::getVector(CVector<T>& aVector, int ay) {
-  int aOffset = mXSize*ay; 
+  int aOffset = mPitch*ay;
   for (int x = 0; x < mXSize; x++)
     aVector(x) = mData[x+aOffset];
 }
 
+// halo
+template <class T>
+inline int CMatrix<T>::halo() const {
+  return mHalo;
+}
+
+// pitch
+template <class T>
+inline int CMatrix<T>::pitch() const {
+  return mPitch;
+}
+
 // data()
 template <class T>
 inline T* CMatrix<T>::data() const {
   return mData;
 }
 
+// P R O T E C T E D ------------------------------------------------------
+
+// allocate
+template <class T>
+void CMatrix<T>::allocate(int aXSize, int aYSize) {
+  if (mOwner) NMemory::release(base());
+  mOwner = true;
+  mXSize = aXSize;
+  mYSize = aYSize;
+  mPitch = mXSize+2*mHalo;
+  mData = NMemory::allocate<T>(mPitch*(mYSize+2*mHalo))+mHalo*mPitch+mHalo;
+}
+
+// compact
+template <class T>
+int CMatrix<T>::compact() {
+  int aHalo = mHalo;
+  own();
+  setHalo(0);
+  return aHalo;
+}
+
+// expand
+template <class T>
+void CMatrix<T>::expand(int aHalo) {
+  mPitch = mXSize;
+  setHalo(aHalo);
+}
+
+// view
+template <class T>
+inline CMatrixView<T> CMatrix<T>::view() const {
+  return CMatrixView<T>(mData,mXSize,mYSize,mPitch,mHalo);
+}
+
+// base
+template <class T>
+inline T* CMatrix<T>::base() const {
+  if (mData == 0) return 0;
+  return mData-mHalo*mPitch-mHalo;
+}
+
+// own
+template <class T>
+void CMatrix<T>::own() {
+  if (mOwner) return;
+  mOwner = true;
+  if (mData == 0) return;
+  T* aOldData = mData;
+  int aOldPitch = mPitch;
+  mPitch = mXSize+2*mHalo;
+  mData = NMemory::allocate<T>(mPitch*(mYSize+2*mHalo))+mHalo*mPitch+mHalo;
+  for (int y = 0; y < mYSize; y++) {
+    const T* aSource = aOldData+y*aOldPitch;
+    T* aDest = mData+y*mPitch;
+    for (int x = 0; x < mXSize; x++)
+      aDest[x] = aSource[x];
+  }
+}
+
 // N O N - M E M B E R  F U N C T I O N S --------------------------------------
 
 // abs
 template <class T>
 CMatrix<T> abs(const CMatrix<T>& aMatrix) {
   CMatrix<T> result(aMatrix.xSize(),aMatrix.ySize());
-  int wholeSize = aMatrix.size();
-  for (register int i = 0; i < wholeSize; i++) {
-    if (aMatrix.data()[i] < 0) result.data()[i] = -aMatrix.data()[i];
-    else result.data()[i] = aMatrix.data()[i];
-  }
+  for (int y = 0; y < aMatrix.ySize(); y++)
+    for (register int x = 0; x < aMatrix.xSize(); x++) {
+      if (aMatrix(x,y) < 0) result(x,y) = -aMatrix(x,y);
+      else result(x,y) = aMatrix(x,y);
+    }
   return result;
 }
 
@@ -1314,9 +1599,9 @@ CMatrix<T> operator+(const CMatrix<T>& aM1, const CMatrix<T>& aM2) {
   if ((aM1.xSize() != aM2.xSize()) || (aM1.ySize() != aM2.ySize()))
     throw EIncompatibleMatrices(aM1.xSize(),aM1.ySize(),aM2.xSize(),aM2.ySize());
   CMatrix<T> result(aM1.xSize(),aM1.ySize());
-  int wholeSize = aM1.xSize()*aM1.ySize();
-  for (int i = 0; i < wholeSize; i++)
-    result.data()[i] = aM1.data()[i] + aM2.data()[i];
+  for (int y = 0; y < aM1.ySize(); y++)
+    for (int x = 0; x < aM1.xSize(); x++)
+      result(x,y) = aM1(x,y) + aM2(x,y);
   return result;
 }
 
@@ -1326,9 +1611,9 @@ CMatrix<T> operator-(const CMatrix<T>& aM1, const CMatrix<T>& aM2) {
   if ((aM1.xSize() != aM2.xSize()) || (aM1.ySize() != aM2.ySize()))
     throw EIncompatibleMatrices(aM1.xSize(),aM1.ySize(),aM2.xSize(),aM2.ySize());
   CMatrix<T> result(aM1.xSize(),aM1.ySize());
-  int wholeSize = aM1.xSize()*aM1.ySize();
-  for (int i = 0; i < wholeSize; i++)
-    result.data()[i] = aM1.data()[i] - aM2.data()[i];
+  for (int y = 0; y < aM1.ySize(); y++)
+    for (int x = 0; x < aM1.xSize(); x++)
+      result(x,y) = aM1(x,y) - aM2(x,y);
   return result;
 }
 
@@ -1359,9 +1644,9 @@ CVector<T> operator*(const CMatrix<T>& aMatrix, const CVector<T>& aVector) {
 template <class T>
 CMatrix<T> operator*(const CMatrix<T>& aMatrix, const T aValue) {
   CMatrix<T> result(aMatrix.xSize(),aMatrix.ySize());
-  int wholeSize = aMatrix.xSize()*aMatrix.ySize();
-  for (int i = 0; i < wholeSize; i++)
-    result.data()[i] = aMatrix.data()[i]*aValue;
+  for (int y = 0; y < aMatrix.ySize(); y++)
+    for (int x = 0; x < aMatrix.xSize(); x++)
+      result(x,y) = aMatrix(x,y)*aValue;
   return result;
 }
 
@@ -1388,10 +1673,181 @@ template <class T>  bool CMatrix<T>::operator==(const CMatrix<T>& aMatrix)
   if((*this).size()!=aMatrix.size())
     return false;
 
-  for(int i=0; i<aMatrix.size();i++)
-    if(mData[i] != aMatrix.mData[i])
-      return false;
+  for(int y=0; y<mYSize; y++)
+    for(int x=0; x<mXSize; x++)
+      if(operator()(x,y) != aMatrix(x,y))
+        return false;
   return true;
 }
 
+// C M A T R I X V I E W ------------------------------------------------------
+
+// standard constructor
+template <class T>
+inline CMatrixView<T>::CMatrixView()
+  : mData(0),mXSize(0),mYSize(0),mPitch(0),mHalo(0) {
+}
+
+// constructor
+template <class T>
+inline CMatrixView<T>::CMatrixView(T* aData, int aXSize, int aYSize, int aPitch, int aHalo)
+  : mData(aData),mXSize(aXSize),mYSize(aYSize),mPitch(aPitch),mHalo(aHalo) {
+  if (mPitch == 0) mPitch = mXSize;
+}
+
+// mirror
+template <class T>
+void CMatrixView<T>::mirror() const {
+  if (mData == 0 || mHalo == 0) return;
+  // A halo wider than the view is only filled as far as there are values to mirror
+  int aXHalo = (mHalo < mXSize) ? mHalo : mXSize;
+  int aYHalo = (mHalo < mYSize) ? mHalo : mYSize;
+  // Left and right border of each row
+  for (int y = 0; y < mYSize; y++) {
+    T* aRow = mData+y*mPitch;
+    T* aEnd = aRow+mXSize;
+    for (int i = 0; i < aXHalo; i++) {
+      aRow[-1-i] = aRow[i];
+      aEnd[i] = aEnd[-1-i];
+    }
+  }
+  // Upper and lower border as whole rows including the corners, these copies are vectorized
+  int aWidth = mXSize+2*aXHalo;
+  for (int i = 0; i < aYHalo; i++) {
+    const T* aSource = mData+i*mPitch-aXHalo;
+    T* aDest = mData+(-1-i)*mPitch-aXHalo;
+    for (int x = 0; x < aWidth; x++)
+      aDest[x] = aSource[x];
+    aSource = mData+(mYSize-1-i)*mPitch-aXHalo;
+    aDest = mData+(mYSize+i)*mPitch-aXHalo;
+    for (int x = 0; x < aWidth; x++)
+      aDest[x] = aSource[x];
+  }
+}
+
+// normalize
+template <class T>
+void CMatrixView<T>::normalize(T aMin, T aMax) const {
+  T aCurrentMin = mData[0];
+  T aCurrentMax = mData[0];
+  for (int y = 0; y < mYSize; y++) {
+    T* aRow = mData+y*mPitch;
+    for (int x = 0; x < mXSize; x++)
+    {
+      if (aRow[x] > aCurrentMax) aCurrentMax = aRow[x];
+      if (aRow[x] < aCurrentMin) aCurrentMin = aRow[x];
+    }
+  }
+  T aTemp = (aCurrentMax-aCurrentMin);
+  if (aTemp == 0) aTemp = 1;
+  else aTemp = (aMax-aMin)/aTemp;
+  for (int y = 0; y < mYSize; y++) {
+    T* aRow = mData+y*mPitch;
+    for (int x = 0; x < mXSize; x++) {
+      aRow[x] -= aCurrentMin;
+      aRow[x] *= aTemp;
+      aRow[x] += aMin;
+    }
+  }
+}
+
+// clip
+template <class T>
+void CMatrixView<T>::clip(T aMin, T aMax) const {
+  for (int y = 0; y < mYSize; y++) {
+    T* aRow = mData+y*mPitch;
+    for (int x = 0; x < mXSize; x++)
+      if (aRow[x] < aMin) aRow[x] = aMin;
+      else if (aRow[x] > aMax) aRow[x] = aMax;
+  }
+}
+
+// fill
+template <class T>
+void CMatrixView<T>::fill(const T aValue) const {
+  for (int y = 0; y < mYSize; y++) {
+    T* aRow = mData+y*mPitch;
+    for (int x = 0; x < mXSize; x++)
+      aRow[x] = aValue;
+  }
+}
+
+// copy
+template <class T>
+void CMatrixView<T>::copy(const CMatrixView<T>& aCopyFrom) const {
+  if (aCopyFrom.xSize() != mXSize || aCopyFrom.ySize() != mYSize)
+    throw EIncompatibleMatrices(mXSize,mYSize,aCopyFrom.xSize(),aCopyFrom.ySize());
+  for (int y = 0; y < mYSize; y++) {
+    const T* aSource = aCopyFrom.data()+y*aCopyFrom.pitch();
+    T* aRow = mData+y*mPitch;
+    for (int x = 0; x < mXSize; x++)
+      aRow[x] = aSource[x];
+  }
+}
+
+// writeToPGM
+template <class T>
+void CMatrixView<T>::writeToPGM(const char* aFilename) const {
+  FILE *aStream;
+  aStream = fopen(aFilename,"wb");
+  if (aStream == 0) throw EFileNotWritable(aFilename);
+  // write header
+  char line[60];
+  sprintf(line,"P5\n%d %d\n255\n",mXSize,mYSize);
+  fwrite(line,strlen(line),1,aStream);
+  // write data
+  for (int y = 0; y < mYSize; y++)
+    for (int x = 0; x < mXSize; x++) {
+      char dummy = (char)mData[y*mPitch+x];
+      fwrite(&dummy,1,1,aStream);
+    }
+  fclose(aStream);
+}
+
+// operator()
+template <class T>
+inline T& CMatrixView<T>::operator()(const int ax, const int ay) const {
+  #ifdef _DEBUG
+    if (ax >= mXSize+mHalo || ay >= mYSize+mHalo || ax < -mHalo || ay < -mHalo)
+      throw EMatrixRangeOverflow(ax,ay);
+  #endif
+  return mData[mPitch*ay+ax];
+}
+
+// xSize
+template <class T>
+inline int CMatrixView<T>::xSize() const {
+  return mXSize;
+}
+
+// ySize
+template <class T>
+inline int CMatrixView<T>::ySize() const {
+  return mYSize;
+}
+
+// size
+template <class T>
+inline int CMatrixView<T>::size() const {
+  return mXSize*mYSize;
+}
+
+// halo
+template <class T>
+inline int CMatrixView<T>::halo() const {
+  return mHalo;
+}
+
+// pitch
+template <class T>
+inline int CMatrixView<T>::pitch() const {
+  return mPitch;
+}
+
+// data
+template <class T>
+inline T* CMatrixView<T>::data() const {
+  return mData;
+}
+
 #endif
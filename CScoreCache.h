@@ -0,0 +1,243 @@
+// CScoreCache
+// Persistent cache of per-image scores
+//
+// Each entry is keyed by the image's path, file size and modification time,
+// a fingerprint of the processing parameters and, if content hashing is
+// enabled, a 64 bit FNV-1a hash of the file. An entry is only returned while
+// its image and the parameters still match the key, so changed images are
+// rescored and unchanged ones are not. An image has one entry per parameter
+// fingerprint, so switching between modes or resolutions keeps the scores of
+// the others; entries of an older state of the file are dropped when it is
+// scored again.
+//
+// File layout (native byte order):
+//   "MBSC", version, number of entries,
+//   per entry: path length, path, size, modification time, hash, parameters, score
+//
+// Example:
+// CScoreCache cache("scores.cache");
+// cache.load();
+// float aScore;
+// if (!cache.lookup("img.ppm", aParameters, aScore)) {
+//   aScore = compute(); cache.store("img.ppm", aParameters, aScore);
+// }
+// cache.save();
+//-------------------------------------------------------------------------
+
+#ifndef CSCORECACHE_H
+#define CSCORECACHE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <string>
+#include <map>
+#include <utility>
+
+class CScoreCache {
+public:
+  // constructor, aHashContent compares file contents in addition to size and modification time
+  CScoreCache(const char* aFilename, bool aHashContent = false);
+
+  // Reads the cache file, returns false if there is no valid cache file
+  bool load();
+  // Writes the cache file, returns false on failure
+  bool save() const;
+
+  // Returns true and the score if aPath is cached for aParameters and unchanged since it was stored,
+  // aParameters is a fingerprint of everything besides the file that influences the score
+  bool lookup(const std::string& aPath, uint64_t aParameters, float& aScore);
+  // Stores the score of aPath together with the current state of the file
+  void store(const std::string& aPath, uint64_t aParameters, float aScore);
+  // Removes all entries
+  void clear();
+
+  // Gives access to the number of entries (of all parameters)
+  inline int size() const;
+
+  // 64 bit FNV-1a hash of aSize bytes, continuing from aHash
+  static uint64_t fnv1a(const unsigned char* aData, size_t aSize, uint64_t aHash = 14695981039346656037ULL);
+  // Combines aValue into a parameter fingerprint
+  static uint64_t fingerprint(uint64_t aFingerprint, double aValue);
+protected:
+  // Version of the file layout and of the scores in it, older cache files are discarded
+  enum { cVersion = 2 };
+  struct CKey {
+    int64_t mSize;
+    int64_t mModified;
+    uint64_t mHash;
+    bool operator==(const CKey& aKey) const {
+      return mSize == aKey.mSize && mModified == aKey.mModified && mHash == aKey.mHash;
+    }
+  };
+  struct CEntry {
+    CKey mKey;
+    float mScore;
+  };
+  // Entries are found by path and parameter fingerprint
+  typedef std::pair<std::string,uint64_t> CSlot;
+  // Determines the current key of aPath, returns false if the file does not exist
+  bool key(const std::string& aPath, CKey& aKey) const;
+  // Hashes the contents of the file aPath
+  static bool hashFile(const std::string& aPath, uint64_t& aHash);
+
+  std::string mFilename;
+  bool mHashContent;
+  std::map<CSlot,CEntry> mEntries;
+  // Keys determined by failed lookups, saves a second stat and hash in store
+  std::map<std::string,CKey> mPending;
+};
+
+// I M P L E M E N T A T I O N --------------------------------------------
+
+// constructor
+inline CScoreCache::CScoreCache(const char* aFilename, bool aHashContent)
+  : mFilename(aFilename), mHashContent(aHashContent) {
+}
+
+// load
+inline bool CScoreCache::load() {
+  mEntries.clear();
+  FILE* aStream = fopen(mFilename.c_str(),"rb");
+  if (aStream == 0) return false;
+  char aMagic[4];
+  uint32_t aVersion,aCount;
+  bool aOK = fread(aMagic,1,4,aStream) == 4 && aMagic[0] == 'M' && aMagic[1] == 'B' && aMagic[2] == 'S' && aMagic[3] == 'C'
+    && fread(&aVersion,sizeof(aVersion),1,aStream) == 1 && aVersion == (uint32_t)cVersion
+    && fread(&aCount,sizeof(aCount),1,aStream) == 1;
+  for (uint32_t i = 0; aOK && i < aCount; i++) {
+    uint32_t aLength;
+    uint64_t aParameters;
+    CEntry aEntry;
+    aOK = fread(&aLength,sizeof(aLength),1,aStream) == 1 && aLength < 65536;
+    if (!aOK) break;
+    std::string aPath(aLength,' ');
+    aOK = (aLength == 0 || fread(&aPath[0],1,aLength,aStream) == aLength)
+      && fread(&aEntry.mKey.mSize,sizeof(int64_t),1,aStream) == 1
+      && fread(&aEntry.mKey.mModified,sizeof(int64_t),1,aStream) == 1
+      && fread(&aEntry.mKey.mHash,sizeof(uint64_t),1,aStream) == 1
+      && fread(&aParameters,sizeof(uint64_t),1,aStream) == 1
+      && fread(&aEntry.mScore,sizeof(float),1,aStream) == 1;
+    if (aOK) mEntries[CSlot(aPath,aParameters)] = aEntry;
+  }
+  fclose(aStream);
+  // A damaged cache is discarded as a whole
+  if (!aOK) mEntries.clear();
+  return aOK;
+}
+
+// save
+inline bool CScoreCache::save() const {
+  uint32_t aVersion = cVersion;
+  // Write to a temporary file first so an interrupted run leaves the old cache intact
+  std::string aTemp = mFilename+".tmp";
+  FILE* aStream = fopen(aTemp.c_str(),"wb");
+  if (aStream == 0) return false;
+  uint32_t aCount = mEntries.size();
+  bool aOK = fwrite("MBSC",1,4,aStream) == 4
+    && fwrite(&aVersion,sizeof(aVersion),1,aStream) == 1
+    && fwrite(&aCount,sizeof(aCount),1,aStream) == 1;
+  for (std::map<CSlot,CEntry>::const_iterator i = mEntries.begin(); aOK && i != mEntries.end(); ++i) {
+    uint32_t aLength = i->first.first.size();
+    aOK = fwrite(&aLength,sizeof(aLength),1,aStream) == 1
+      && fwrite(i->first.first.data(),1,aLength,aStream) == aLength
+      && fwrite(&i->second.mKey.mSize,sizeof(int64_t),1,aStream) == 1
+      && fwrite(&i->second.mKey.mModified,sizeof(int64_t),1,aStream) == 1
+      && fwrite(&i->second.mKey.mHash,sizeof(uint64_t),1,aStream) == 1
+      && fwrite(&i->first.second,sizeof(uint64_t),1,aStream) == 1
+      && fwrite(&i->second.mScore,sizeof(float),1,aStream) == 1;
+  }
+  if (fclose(aStream) != 0) aOK = false;
+  if (aOK) aOK = rename(aTemp.c_str(),mFilename.c_str()) == 0;
+  if (!aOK) remove(aTemp.c_str());
+  return aOK;
+}
+
+// lookup
+inline bool CScoreCache::lookup(const std::string& aPath, uint64_t aParameters, float& aScore) {
+  CKey aKey;
+  if (!key(aPath,aKey)) return false;
+  std::map<CSlot,CEntry>::const_iterator i = mEntries.find(CSlot(aPath,aParameters));
+  if (i == mEntries.end() || !(i->second.mKey == aKey)) {
+    mPending[aPath] = aKey;
+    return false;
+  }
+  aScore = i->second.mScore;
+  return true;
+}
+
+// store
+inline void CScoreCache::store(const std::string& aPath, uint64_t aParameters, float aScore) {
+  CEntry aEntry;
+  std::map<std::string,CKey>::iterator i = mPending.find(aPath);
+  if (i != mPending.end()) {
+    aEntry.mKey = i->second;
+    mPending.erase(i);
+  }
+  else if (!key(aPath,aEntry.mKey)) return;
+  aEntry.mScore = aScore;
+  // Scores of an older state of the file are never returned again
+  std::map<CSlot,CEntry>::iterator j = mEntries.lower_bound(CSlot(aPath,0));
+  while (j != mEntries.end() && j->first.first == aPath) {
+    if (j->second.mKey == aEntry.mKey) ++j;
+    else mEntries.erase(j++);
+  }
+  mEntries[CSlot(aPath,aParameters)] = aEntry;
+}
+
+// clear
+inline void CScoreCache::clear() {
+  mEntries.clear();
+  mPending.clear();
+}
+
+// size
+inline int CScoreCache::size() const {
+  return mEntries.size();
+}
+
+// fnv1a
+inline uint64_t CScoreCache::fnv1a(const unsigned char* aData, size_t aSize, uint64_t aHash) {
+  for (size_t i = 0; i < aSize; i++) {
+    aHash ^= aData[i];
+    aHash *= 1099511628211ULL;
+  }
+  return aHash;
+}
+
+// fingerprint
+inline uint64_t CScoreCache::fingerprint(uint64_t aFingerprint, double aValue) {
+  return fnv1a((const unsigned char*)&aValue,sizeof(aValue),aFingerprint);
+}
+
+// P R O T E C T E D ------------------------------------------------------
+
+// key
+inline bool CScoreCache::key(const std::string& aPath, CKey& aKey) const {
+  struct stat aStat;
+  if (stat(aPath.c_str(),&aStat) != 0) return false;
+  aKey.mSize = aStat.st_size;
+  #ifdef __linux__
+  aKey.mModified = (int64_t)aStat.st_mtim.tv_sec*1000000000+aStat.st_mtim.tv_nsec;
+  #else
+  aKey.mModified = (int64_t)aStat.st_mtime*1000000000;
+  #endif
+  aKey.mHash = 0;
+  if (mHashContent && !hashFile(aPath,aKey.mHash)) return false;
+  return true;
+}
+
+// hashFile
+inline bool CScoreCache::hashFile(const std::string& aPath, uint64_t& aHash) {
+  FILE* aStream = fopen(aPath.c_str(),"rb");
+  if (aStream == 0) return false;
+  unsigned char aBuffer[65536];
+  aHash = 14695981039346656037ULL;
+  size_t aRead;
+  while ((aRead = fread(aBuffer,1,sizeof(aBuffer),aStream)) > 0)
+    aHash = fnv1a(aBuffer,aRead,aHash);
+  fclose(aStream);
+  return true;
+}
+
+#endif
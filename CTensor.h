@@ -12,6 +12,8 @@
 #include <sstream>
 #include "CMatrix.h"
 #include "NMath.h"
+#include "NMemory.h"
+#include "CFFTPlan.h"
 
 template <class T>
 class CTensor {
@@ -22,6 +24,8 @@ public:
   inline CTensor(const int aXSize, const int aYSize, const int aZSize);
   // copy constructor
   CTensor(const CTensor<T>& aCopyFrom);
+  // move constructor, aMoveFrom is left empty
+  CTensor(CTensor<T>&& aMoveFrom);
   // constructor with implicit filling
   CTensor(const int aXSize, const int aYSize, const int aZSize, const T aFillValue);
   // destructor
@@ -53,7 +57,8 @@ public:
   void drawLine(int dStartX, int dStartY, int dEndX, int dEndY, T aValue1 = 255, T aValue2 = 255, T aValue3 = 255);
 
   // Computes Fourier transform and inverse Fourier transform
-  // Image size has to be a power of 2, the two tensor channels comprise the real and imaginary part
+  // Any image size works, sizes with prime factors 2, 3 and 5 only are the fastest (see CFFT1D::goodSize()).
+  // The two tensor channels comprise the real and imaginary part.
   // The zero frequency is located in the center of the result
   void fft();
   void ifft();
@@ -94,6 +99,8 @@ public:
   inline CTensor<T>& operator=(const T aValue);
   // Copies the tensor aCopyFrom to this tensor (size of tensor might change)
   CTensor<T>& operator=(const CTensor<T>& aCopyFrom);
+  // Takes over the data of aMoveFrom, aMoveFrom is left empty
+  CTensor<T>& operator=(CTensor<T>&& aMoveFrom);
   // Adds a tensor of same size
   CTensor<T>& operator+=(const CTensor<T>& aMatrix);
   // Adds a constant to the tensor
@@ -119,6 +126,8 @@ public:
   void getMatrix(CMatrix<T>& aMatrix, const int az) const;
   // Copies the matrix components of aMatrix into the az layer of the tensor
   void putMatrix(CMatrix<T>& aMatrix, const int az);
+  // Returns a view of the az layer of the tensor, works on the tensor's data without a copy
+  inline CMatrixView<T> layer(const int az) const;
   // Gives access to the internal data representation (use sparingly)
   inline T* data() const;
 
@@ -180,7 +189,7 @@ inline CTensor<T>::CTensor() {
 template <class T>
 inline CTensor<T>::CTensor(const int aXSize, const int aYSize, const int aZSize)
   : mXSize(aXSize), mYSize(aYSize), mZSize(aZSize) {
-  mData = new T[aXSize*aYSize*aZSize];
+  mData = NMemory::allocate<T>(aXSize*aYSize*aZSize);
 }
 
 // copy constructor
@@ -188,30 +197,38 @@ template <class T>
 CTensor<T>::CTensor(const CTensor<T>& aCopyFrom)
   : mXSize(aCopyFrom.mXSize), mYSize(aCopyFrom.mYSize), mZSize(aCopyFrom.mZSize) {
   int wholeSize = mXSize*mYSize*mZSize;
-  mData = new T[wholeSize];
+  mData = NMemory::allocate<T>(wholeSize);
   for (register int i = 0; i < wholeSize; i++)
     mData[i] = aCopyFrom.mData[i];
 }
 
+// move constructor
+template <class T>
+CTensor<T>::CTensor(CTensor<T>&& aMoveFrom)
+  : mXSize(aMoveFrom.mXSize), mYSize(aMoveFrom.mYSize), mZSize(aMoveFrom.mZSize), mData(aMoveFrom.mData) {
+  aMoveFrom.mXSize = aMoveFrom.mYSize = aMoveFrom.mZSize = 0;
+  aMoveFrom.mData = 0;
+}
+
 // constructor with implicit filling
 template <class T>
 CTensor<T>::CTensor(const int aXSize, const int aYSize, const int aZSize, const T aFillValue)
   : mXSize(aXSize), mYSize(aYSize), mZSize(aZSize) {
-  mData = new T[aXSize*aYSize*aZSize];
+  mData = NMemory::allocate<T>(aXSize*aYSize*aZSize);
   fill(aFillValue);
 }
 
 // destructor
 template <class T>
 CTensor<T>::~CTensor() {
-  delete [] mData;
+  NMemory::release(mData);
 }
 
 // setSize
 template <class T>
 void CTensor<T>::setSize(int aXSize, int aYSize, int aZSize) {
-  if (mData != 0) delete[] mData;
-  mData = new T[aXSize*aYSize*aZSize];
+  if (mData != 0) NMemory::release(mData);
+  mData = NMemory::allocate<T>(aXSize*aYSize*aZSize);
   mXSize = aXSize;
   mYSize = aYSize;
   mZSize = aZSize;
@@ -220,7 +237,7 @@ void CTensor<T>::setSize(int aXSize, int aYSize, int aZSize) {
 //downsample
 template <class T>
 void CTensor<T>::downsample(int aNewXSize, int aNewYSize) {
-  T* mData2 = new T[aNewXSize*aNewYSize*mZSize];
+  T* mData2 = NMemory::allocate<T>(aNewXSize*aNewYSize*mZSize);
   int aSize = aNewXSize*aNewYSize;
   for (int z = 0; z < mZSize; z++) {
     CMatrix<T> aTemp(mXSize,mYSize);
@@ -229,7 +246,7 @@ void CTensor<T>::downsample(int aNewXSize, int aNewYSize) {
     for (int i = 0; i < aSize; i++)
       mData2[i+z*aSize] = aTemp.data()[i];
   }
-  delete[] mData;
+  NMemory::release(mData);
   mData = mData2;
   mXSize = aNewXSize;
   mYSize = aNewYSize;
@@ -238,7 +255,7 @@ void CTensor<T>::downsample(int aNewXSize, int aNewYSize) {
 // upsample
 template <class T>
 void CTensor<T>::upsample(int aNewXSize, int aNewYSize) {
-  T* mData2 = new T[aNewXSize*aNewYSize*mZSize];
+  T* mData2 = NMemory::allocate<T>(aNewXSize*aNewYSize*mZSize);
   int aSize = aNewXSize*aNewYSize;
   for (int z = 0; z < mZSize; z++) {
     CMatrix<T> aTemp(mXSize,mYSize);
@@ -247,7 +264,7 @@ void CTensor<T>::upsample(int aNewXSize, int aNewYSize) {
     for (int i = 0; i < aSize; i++)
       mData2[i+z*aSize] = aTemp.data()[i];
   }
-  delete[] mData;
+  NMemory::release(mData);
   mData = mData2;
   mXSize = aNewXSize;
   mYSize = aNewYSize;
@@ -256,7 +273,7 @@ void CTensor<T>::upsample(int aNewXSize, int aNewYSize) {
 // upsampleBilinear
 template <class T>
 void CTensor<T>::upsampleBilinear(int aNewXSize, int aNewYSize) {
-  T* mData2 = new T[aNewXSize*aNewYSize*mZSize];
+  T* mData2 = NMemory::allocate<T>(aNewXSize*aNewYSize*mZSize);
   int aSize = aNewXSize*aNewYSize;
   for (int z = 0; z < mZSize; z++) {
     CMatrix<T> aTemp(mXSize,mYSize);
@@ -265,7 +282,7 @@ void CTensor<T>::upsampleBilinear(int aNewXSize, int aNewYSize) {
     for (int i = 0; i < aSize; i++)
       mData2[i+z*aSize] = aTemp.data()[i];
   }
-  delete[] mData;
+  NMemory::release(mData);
   mData = mData2;
   mXSize = aNewXSize;
   mYSize = aNewYSize;
@@ -285,8 +302,8 @@ void CTensor<T>::cut(CTensor<T>& aResult, int x1, int y1, int z1, int x2, int y2
   aResult.mXSize = x2-x1+1;
   aResult.mYSize = y2-y1+1;
   aResult.mZSize = z2-z1+1;
-  delete[] aResult.mData;
-  aResult.mData = new T[aResult.mXSize*aResult.mYSize*aResult.mZSize];
+  NMemory::release(aResult.mData);
+  aResult.mData = NMemory::allocate<T>(aResult.mXSize*aResult.mYSize*aResult.mZSize);
   for (int z = z1; z <= z2; z++)
     for (int y = y1; y <= y2; y++)
       for (int x = x1; x <= x2; x++)
@@ -486,7 +503,7 @@ void CTensor<T>::applySimilarityTransform(CTensor<T>& aWarped, CMatrix<bool>& aO
       int x1 = (int)ax; int y1 = (int)ay;
       float alphaX = ax-x1; float alphaY = ay-y1;
       float betaX = 1.0-alphaX; float betaY = 1.0-alphaY;
-      if (x1 < 0 || y1 < 0 || x1+1 >= mXSize || y1+1 >= mYSize) aOutside.data()[i] = true;
+      if (x1 < 0 || y1 < 0 || x1+1 >= mXSize || y1+1 >= mYSize) aOutside(x,y) = true;
       else {
         int j = y1*mXSize+x1;
         for (int k = 0; k < mZSize; k++) {
@@ -509,15 +526,15 @@ void CTensor<T>::applyHomography(CTensor<T>& aWarped, CMatrix<bool>& aOutside, c
   for (int y = 0; y < aWarped.ySize(); y++)
     for (int x = 0; x < aWarped.xSize(); x++,i++) {
       float xf = x; float yf = y;
-      float ax = H.data()[0]*xf+H.data()[1]*yf+H.data()[2];
-      float ay = H.data()[3]*xf+H.data()[4]*yf+H.data()[5];
-      float az = H.data()[6]*xf+H.data()[7]*yf+H.data()[8];
+      float ax = H(0,0)*xf+H(1,0)*yf+H(2,0);
+      float ay = H(0,1)*xf+H(1,1)*yf+H(2,1);
+      float az = H(0,2)*xf+H(1,2)*yf+H(2,2);
       float invaz = 1.0/az;
       ax *= invaz; ay *= invaz;
       int x1 = (int)ax; int y1 = (int)ay;
       float alphaX = ax-x1; float alphaY = ay-y1;
       float betaX = 1.0-alphaX; float betaY = 1.0-alphaY;
-      if (x1 < 0 || y1 < 0 || x1+1 >= mXSize || y1+1 >= mYSize) aOutside.data()[i] = true;
+      if (x1 < 0 || y1 < 0 || x1+1 >= mXSize || y1+1 >= mYSize) aOutside(x,y) = true;
       else {
         int j = y1*mXSize+x1;
         for (int k = 0; k < mZSize; k++) {
@@ -530,417 +547,59 @@ void CTensor<T>::applyHomography(CTensor<T>& aWarped, CMatrix<bool>& aOutside, c
     }
 }
 
-// -----------------------------------------------------------------------------
-// FFT (from Takuya OOURA FFT package)
-// -----------------------------------------------------------------------------
-
-void bitrv2(int n, int *ip, double *a) {
-  int j, j1, k, k1, l, m, m2;
-  double xr, xi;
-  ip[0] = 0;
-  l = n;
-  m = 1;
-  while ((m << 2) < l) {
-    l >>= 1;
-    for (j = 0; j <= m - 1; j++)
-      ip[m + j] = ip[j] + l;
-    m <<= 1;
-  }
-  if ((m << 2) > l) {
-    for (k = 1; k <= m - 1; k++)
-      for (j = 0; j <= k - 1; j++) {
-        j1 = (j << 1) + ip[k];
-        k1 = (k << 1) + ip[j];
-        xr = a[j1];
-        xi = a[j1 + 1];
-        a[j1] = a[k1];
-        a[j1 + 1] = a[k1 + 1];
-        a[k1] = xr;
-        a[k1 + 1] = xi;
-      }
-  }
-  else {
-    m2 = m << 1;
-    for (k = 1; k <= m - 1; k++)
-      for (j = 0; j <= k - 1; j++) {
-        j1 = (j << 1) + ip[k];
-        k1 = (k << 1) + ip[j];
-        xr = a[j1];
-        xi = a[j1 + 1];
-        a[j1] = a[k1];
-        a[j1 + 1] = a[k1 + 1];
-        a[k1] = xr;
-        a[k1 + 1] = xi;
-        j1 += m2;
-        k1 += m2;
-        xr = a[j1];
-        xi = a[j1 + 1];
-        a[j1] = a[k1];
-        a[j1 + 1] = a[k1 + 1];
-        a[k1] = xr;
-        a[k1 + 1] = xi;
-      }
-  }
-}
-
-void makewt(int nw, int *ip, double *w) {
-  int nwh, j;
-  double delta, x, y;
-  ip[0] = nw;
-  ip[1] = 1;
-  if (nw > 2) {
-    nwh = nw >> 1;
-    delta = atan(1.0) / nwh;
-    w[0] = 1;
-    w[1] = 0;
-    w[nwh] = cos(delta * nwh);
-    w[nwh + 1] = w[nwh];
-    for (j = 2; j <= nwh - 2; j += 2) {
-      x = cos(delta * j);
-      y = sin(delta * j);
-      w[j] = x;
-      w[j + 1] = y;
-      w[nw - j] = y;
-      w[nw - j + 1] = x;
-    }
-    bitrv2(nw, ip + 2, w);
-  }
-}
-
-void cftbsub(int n, double *a, double *w) {
-  int j, j1, j2, j3, k, k1, ks, l, m;
-  double wk1r, wk1i, wk2r, wk2i, wk3r, wk3i;
-  double x0r, x0i, x1r, x1i, x2r, x2i, x3r, x3i;
-  l = 2;
-  while ((l << 1) < n) {
-    m = l << 2;
-    for (j = 0; j <= l - 2; j += 2) {
-      j1 = j + l;
-      j2 = j1 + l;
-      j3 = j2 + l;
-      x0r = a[j] + a[j1];
-      x0i = a[j + 1] + a[j1 + 1];
-      x1r = a[j] - a[j1];
-      x1i = a[j + 1] - a[j1 + 1];
-      x2r = a[j2] + a[j3];
-      x2i = a[j2 + 1] + a[j3 + 1];
-      x3r = a[j2] - a[j3];
-      x3i = a[j2 + 1] - a[j3 + 1];
-      a[j] = x0r + x2r;
-      a[j + 1] = x0i + x2i;
-      a[j2] = x0r - x2r;
-      a[j2 + 1] = x0i - x2i;
-      a[j1] = x1r - x3i;
-      a[j1 + 1] = x1i + x3r;
-      a[j3] = x1r + x3i;
-      a[j3 + 1] = x1i - x3r;
+// fft
+// The plan of the calling thread is reused, so transforming a sequence does not allocate per frame
+template <class T>
+void CTensor<T>::fft() {
+  int n1 = mXSize;
+  int n2 = mYSize;
+  CFFTPlan& aPlan = CFFTPlan::cached(n2,n1);
+  // Apply FFT to data
+  for (int y = 0; y < mYSize; y++)
+    for (int x = 0; x < mXSize; x++) {
+      aPlan.row(x)[2*y] = operator()(x,y,0);
+      aPlan.row(x)[2*y+1] = operator()(x,y,1);
     }
-    if (m < n) {
-      wk1r = w[2];
-      for (j = m; j <= l + m - 2; j += 2) {
-        j1 = j + l;
-        j2 = j1 + l;
-        j3 = j2 + l;
-        x0r = a[j] + a[j1];
-        x0i = a[j + 1] + a[j1 + 1];
-        x1r = a[j] - a[j1];
-        x1i = a[j + 1] - a[j1 + 1];
-        x2r = a[j2] + a[j3];
-        x2i = a[j2 + 1] + a[j3 + 1];
-        x3r = a[j2] - a[j3];
-        x3i = a[j2 + 1] - a[j3 + 1];
-        a[j] = x0r + x2r;
-        a[j + 1] = x0i + x2i;
-        a[j2] = x2i - x0i;
-        a[j2 + 1] = x0r - x2r;
-        x0r = x1r - x3i;
-        x0i = x1i + x3r;
-        a[j1] = wk1r * (x0r - x0i);
-        a[j1 + 1] = wk1r * (x0r + x0i);
-        x0r = x3i + x1r;
-        x0i = x3r - x1i;
-        a[j3] = wk1r * (x0i - x0r);
-        a[j3 + 1] = wk1r * (x0i + x0r);
-      }
-      k1 = 1;
-      ks = -1;
-      for (k = (m << 1); k <= n - m; k += m) {
-        k1++;
-        ks = -ks;
-        wk1r = w[k1 << 1];
-        wk1i = w[(k1 << 1) + 1];
-        wk2r = ks * w[k1];
-        wk2i = w[k1 + ks];
-        wk3r = wk1r - 2 * wk2i * wk1i;
-        wk3i = 2 * wk2i * wk1r - wk1i;
-        for (j = k; j <= l + k - 2; j += 2) {
-          j1 = j + l;
-          j2 = j1 + l;
-          j3 = j2 + l;
-          x0r = a[j] + a[j1];
-          x0i = a[j + 1] + a[j1 + 1];
-          x1r = a[j] - a[j1];
-          x1i = a[j + 1] - a[j1 + 1];
-          x2r = a[j2] + a[j3];
-          x2i = a[j2 + 1] + a[j3 + 1];
-          x3r = a[j2] - a[j3];
-          x3i = a[j2 + 1] - a[j3 + 1];
-          a[j] = x0r + x2r;
-          a[j + 1] = x0i + x2i;
-          x0r -= x2r;
-          x0i -= x2i;
-          a[j2] = wk2r * x0r - wk2i * x0i;
-          a[j2 + 1] = wk2r * x0i + wk2i * x0r;
-          x0r = x1r - x3i;
-          x0i = x1i + x3r;
-          a[j1] = wk1r * x0r - wk1i * x0i;
-          a[j1 + 1] = wk1r * x0i + wk1i * x0r;
-          x0r = x1r + x3i;
-          x0i = x1i - x3r;
-          a[j3] = wk3r * x0r - wk3i * x0i;
-          a[j3 + 1] = wk3r * x0i + wk3i * x0r;
-        }
-      }
-    }
-    l = m;
-  }
-  if (l < n) {
-    for (j = 0; j <= l - 2; j += 2) {
-      j1 = j + l;
-      x0r = a[j] - a[j1];
-      x0i = a[j + 1] - a[j1 + 1];
-      a[j] += a[j1];
-      a[j + 1] += a[j1 + 1];
-      a[j1] = x0r;
-      a[j1 + 1] = x0i;
+  aPlan.transform(1);
+  // Frequency x goes to (n1/2-1-x) mod n1, and likewise for y
+  int n12 = n1/2;
+  int n22 = n2/2;
+  for (int x = 0; x < n1; x++) {
+    const double* a = aPlan.row(x);
+    int x2 = (x < n12) ? n12-1-x : n1+n12-1-x;
+    for (int y = 0; y < n2; y++) {
+      int y2 = (y < n22) ? n22-1-y : n2+n22-1-y;
+      operator()(x2,y2,0) = a[2*y];
+      operator()(x2,y2,1) = a[2*y+1];
     }
   }
 }
 
-void cftfsub(int n, double *a, double *w) {
-  int j, j1, j2, j3, k, k1, ks, l, m;
-  double wk1r, wk1i, wk2r, wk2i, wk3r, wk3i;
-  double x0r, x0i, x1r, x1i, x2r, x2i, x3r, x3i;
-
-  l = 2;
-  while ((l << 1) < n) {
-    m = l << 2;
-    for (j = 0; j <= l - 2; j += 2) {
-      j1 = j + l;
-      j2 = j1 + l;
-      j3 = j2 + l;
-      x0r = a[j] + a[j1];
-      x0i = a[j + 1] + a[j1 + 1];
-      x1r = a[j] - a[j1];
-      x1i = a[j + 1] - a[j1 + 1];
-      x2r = a[j2] + a[j3];
-      x2i = a[j2 + 1] + a[j3 + 1];
-      x3r = a[j2] - a[j3];
-      x3i = a[j2 + 1] - a[j3 + 1];
-      a[j] = x0r + x2r;
-      a[j + 1] = x0i + x2i;
-      a[j2] = x0r - x2r;
-      a[j2 + 1] = x0i - x2i;
-      a[j1] = x1r + x3i;
-      a[j1 + 1] = x1i - x3r;
-      a[j3] = x1r - x3i;
-      a[j3 + 1] = x1i + x3r;
-    }
-    if (m < n) {
-      wk1r = w[2];
-      for (j = m; j <= l + m - 2; j += 2) {
-        j1 = j + l;
-        j2 = j1 + l;
-        j3 = j2 + l;
-        x0r = a[j] + a[j1];
-        x0i = a[j + 1] + a[j1 + 1];
-        x1r = a[j] - a[j1];
-        x1i = a[j + 1] - a[j1 + 1];
-        x2r = a[j2] + a[j3];
-        x2i = a[j2 + 1] + a[j3 + 1];
-        x3r = a[j2] - a[j3];
-        x3i = a[j2 + 1] - a[j3 + 1];
-        a[j] = x0r + x2r;
-        a[j + 1] = x0i + x2i;
-        a[j2] = x0i - x2i;
-        a[j2 + 1] = x2r - x0r;
-        x0r = x1r + x3i;
-        x0i = x1i - x3r;
-        a[j1] = wk1r * (x0i + x0r);
-        a[j1 + 1] = wk1r * (x0i - x0r);
-        x0r = x3i - x1r;
-        x0i = x3r + x1i;
-        a[j3] = wk1r * (x0r + x0i);
-        a[j3 + 1] = wk1r * (x0r - x0i);
-      }
-      k1 = 1;
-      ks = -1;
-      for (k = (m << 1); k <= n - m; k += m) {
-        k1++;
-        ks = -ks;
-        wk1r = w[k1 << 1];
-        wk1i = w[(k1 << 1) + 1];
-        wk2r = ks * w[k1];
-        wk2i = w[k1 + ks];
-        wk3r = wk1r - 2 * wk2i * wk1i;
-        wk3i = 2 * wk2i * wk1r - wk1i;
-        for (j = k; j <= l + k - 2; j += 2) {
-          j1 = j + l;
-          j2 = j1 + l;
-          j3 = j2 + l;
-          x0r = a[j] + a[j1];
-          x0i = a[j + 1] + a[j1 + 1];
-          x1r = a[j] - a[j1];
-          x1i = a[j + 1] - a[j1 + 1];
-          x2r = a[j2] + a[j3];
-          x2i = a[j2 + 1] + a[j3 + 1];
-          x3r = a[j2] - a[j3];
-          x3i = a[j2 + 1] - a[j3 + 1];
-          a[j] = x0r + x2r;
-          a[j + 1] = x0i + x2i;
-          x0r -= x2r;
-          x0i -= x2i;
-          a[j2] = wk2r * x0r + wk2i * x0i;
-          a[j2 + 1] = wk2r * x0i - wk2i * x0r;
-          x0r = x1r + x3i;
-          x0i = x1i - x3r;
-          a[j1] = wk1r * x0r + wk1i * x0i;
-          a[j1 + 1] = wk1r * x0i - wk1i * x0r;
-          x0r = x1r - x3i;
-          x0i = x1i + x3r;
-          a[j3] = wk3r * x0r + wk3i * x0i;
-          a[j3 + 1] = wk3r * x0i - wk3i * x0r;
-        }
-      }
-    }
-    l = m;
-  }
-  if (l < n) {
-    for (j = 0; j <= l - 2; j += 2) {
-      j1 = j + l;
-      x0r = a[j] - a[j1];
-      x0i = a[j + 1] - a[j1 + 1];
-      a[j] += a[j1];
-      a[j + 1] += a[j1 + 1];
-      a[j1] = x0r;
-      a[j1 + 1] = x0i;
-    }
-  }
-}
-
-void cdft(int n, int isgn, double *a, int *ip, double *w) {
-  void cftbsub(int n, double *a, double *w);
-  void cftfsub(int n, double *a, double *w);
-
-  if (n > (ip[0] << 2)) makewt(n >> 2, ip, w);
-  if (n > 4) bitrv2(n, ip + 2, a);
-  if (isgn < 0) cftfsub(n, a, w);
-  else cftbsub(n, a, w);
-}
-
-void cdft2d(int n1, int n2, int isgn, double **a, double *t, int *ip, double *w) {
-  int n, i, j, i2;
-  n = n1 << 1;
-  if (n < n2)  n = n2;
-  if (n > (ip[0] << 2)) makewt(n >> 2, ip, w);
-  for (i = 0; i <= n1 - 1; i++)
-    cdft(n2, isgn, a[i], ip, w);
-  for (j = 0; j <= n2 - 2; j += 2) {
-    for (i = 0; i <= n1 - 1; i++) {
-      i2 = i << 1;
-      t[i2] = a[i][j];
-      t[i2 + 1] = a[i][j + 1];
-    }
-    cdft(n1 << 1, isgn, t, ip, w);
-    for (i = 0; i <= n1 - 1; i++) {
-      i2 = i << 1;
-      a[i][j] = t[i2];
-      a[i][j + 1] = t[i2 + 1];
-    }
-  }
-}
-
-template <class T>
-void CTensor<T>::fft() {
-  int n1 = mXSize;
-  int n2 = mYSize;
-  // Reserve memory
-  double** a = new double*[n1];
-  for (int i = 0; i < n1; i++)
-    a[i] = new double[2*n2];
-  double* t = new double[2*n1];
-  int* ip = new int[2+NMath::max(n1,n2)];
-  ip[0] = 0;
-  double* w = new double[NMath::max(n1/2,n2/2)];
-  // Apply FFT to data
-  for (int y = 0; y < mYSize; y++)
-    for (int x = 0; x < mXSize; x++) {
-      a[x][2*y] = operator()(x,y,0);
-      a[x][2*y+1] = operator()(x,y,1);
-    }
-  cdft2d(n1,2*n2,1,a,t,ip,w);
-  int n12 = n1/2;
-  int n22 = n2/2;
-  for (int y = 0; y < n22; y++)
-    for (int x = 0; x < n12; x++) {
-      operator()(n12-1-x,n22-1-y,0) = a[x][2*y];
-      operator()(n12-1-x,n22-1-y,1) = a[x][2*y+1];
-      operator()(n1-1-x,n22-1-y,0) = a[x+n12][2*y];
-      operator()(n1-1-x,n22-1-y,1) = a[x+n12][2*y+1];
-      operator()(n12-1-x,n2-1-y,0) = a[x][2*(y+n22)];
-      operator()(n12-1-x,n2-1-y,1) = a[x][2*(y+n22)+1];
-      operator()(n1-1-x,n2-1-y,0) = a[x+n12][2*(y+n22)];
-      operator()(n1-1-x,n2-1-y,1) = a[x+n12][2*(y+n22)+1];
-    }
-  // Release memory
-  delete[] w;
-  delete[] ip;
-  delete[] t;
-  for (int i = 0; i < n1; i++)
-    delete[] a[i];
-  delete[] a;
-}
-
+// ifft
 template <class T>
 void CTensor<T>::ifft() {
   int n1 = mXSize;
   int n2 = mYSize;
-  // Reserve memory
-  double** a = new double*[n1];
-  for (int i = 0; i < n1; i++)
-    a[i] = new double[2*n2];
-  double* t = new double[2*n1];
-  int* ip = new int[2+NMath::max(n1,n2)];
-  ip[0] = 0;
-  double* w = new double[NMath::max(n1/2,n2/2)];
-  // Apply inverse FFT to data
+  CFFTPlan& aPlan = CFFTPlan::cached(n2,n1);
+  // Apply inverse FFT to data, undoing the reordering of fft()
   int n12 = n1/2;
   int n22 = n2/2;
-  for (int y = 0; y < n22; y++)
-    for (int x = 0; x < n12; x++) {
-      a[x][2*y] = operator()(n12-1-x,n22-1-y,0);
-      a[x][2*y+1] = operator()(n12-1-x,n22-1-y,1);
-      a[x+n12][2*y] = operator()(n1-1-x,n22-1-y,0);
-      a[x+n12][2*y+1] = operator()(n1-1-x,n22-1-y,1);
-      a[x][2*(y+n22)] = operator()(n12-1-x,n2-1-y,0);
-      a[x][2*(y+n22)+1] = operator()(n12-1-x,n2-1-y,1);
-      a[x+n12][2*(y+n22)] = operator()(n1-1-x,n2-1-y,0);
-      a[x+n12][2*(y+n22)+1] = operator()(n1-1-x,n2-1-y,1);
+  for (int x = 0; x < n1; x++) {
+    double* a = aPlan.row(x);
+    int x2 = (x < n12) ? n12-1-x : n1+n12-1-x;
+    for (int y = 0; y < n2; y++) {
+      int y2 = (y < n22) ? n22-1-y : n2+n22-1-y;
+      a[2*y] = operator()(x2,y2,0);
+      a[2*y+1] = operator()(x2,y2,1);
     }
-  cdft2d(n1,2*n2,-1,a,t,ip,w);
+  }
+  aPlan.transform(-1);
   double invSize = 1.0/(n1*n2);
   for (int y = 0; y < mYSize; y++)
     for (int x = 0; x < mXSize; x++) {
-      operator()(x,y,0) = invSize*a[x][2*y];
-      operator()(x,y,1) = invSize*a[x][2*y+1];
+      operator()(x,y,0) = invSize*aPlan.row(x)[2*y];
+      operator()(x,y,1) = invSize*aPlan.row(x)[2*y+1];
     }
-  // Release memory
-  delete[] w;
-  //delete[] ip;
-  delete[] t;
-  for (int i = 0; i < n1; i++)
-    delete[] a[i];
-  delete[] a;
 }
 
 // -----------------------------------------------------------------------------
@@ -994,11 +653,11 @@ void CTensor<T>::readFromMathematicaFile(const char* aFilename) {
     aPos++;
   }
   // Adapt size of tensor
-  if (mData != 0) delete[] mData;
+  if (mData != 0) NMemory::release(mData);
   mXSize = aCommaCount+1;
   mYSize = (aBraceCount-1-aDoubleBraceCount) / aDoubleBraceCount;
   mZSize = aDoubleBraceCount;
-  mData = new T[mXSize*mYSize*mZSize];
+  mData = NMemory::allocate<T>(mXSize*mYSize*mZSize);
   // Analyse file ---------------
   aPos = 0;
   if (aData[aPos] != '{') throw EInvalidFileFormat("Mathematica");
@@ -1092,39 +751,19 @@ void CTensor<T>::writeToIMFile(const char *aFilename) {
 // readFromPGM
 template <class T>
 void CTensor<T>::readFromPGM(const char* aFilename) {
-  FILE *aStream;
-  aStream = fopen(aFilename,"rb");
-  int dummy;
-  // Find beginning of file (P5)
-  while (getc(aStream) != 'P');
-  if (getc(aStream) != '5') throw EInvalidFileFormat("PGM");
-  while (getc(aStream) != '\n');
-  // Remove comments and empty lines
-  dummy = getc(aStream);
-  while (dummy == '#') {
-    while (getc(aStream) != '\n');
-    dummy = getc(aStream);
-  }
-  while (dummy == '\n')
-    dummy = getc(aStream); 
-  // Read image size
-  mXSize = dummy-48;
-  while ((dummy = getc(aStream)) >= 48 && dummy < 58)
-    mXSize = 10*mXSize+dummy-48;
-  while ((dummy = getc(aStream)) < 48 || dummy >= 58);
-  mYSize = dummy-48;
-  while ((dummy = getc(aStream)) >= 48 && dummy < 58)
-    mYSize = 10*mYSize+dummy-48;
-  mZSize = 1;
-  if (dummy != '\n') while (getc(aStream) != '\n');
-  while (getc(aStream) != '\n');
+  int aXSize,aYSize;
+  const unsigned char* aPixels;
+  NPNM::EStatus aStatus = NPNM::read(aFilename,'5',aXSize,aYSize,aPixels);
+  if (aStatus == NPNM::cNotFound) throw EFileNotFound(aFilename);
+  if (aStatus != NPNM::cOK) throw EInvalidFileFormat("PGM");
   // Adjust size of data structure
-  delete[] mData;
-  mData = new T[mXSize*mYSize];
+  if (mXSize*mYSize*mZSize != aXSize*aYSize) {
+    NMemory::release(mData);
+    mData = NMemory::allocate<T>(aXSize*aYSize);
+  }
+  mXSize = aXSize; mYSize = aYSize; mZSize = 1;
   // Read image data
-  for (int i = 0; i < mXSize*mYSize; i++)
-    mData[i] = getc(aStream);
-  fclose(aStream);
+  NPNM::widen(aPixels,mData,mXSize*mYSize);
 }
 
 // writeToPGM
@@ -1153,56 +792,31 @@ void CTensor<T>::makeColorTensor() {
   if (mZSize != 1) return;
   int aSize = mXSize*mYSize;
   int a2Size = 2*aSize;
-  T* aNewData = new T[aSize*3];
+  T* aNewData = NMemory::allocate<T>(aSize*3);
   for (int i = 0; i < aSize; i++)
     aNewData[i] = aNewData[i+aSize] = aNewData[i+a2Size] = mData[i];
   mZSize = 3;
-  delete[] mData;
+  NMemory::release(mData);
   mData = aNewData;
 }
 
 // readFromPPM
 template <class T>
 void CTensor<T>::readFromPPM(const char* aFilename) {
-  FILE *aStream;
-  aStream = fopen(aFilename,"rb");
-  if (aStream == 0) std::cerr << "File not found: " << aFilename << std::endl;
-  int dummy;
-  // Find beginning of file (P6)
-  while (getc(aStream) != 'P');
-  if (getc(aStream) != '6') throw EInvalidFileFormat("PPM");
-  while (getc(aStream) != '\n');
-  // Remove comments and empty lines
-  dummy = getc(aStream);
-  while (dummy == '#') {
-    while (getc(aStream) != '\n');
-    dummy = getc(aStream);
+  int aXSize,aYSize;
+  const unsigned char* aPixels;
+  NPNM::EStatus aStatus = NPNM::read(aFilename,'6',aXSize,aYSize,aPixels);
+  if (aStatus == NPNM::cNotFound) throw EFileNotFound(aFilename);
+  if (aStatus != NPNM::cOK) throw EInvalidFileFormat("PPM");
+  // Adjust size of data structure, a buffer of the right size is reused
+  if (mXSize*mYSize*mZSize != 3*aXSize*aYSize) {
+    NMemory::release(mData);
+    mData = NMemory::allocate<T>(aXSize*aYSize*3);
   }
-  while (dummy == '\n')
-    dummy = getc(aStream); 
-  // Read image size
-  mXSize = dummy-48;
-  while ((dummy = getc(aStream)) >= 48 && dummy < 58)
-    mXSize = 10*mXSize+dummy-48;
-  while ((dummy = getc(aStream)) < 48 || dummy >= 58);
-  mYSize = dummy-48;
-  while ((dummy = getc(aStream)) >= 48 && dummy < 58)
-    mYSize = 10*mYSize+dummy-48;
-  mZSize = 3;
-  if (dummy != '\n') while (getc(aStream) != '\n');
-  while (getc(aStream) != '\n');
-  // Adjust size of data structure
-  delete[] mData;
-  mData = new T[mXSize*mYSize*3];
-  // Read image data
+  mXSize = aXSize; mYSize = aYSize; mZSize = 3;
+  // Read image data, interleaved RGB to three layers
   int aSize = mXSize*mYSize;
-  int aSizeTwice = aSize+aSize;
-  for (int i = 0; i < aSize; i++) {
-    mData[i] = getc(aStream);
-    mData[i+aSize] = getc(aStream);
-    mData[i+aSizeTwice] = getc(aStream);
-  }
-  fclose(aStream);
+  NPNM::deinterleave(aPixels,mData,mData+aSize,mData+2*aSize,aSize);
 }
 
 // writeToPPM
@@ -1239,8 +853,8 @@ void CTensor<T>::readFromPDM(const char* aFilename) {
   aStream >> mZSize;
   aStream >> s;
   // Adjust size of data structure
-  delete[] mData;
-  mData = new T[mXSize*mYSize*mZSize];
+  NMemory::release(mData);
+  mData = NMemory::allocate<T>(mXSize*mYSize*mZSize);
   // Read data
   for (int i = 0; i < mXSize*mYSize*mZSize; i++)
     aStream >> mData[i];
@@ -1303,18 +917,32 @@ inline CTensor<T>& CTensor<T>::operator=(const T aValue) {
 template <class T>
 CTensor<T>& CTensor<T>::operator=(const CTensor<T>& aCopyFrom) {
   if (this != &aCopyFrom) {
-    delete[] mData;
+    NMemory::release(mData);
     mXSize = aCopyFrom.mXSize;
     mYSize = aCopyFrom.mYSize;
     mZSize = aCopyFrom.mZSize;
     int wholeSize = mXSize*mYSize*mZSize;
-    mData = new T[wholeSize];
+    mData = NMemory::allocate<T>(wholeSize);
     for (register int i = 0; i < wholeSize; i++)
       mData[i] = aCopyFrom.mData[i];
   }
   return *this;
 }
 
+template <class T>
+CTensor<T>& CTensor<T>::operator=(CTensor<T>&& aMoveFrom) {
+  if (this != &aMoveFrom) {
+    NMemory::release(mData);
+    mXSize = aMoveFrom.mXSize;
+    mYSize = aMoveFrom.mYSize;
+    mZSize = aMoveFrom.mZSize;
+    mData = aMoveFrom.mData;
+    aMoveFrom.mXSize = aMoveFrom.mYSize = aMoveFrom.mZSize = 0;
+    aMoveFrom.mData = 0;
+  }
+  return *this;
+}
+
 // operator +=
 template <class T>
 CTensor<T>& CTensor<T>::operator+=(const CTensor<T>& aTensor) {
@@ -1413,10 +1041,7 @@ inline int CTensor<T>::size() const {
 template <class T>
 CMatrix<T> CTensor<T>::getMatrix(const int az) const {
   CMatrix<T> aTemp(mXSize,mYSize);
-  int aMatrixSize = mXSize*mYSize;
-  int aOffset = az*aMatrixSize;
-  for (int i = 0; i < aMatrixSize; i++)
-    aTemp.data()[i] = mData[i+aOffset];
+  getMatrix(aTemp,az);
   return aTemp;
 }
 
@@ -1425,10 +1050,7 @@ template <class T>
 void CTensor<T>::getMatrix(CMatrix<T>& aMatrix, const int az) const {
   if (aMatrix.xSize() != mXSize || aMatrix.ySize() != mYSize)
     throw ETensorIncompatibleSize(aMatrix.xSize(),aMatrix.ySize(),mXSize,mYSize);
-  int aMatrixSize = mXSize*mYSize;
-  int aOffset = az*aMatrixSize;
-  for (int i = 0; i < aMatrixSize; i++)
-    aMatrix.data()[i] = mData[i+aOffset];
+  aMatrix.view().copy(layer(az));
 }
 
 // putMatrix
@@ -1436,10 +1058,13 @@ template <class T>
 void CTensor<T>::putMatrix(CMatrix<T>& aMatrix, const int az) {
   if (aMatrix.xSize() != mXSize || aMatrix.ySize() != mYSize)
     throw ETensorIncompatibleSize(aMatrix.xSize(),aMatrix.ySize(),mXSize,mYSize);
-  int aMatrixSize = mXSize*mYSize;
-  int aOffset = az*aMatrixSize;
-  for (int i = 0; i < aMatrixSize; i++)
-    mData[i+aOffset] = aMatrix.data()[i];
+  layer(az).copy(aMatrix.view());
+}
+
+// layer
+template <class T>
+inline CMatrixView<T> CTensor<T>::layer(const int az) const {
+  return CMatrixView<T>(mData+az*mXSize*mYSize,mXSize,mYSize);
 }
 
 // data()
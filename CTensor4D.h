@@ -41,6 +41,8 @@ public:
   inline CTensor4D(const int aXSize, const int aYSize, const int aZSize, const int aASize);
   // copy constructor
   CTensor4D(const CTensor4D<T>& aCopyFrom);
+  // move constructor, aMoveFrom is left empty
+  CTensor4D(CTensor4D<T>&& aMoveFrom);
   // constructor with implicit filling
   CTensor4D(const int aXSize, const int aYSize, const int aZSize, const int aASize, const T aFillValue);
   // destructor
@@ -72,6 +74,8 @@ public:
   inline CTensor4D<T>& operator=(const T aValue);
   // Copies the tensor aCopyFrom to this tensor (size of tensor might change)
   CTensor4D<T>& operator=(const CTensor4D<T>& aCopyFrom);
+  // Takes over the data of aMoveFrom, aMoveFrom is left empty
+  CTensor4D<T>& operator=(CTensor4D<T>&& aMoveFrom);
   // Multiplication with a scalar
   CTensor4D<T>& operator*=(const T aValue);
   // Component-wise addition
@@ -93,6 +97,8 @@ public:
   void getMatrix(CMatrix<T>& aMatrix, int aZIndex, int aAIndex) const;
   // Copies the components of a 3D-tensor in the aDimth layer of the 4D-tensor
   void putMatrix(CMatrix<T>& aMatrix, int aZIndex, int aAIndex);
+  // Returns a view of one layer, works on the tensor's data without a copy
+  inline CMatrixView<T> layer(int aZIndex, int aAIndex) const;
   // Gives access to the internal data representation (use sparingly)
   inline T* data() const;
 protected:
@@ -155,7 +161,7 @@ inline CTensor4D<T>::CTensor4D() {
 template <class T>
 inline CTensor4D<T>::CTensor4D(const int aXSize, const int aYSize, const int aZSize, const int aASize)
   : mXSize(aXSize), mYSize(aYSize), mZSize(aZSize), mASize(aASize) {
-  mData = new T[aXSize*aYSize*aZSize*aASize];
+  mData = NMemory::allocate<T>(aXSize*aYSize*aZSize*aASize);
 }
 
 // copy constructor
@@ -163,30 +169,38 @@ template <class T>
 CTensor4D<T>::CTensor4D(const CTensor4D<T>& aCopyFrom)
   : mXSize(aCopyFrom.mXSize), mYSize(aCopyFrom.mYSize), mZSize(aCopyFrom.mZSize), mASize(aCopyFrom.mASize) {
   int wholeSize = mXSize*mYSize*mZSize*mASize;
-  mData = new T[wholeSize];
+  mData = NMemory::allocate<T>(wholeSize);
   for (register int i = 0; i < wholeSize; i++)
     mData[i] = aCopyFrom.mData[i];
 }
 
+// move constructor
+template <class T>
+CTensor4D<T>::CTensor4D(CTensor4D<T>&& aMoveFrom)
+  : mXSize(aMoveFrom.mXSize), mYSize(aMoveFrom.mYSize), mZSize(aMoveFrom.mZSize), mASize(aMoveFrom.mASize), mData(aMoveFrom.mData) {
+  aMoveFrom.mXSize = aMoveFrom.mYSize = aMoveFrom.mZSize = aMoveFrom.mASize = 0;
+  aMoveFrom.mData = 0;
+}
+
 // constructor with implicit filling
 template <class T>
 CTensor4D<T>::CTensor4D(const int aXSize, const int aYSize, const int aZSize, const int aASize, const T aFillValue)
   : mXSize(aXSize), mYSize(aYSize), mZSize(aZSize), mASize(aASize) {
-  mData = new T[aXSize*aYSize*aZSize*aASize];
+  mData = NMemory::allocate<T>(aXSize*aYSize*aZSize*aASize);
   fill(aFillValue);
 }
 
 // destructor
 template <class T>
 CTensor4D<T>::~CTensor4D() {
-  delete[] mData;
+  NMemory::release(mData);
 }
 
 // setSize
 template <class T>
 void CTensor4D<T>::setSize(int aXSize, int aYSize, int aZSize, int aASize) {
-  if (mData != 0) delete[] mData;
-  mData = new T[aXSize*aYSize*aZSize*aASize];
+  if (mData != 0) NMemory::release(mData);
+  mData = NMemory::allocate<T>(aXSize*aYSize*aZSize*aASize);
   mXSize = aXSize;
   mYSize = aYSize;
   mZSize = aZSize;
@@ -196,7 +210,7 @@ void CTensor4D<T>::setSize(int aXSize, int aYSize, int aZSize, int aASize) {
 //downsample
 template <class T>
 void CTensor4D<T>::downsample(int aNewXSize, int aNewYSize) {
-  T* mData2 = new T[aNewXSize*aNewYSize*mZSize*mASize];
+  T* mData2 = NMemory::allocate<T>(aNewXSize*aNewYSize*mZSize*mASize);
   int aSize = aNewXSize*aNewYSize;
   for (int a = 0; a < mASize; a++)
     for (int z = 0; z < mZSize; z++) {
@@ -206,7 +220,7 @@ void CTensor4D<T>::downsample(int aNewXSize, int aNewYSize) {
       for (int i = 0; i < aSize; i++)
         mData2[i+(a*mZSize+z)*aSize] = aTemp.data()[i];
     }
-  delete[] mData;
+  NMemory::release(mData);
   mData = mData2;
   mXSize = aNewXSize;
   mYSize = aNewYSize;
@@ -214,7 +228,7 @@ void CTensor4D<T>::downsample(int aNewXSize, int aNewYSize) {
 
 template <class T>
 void CTensor4D<T>::downsample(int aNewXSize, int aNewYSize, int aNewZSize) {
-  T* mData2 = new T[aNewXSize*aNewYSize*aNewZSize*mASize];
+  T* mData2 = NMemory::allocate<T>(aNewXSize*aNewYSize*aNewZSize*mASize);
   int aSize = aNewXSize*aNewYSize*aNewZSize;
   for (int a = 0; a < mASize; a++) {
     CTensor<T> aTemp(mXSize,mYSize,mZSize);
@@ -223,7 +237,7 @@ void CTensor4D<T>::downsample(int aNewXSize, int aNewYSize, int aNewZSize) {
     for (int i = 0; i < aSize; i++)
       mData2[i+a*aSize] = aTemp.data()[i];
   }
-  delete[] mData;
+  NMemory::release(mData);
   mData = mData2;
   mXSize = aNewXSize;
   mYSize = aNewYSize;
@@ -233,7 +247,7 @@ void CTensor4D<T>::downsample(int aNewXSize, int aNewYSize, int aNewZSize) {
 // upsample
 template <class T>
 void CTensor4D<T>::upsample(int aNewXSize, int aNewYSize) {
-  T* mData2 = new T[aNewXSize*aNewYSize*mZSize*mASize];
+  T* mData2 = NMemory::allocate<T>(aNewXSize*aNewYSize*mZSize*mASize);
   int aSize = aNewXSize*aNewYSize;
   for (int a = 0; a < mASize; a++)
     for (int z = 0; z < mZSize; z++) {
@@ -243,7 +257,7 @@ void CTensor4D<T>::upsample(int aNewXSize, int aNewYSize) {
       for (int i = 0; i < aSize; i++)
         mData2[i+(a*mZSize+z)*aSize] = aTemp.data()[i];
     }
-  delete[] mData;
+  NMemory::release(mData);
   mData = mData2;
   mXSize = aNewXSize;
   mYSize = aNewYSize;
@@ -252,7 +266,7 @@ void CTensor4D<T>::upsample(int aNewXSize, int aNewYSize) {
 // upsampleBilinear
 template <class T>
 void CTensor4D<T>::upsampleBilinear(int aNewXSize, int aNewYSize) {
-  T* mData2 = new T[aNewXSize*aNewYSize*mZSize*mASize];
+  T* mData2 = NMemory::allocate<T>(aNewXSize*aNewYSize*mZSize*mASize);
   int aSize = aNewXSize*aNewYSize;
   for (int a = 0; a < mASize; a++)
     for (int z = 0; z < mZSize; z++) {
@@ -262,7 +276,7 @@ void CTensor4D<T>::upsampleBilinear(int aNewXSize, int aNewYSize) {
       for (int i = 0; i < aSize; i++)
         mData2[i+(a*mZSize+z)*aSize] = aTemp.data()[i];
     }
-  delete[] mData;
+  NMemory::release(mData);
   mData = mData2;
   mXSize = aNewXSize;
   mYSize = aNewYSize;
@@ -271,7 +285,7 @@ void CTensor4D<T>::upsampleBilinear(int aNewXSize, int aNewYSize) {
 // upsampleTrilinear
 template <class T>
 void CTensor4D<T>::upsampleTrilinear(int aNewXSize, int aNewYSize, int aNewZSize) {
-  T* mData2 = new T[aNewXSize*aNewYSize*aNewZSize*mASize];
+  T* mData2 = NMemory::allocate<T>(aNewXSize*aNewYSize*aNewZSize*mASize);
   int aSize = aNewXSize*aNewYSize*aNewZSize;
   for (int a = 0; a < mASize; a++) {
     CTensor<T> aTemp(mXSize,mYSize,mZSize);
@@ -280,7 +294,7 @@ void CTensor4D<T>::upsampleTrilinear(int aNewXSize, int aNewYSize, int aNewZSize
     for (int i = 0; i < aSize; i++)
       mData2[i+a*aSize] = aTemp.data()[i];
   }
-  delete[] mData;
+  NMemory::release(mData);
   mData = mData2;
   mXSize = aNewXSize;
   mYSize = aNewYSize;
@@ -302,8 +316,8 @@ void CTensor4D<T>::cut(CTensor4D<T>& aResult, int x1, int y1, int z1, int a1, in
   aResult.mYSize = y2-y1+1;
   aResult.mZSize = z2-z1+1;
   aResult.mASize = a2-a1+1;
-  delete[] aResult.mData;
-  aResult.mData = new T[aResult.mXSize*aResult.mYSize*aResult.mZSize*aResult.mASize];
+  NMemory::release(aResult.mData);
+  aResult.mData = NMemory::allocate<T>(aResult.mXSize*aResult.mYSize*aResult.mZSize*aResult.mASize);
   for (int a = a1; a <= a2; a++)
     for (int z = z1; z <= z2; z++)
       for (int y = y1; y <= y2; y++)
@@ -314,7 +328,7 @@ void CTensor4D<T>::cut(CTensor4D<T>& aResult, int x1, int y1, int z1, int a1, in
 // readFromFile
 template <class T>
 void CTensor4D<T>::readFromFile(char* aFilename) {
-  if (mData != 0) delete[] mData;
+  if (mData != 0) NMemory::release(mData);
   std::string s;
   std::string aPath = aFilename;
   aPath.erase(aPath.find_last_of('\\')+1,100);
@@ -344,7 +358,7 @@ void CTensor4D<T>::readFromFile(char* aFilename) {
     mXSize = aTemp.xSize();
     mYSize = aTemp.ySize();
     int aSize = mXSize*mYSize;
-    mData = new T[aSize*mASize];
+    mData = NMemory::allocate<T>(aSize*mASize);
     for (int i = 0; i < aSize; i++)
       mData[i] = aTemp.data()[i];
     for (int a = 1; a < mASize; a++) {
@@ -362,7 +376,7 @@ void CTensor4D<T>::readFromFile(char* aFilename) {
     mXSize = aTemp.xSize();
     mYSize = aTemp.ySize();
     int aSize = 3*mXSize*mYSize;
-    mData = new T[aSize*mASize];
+    mData = NMemory::allocate<T>(aSize*mASize);
     for (int i = 0; i < aSize; i++)
       mData[i] = aTemp.data()[i];
     for (int a = 1; a < mASize; a++) {
@@ -443,19 +457,34 @@ inline CTensor4D<T>& CTensor4D<T>::operator=(const T aValue) {
 template <class T>
 CTensor4D<T>& CTensor4D<T>::operator=(const CTensor4D<T>& aCopyFrom) {
   if (this != &aCopyFrom) {
-    if (mData != 0) delete[] mData;
+    if (mData != 0) NMemory::release(mData);
     mXSize = aCopyFrom.mXSize;
     mYSize = aCopyFrom.mYSize;
     mZSize = aCopyFrom.mZSize;
     mASize = aCopyFrom.mASize;
     int wholeSize = mXSize*mYSize*mZSize*mASize;
-    mData = new T[wholeSize];
+    mData = NMemory::allocate<T>(wholeSize);
     for (register int i = 0; i < wholeSize; i++)
       mData[i] = aCopyFrom.mData[i];
   }
   return *this;
 }
 
+template <class T>
+CTensor4D<T>& CTensor4D<T>::operator=(CTensor4D<T>&& aMoveFrom) {
+  if (this != &aMoveFrom) {
+    NMemory::release(mData);
+    mXSize = aMoveFrom.mXSize;
+    mYSize = aMoveFrom.mYSize;
+    mZSize = aMoveFrom.mZSize;
+    mASize = aMoveFrom.mASize;
+    mData = aMoveFrom.mData;
+    aMoveFrom.mXSize = aMoveFrom.mYSize = aMoveFrom.mZSize = aMoveFrom.mASize = 0;
+    aMoveFrom.mData = 0;
+  }
+  return *this;
+}
+
 // operator *=
 template <class T>
 CTensor4D<T>& CTensor4D<T>::operator*=(const T aValue) {
@@ -611,10 +640,7 @@ template <class T>
 void CTensor4D<T>::getMatrix(CMatrix<T>& aMatrix, int aZIndex, int aAIndex) const {
   if (aMatrix.xSize() != mXSize || aMatrix.ySize() != mYSize)
     throw ETensor4DIncompatibleSize(aMatrix.xSize(),aMatrix.ySize(),1,mXSize,mYSize,1);
-  int aSize = mXSize*mYSize;
-  int aOffset = aSize*(aAIndex*mZSize+aZIndex);
-  for (int i = 0; i < aSize; i++)
-    aMatrix.data()[i] = mData[i+aOffset];
+  aMatrix.view().copy(layer(aZIndex,aAIndex));
 }
 
 // putMatrix
@@ -622,10 +648,13 @@ template <class T>
 void CTensor4D<T>::putMatrix(CMatrix<T>& aMatrix, int aZIndex, int aAIndex) {
   if (aMatrix.xSize() != mXSize || aMatrix.ySize() != mYSize)
     throw ETensor4DIncompatibleSize(aMatrix.xSize(),aMatrix.ySize(),1,mXSize,mYSize,1);
-  int aSize = mXSize*mYSize;
-  int aOffset = aSize*(aAIndex*mZSize+aZIndex);
-  for (int i = 0; i < aSize; i++)
-    mData[i+aOffset] = aMatrix.data()[i];
+  layer(aZIndex,aAIndex).copy(aMatrix.view());
+}
+
+// layer
+template <class T>
+inline CMatrixView<T> CTensor4D<T>::layer(int aZIndex, int aAIndex) const {
+  return CMatrixView<T>(mData+mXSize*mYSize*(aAIndex*mZSize+aZIndex),mXSize,mYSize);
 }
 
 // data()
@@ -0,0 +1,237 @@
+// CThreadPool
+// A fixed set of worker threads that process batches of indexed jobs
+//
+// Each worker starts with a contiguous share of the job indices and works
+// through it from the front. A worker that runs out of jobs steals the back
+// half of the largest remaining share of another worker, so uneven job
+// durations do not leave threads idle.
+//
+// Library functions parallelize their loops with parallelFor(), which uses
+// a pool shared by the whole process. Called from a worker of any pool it
+// runs serially, so an image filtered inside a parallel pipeline does not
+// spawn further parallel loops.
+//
+// Example:
+// CThreadPool pool(4);
+// pool.run(100, [&](int aJob, int aWorker) { process(aJob, buffers[aWorker]); });
+// CThreadPool::parallelFor(rows, [&](int aRow) { process(aRow); });
+//-------------------------------------------------------------------------
+
+#ifndef CTHREADPOOL_H
+#define CTHREADPOOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+
+class CThreadPool {
+public:
+  // constructor, aThreads = 0 uses one thread per core
+  CThreadPool(int aThreads = 0);
+  // destructor, waits for the workers to terminate
+  virtual ~CThreadPool();
+
+  // Calls aJob(aIndex,aWorker) for all 0 <= aIndex < aCount and returns when all
+  // jobs are done. aWorker < threads() identifies the calling worker, so jobs can
+  // use per-worker buffers. The first exception thrown by a job is rethrown here.
+  void run(int aCount, const std::function<void(int,int)>& aJob);
+
+  // Gives access to the number of worker threads
+  inline int threads() const;
+  // Returns the number of cores (at least 1)
+  static int cores();
+
+  // Calls aJob(aIndex) for all 0 <= aIndex < aCount on the shared pool with one thread per core.
+  // Runs serially on the calling thread if it is a worker itself or if the shared pool is busy.
+  static void parallelFor(int aCount, const std::function<void(int)>& aJob);
+  // True if the calling thread is a worker of a CThreadPool
+  static inline bool inWorker();
+protected:
+  // Flag of the calling thread, set in the workers
+  static inline bool& worker();
+  // Share of job indices owned by one worker: aBegin <= i < aEnd
+  struct CShare {
+    std::mutex mMutex;
+    int mBegin,mEnd;
+  };
+  // Main loop of a worker thread
+  void work(int aWorker);
+  // Fetches the next job of aWorker, steals if necessary; returns false if all jobs are taken
+  bool next(int aWorker, int& aIndex);
+
+  int mThreads;
+  std::vector<std::thread> mWorkers;
+  std::vector<CShare*> mShares;
+  std::mutex mMutex;
+  std::condition_variable mStart;
+  std::condition_variable mDone;
+  const std::function<void(int,int)>* mJob;
+  int mBatch;
+  int mBusy;
+  bool mQuit;
+  std::exception_ptr mError;
+};
+
+// I M P L E M E N T A T I O N --------------------------------------------
+
+// constructor
+inline CThreadPool::CThreadPool(int aThreads)
+  : mThreads(aThreads > 0 ? aThreads : cores()), mJob(0), mBatch(0), mBusy(0), mQuit(false) {
+  for (int i = 0; i < mThreads; i++) {
+    mShares.push_back(new CShare);
+    mShares[i]->mBegin = mShares[i]->mEnd = 0;
+  }
+  for (int i = 0; i < mThreads; i++)
+    mWorkers.push_back(std::thread(&CThreadPool::work,this,i));
+}
+
+// destructor
+inline CThreadPool::~CThreadPool() {
+  {
+    std::lock_guard<std::mutex> aLock(mMutex);
+    mQuit = true;
+  }
+  mStart.notify_all();
+  for (int i = 0; i < mThreads; i++) {
+    mWorkers[i].join();
+    delete mShares[i];
+  }
+}
+
+// run
+inline void CThreadPool::run(int aCount, const std::function<void(int,int)>& aJob) {
+  if (aCount <= 0) return;
+  // Distribute contiguous shares
+  for (int i = 0; i < mThreads; i++) {
+    std::lock_guard<std::mutex> aLock(mShares[i]->mMutex);
+    mShares[i]->mBegin = (int)((long long)aCount*i/mThreads);
+    mShares[i]->mEnd = (int)((long long)aCount*(i+1)/mThreads);
+  }
+  std::unique_lock<std::mutex> aLock(mMutex);
+  mJob = &aJob;
+  mError = std::exception_ptr();
+  mBusy = mThreads;
+  mBatch++;
+  mStart.notify_all();
+  while (mBusy > 0)
+    mDone.wait(aLock);
+  mJob = 0;
+  if (mError) std::rethrow_exception(mError);
+}
+
+// threads
+inline int CThreadPool::threads() const {
+  return mThreads;
+}
+
+// cores
+inline int CThreadPool::cores() {
+  int aCores = std::thread::hardware_concurrency();
+  if (aCores < 1) aCores = 1;
+  return aCores;
+}
+
+// parallelFor
+inline void CThreadPool::parallelFor(int aCount, const std::function<void(int)>& aJob) {
+  if (aCount > 1 && !inWorker() && cores() > 1) {
+    static std::mutex aMutex;
+    std::unique_lock<std::mutex> aLock(aMutex,std::try_to_lock);
+    if (aLock.owns_lock()) {
+      static CThreadPool aShared;
+      aShared.run(aCount,[&](int aIndex, int) { aJob(aIndex); });
+      return;
+    }
+  }
+  for (int i = 0; i < aCount; i++)
+    aJob(i);
+}
+
+// inWorker
+inline bool CThreadPool::inWorker() {
+  return worker();
+}
+
+// P R O T E C T E D ------------------------------------------------------
+
+// worker
+inline bool& CThreadPool::worker() {
+  static thread_local bool aWorker = false;
+  return aWorker;
+}
+
+// work
+inline void CThreadPool::work(int aWorker) {
+  worker() = true;
+  int aBatch = 0;
+  while (true) {
+    const std::function<void(int,int)>* aJob;
+    {
+      std::unique_lock<std::mutex> aLock(mMutex);
+      while (!mQuit && mBatch == aBatch)
+        mStart.wait(aLock);
+      if (mQuit) return;
+      aBatch = mBatch;
+      aJob = mJob;
+    }
+    int aIndex;
+    while (next(aWorker,aIndex)) {
+      try {
+        (*aJob)(aIndex,aWorker);
+      }
+      catch (...) {
+        std::lock_guard<std::mutex> aLock(mMutex);
+        if (!mError) mError = std::current_exception();
+      }
+    }
+    std::lock_guard<std::mutex> aLock(mMutex);
+    if (--mBusy == 0) mDone.notify_one();
+  }
+}
+
+// next
+inline bool CThreadPool::next(int aWorker, int& aIndex) {
+  CShare* aOwn = mShares[aWorker];
+  {
+    std::lock_guard<std::mutex> aLock(aOwn->mMutex);
+    if (aOwn->mBegin < aOwn->mEnd) {
+      aIndex = aOwn->mBegin++;
+      return true;
+    }
+  }
+  // Own share is empty: steal the back half of the largest share
+  while (true) {
+    int aVictim = -1;
+    int aLargest = 0;
+    for (int i = 0; i < mThreads; i++) {
+      if (i == aWorker) continue;
+      std::lock_guard<std::mutex> aLock(mShares[i]->mMutex);
+      int aLeft = mShares[i]->mEnd-mShares[i]->mBegin;
+      if (aLeft > aLargest) {
+        aLargest = aLeft;
+        aVictim = i;
+      }
+    }
+    if (aVictim < 0) return false;
+    int aBegin,aEnd;
+    {
+      std::lock_guard<std::mutex> aLock(mShares[aVictim]->mMutex);
+      CShare* aShare = mShares[aVictim];
+      int aLeft = aShare->mEnd-aShare->mBegin;
+      // The victim might have finished its share in the meantime
+      if (aLeft <= 0) continue;
+      aEnd = aShare->mEnd;
+      aBegin = aShare->mEnd-(aLeft+1)/2;
+      aShare->mEnd = aBegin;
+    }
+    std::lock_guard<std::mutex> aLock(aOwn->mMutex);
+    aIndex = aBegin;
+    aOwn->mBegin = aBegin+1;
+    aOwn->mEnd = aEnd;
+    return true;
+  }
+}
+
+#endif
@@ -9,6 +9,7 @@
 
 #include <iostream>
 #include <fstream>
+#include "NMemory.h"
 
 template <class T>
 class CVector {
@@ -19,6 +20,8 @@ public:
   inline CVector(const int aSize);
   // copy constructor
   CVector(const CVector<T>& aCopyFrom);
+  // move constructor, aMoveFrom is left empty
+  CVector(CVector<T>&& aMoveFrom);
   // constructor (from array)
   CVector(const T* aPointer, const int aSize);
   // constructor with implicit filling
@@ -59,6 +62,8 @@ public:
   inline CVector<T>& operator=(const T aValue);
   // Copies a vector into this vector (size might change)
   CVector<T>& operator=(const CVector<T>& aCopyFrom);
+  // Takes over the data of aMoveFrom, aMoveFrom is left empty
+  CVector<T>& operator=(CVector<T>&& aMoveFrom);
   // Adds another vector
   CVector<T>& operator+=(const CVector<T>& aVector);
   // Substracts another vector
@@ -127,30 +132,38 @@ struct EVectorIncompatibleSize {
 // constructor
 template <class T>
 inline CVector<T>::CVector() : mSize(0) {
-  mData = new T[0];
+  mData = NMemory::allocate<T>(0);
 }
 
 // constructor
 template <class T>
 inline CVector<T>::CVector(const int aSize)
   : mSize(aSize) {
-  mData = new T[aSize];
+  mData = NMemory::allocate<T>(aSize);
 }
 
 // copy constructor
 template <class T>
 CVector<T>::CVector(const CVector<T>& aCopyFrom)
   : mSize(aCopyFrom.mSize) {
-  mData = new T[mSize];
+  mData = NMemory::allocate<T>(mSize);
   for (int i = 0; i < mSize; i++)
     mData[i] = aCopyFrom.mData[i];
 }
 
+// move constructor
+template <class T>
+CVector<T>::CVector(CVector<T>&& aMoveFrom)
+  : mSize(aMoveFrom.mSize), mData(aMoveFrom.mData) {
+  aMoveFrom.mSize = 0;
+  aMoveFrom.mData = 0;
+}
+
 // constructor (from array)
 template <class T>
 CVector<T>::CVector(const T* aPointer, const int aSize)
   : mSize(aSize) {
-  mData = new T[mSize];
+  mData = NMemory::allocate<T>(mSize);
   for (int i = 0; i < mSize; i++)
     mData[i] = aPointer[i];
 }
@@ -159,21 +172,21 @@ CVector<T>::CVector(const T* aPointer, const int aSize)
 template <class T>
 CVector<T>::CVector(const int aSize, const T aFillValue)
   : mSize(aSize) {
-  mData = new T[aSize];
+  mData = NMemory::allocate<T>(aSize);
   fill(aFillValue);
 }
 
 // destructor
 template <class T>
 CVector<T>::~CVector() {
-  delete[] mData;
+  NMemory::release(mData);
 }
 
 // setSize
 template <class T>
 void CVector<T>::setSize(int aSize) {
-  if (mData != 0) delete[] mData;
-  mData = new T[aSize];
+  if (mData != 0) NMemory::release(mData);
+  mData = NMemory::allocate<T>(aSize);
   mSize = aSize;
 }
 
@@ -187,13 +200,13 @@ void CVector<T>::fill(const T aValue) {
 // append
 template <class T>
 void CVector<T>::append(CVector<T>& aVector) {
-  T* aNewData = new T[mSize+aVector.size()];
+  T* aNewData = NMemory::allocate<T>(mSize+aVector.size());
   for (int i = 0; i < mSize; i++)
     aNewData[i] = mData[i];
   for (int i = 0; i < aVector.size(); i++)
     aNewData[i+mSize] = aVector(i);
   mSize += aVector.size();
-  delete[] mData;
+  NMemory::release(mData);
   mData = aNewData;
 }
 
@@ -220,8 +233,8 @@ void CVector<T>::readFromTXT(const char* aFilename) {
   }
   aStream.close();
   std::ifstream aStream2(aFilename);
-  delete mData;
-  mData = new T[mSize];
+  NMemory::release(mData);
+  mData = NMemory::allocate<T>(mSize);
   for (int i = 0; i < mSize; i++)
     aStream2 >> mData[i];
 }
@@ -316,9 +329,9 @@ template <class T>
 CVector<T>& CVector<T>::operator=(const CVector<T>& aCopyFrom) {
   if (this != &aCopyFrom) {
     if (mSize != aCopyFrom.size()) {
-      delete[] mData;
+      NMemory::release(mData);
       mSize = aCopyFrom.size();
-      mData = new T[mSize];
+      mData = NMemory::allocate<T>(mSize);
     }
     for (register int i = 0; i < mSize; i++)
       mData[i] = aCopyFrom.mData[i];
@@ -326,6 +339,18 @@ CVector<T>& CVector<T>::operator=(const CVector<T>& aCopyFrom) {
   return *this;
 }
 
+template <class T>
+CVector<T>& CVector<T>::operator=(CVector<T>&& aMoveFrom) {
+  if (this != &aMoveFrom) {
+    NMemory::release(mData);
+    mSize = aMoveFrom.mSize;
+    mData = aMoveFrom.mData;
+    aMoveFrom.mSize = 0;
+    aMoveFrom.mData = 0;
+  }
+  return *this;
+}
+
 // operator +=
 template <class T>
 CVector<T>& CVector<T>::operator+=(const CVector<T>& aVector) {
@@ -183,8 +183,8 @@ namespace NMath {
   // Mathematical Computations (Englewood Cliffs, NJ: Prentice-Hall), Chapter 9, 1977,
   // Code bernommen von Bodo Rosenhahn)
   void svd(CMatrix<float>& U, CMatrix<float>& S, CMatrix<float>& V, bool aOrdering, int aIterations) {
-    static float at,bt,ct;
-    static float maxarg1,maxarg2;
+    float at,bt,ct;
+    float maxarg1,maxarg2;
     #define PYTHAG(a,b) ((at=fabs(a)) > (bt=fabs(b)) ?  (ct=bt/at,at*sqrt(1.0+ct*ct)) : (bt ? (ct=at/bt,bt*sqrt(1.0+ct*ct)): 0.0))
     #define MAX(a,b) (maxarg1=(a),maxarg2=(b),(maxarg1) > (maxarg2) ?	(maxarg1) : (maxarg2))
     #define MIN(a,b) ((a) >(b) ? (b) : (a))
@@ -0,0 +1,173 @@
+// NMemory
+// Aligned, pooled memory for the data of CVector, CMatrix, CTensor and CTensor4D
+//
+// All blocks are aligned to 64 bytes (a cache line, an AVX-512 register).
+// Freed blocks are kept in a pool of the releasing thread, sorted into size
+// classes a quarter power of two apart, and reused by the next allocation of
+// the same class. Temporaries of the same size, as created for every frame
+// of a sequence, thus come from the pool instead of the system. A block
+// released by another thread than the one that allocated it moves to the
+// pool of the releasing thread.
+//
+// Define NO_MEMORY_POOL to hand every block back to the system immediately,
+// e.g. for memory checkers.
+//-------------------------------------------------------------------------
+
+#ifndef NMEMORY_H
+#define NMEMORY_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <new>
+#include <vector>
+#include <type_traits>
+
+namespace NMemory {
+  // Alignment of all blocks in bytes
+  enum { cAlignment = 64 };
+
+  // Allocates an array of aCount elements, elements of trivial types are not initialized
+  template <class T> inline T* allocate(int aCount);
+  // Releases an array obtained from allocate(), 0 is ignored
+  template <class T> inline void release(T* aData);
+  // Returns the blocks pooled by the calling thread to the system
+  inline void trim();
+}
+
+// I M P L E M E N T A T I O N --------------------------------------------
+
+namespace NMemory {
+
+  // Size classes up to 64 << 24 bytes (1 GB) are pooled
+  enum { cClasses = 4*24+1 };
+  // Upper bound of the memory a single thread keeps pooled
+  static const size_t cMaxPooled = (size_t)256 << 20;
+
+  // Stored in front of the data of each block
+  struct CHeader {
+    void* mMemory;
+    size_t mCount;
+    int mClass;
+  };
+
+  // Returns the size class of a block of aBytes and the size of that class in aClassBytes
+  inline int sizeClass(size_t aBytes, size_t& aClassBytes) {
+    if (aBytes <= cAlignment) {
+      aClassBytes = cAlignment;
+      return 0;
+    }
+    int aClass = 1;
+    size_t aOctave = cAlignment;
+    while (2*aOctave < aBytes) {
+      aOctave *= 2;
+      aClass += 4;
+    }
+    // aOctave < aBytes <= 2*aOctave, take the smallest quarter step that fits
+    size_t aStep = aOctave/4;
+    int aQuarter = (aBytes-aOctave+aStep-1)/aStep;
+    aClassBytes = aOctave+aQuarter*aStep;
+    return aClass+aQuarter-1;
+  }
+
+  // Free blocks of one thread
+  class CPool {
+  public:
+    CPool() : mPooled(0) {
+      state() = 1;
+    }
+    ~CPool() {
+      clear();
+      state() = 2;
+    }
+    // Returns a free block of class aClass or 0
+    void* get(int aClass, size_t aClassBytes) {
+      if (aClass >= cClasses || mFree[aClass].empty()) return 0;
+      void* aMemory = mFree[aClass].back();
+      mFree[aClass].pop_back();
+      mPooled -= aClassBytes;
+      return aMemory;
+    }
+    // Keeps a block for reuse, returns false if the pool is full
+    bool put(void* aMemory, int aClass, size_t aClassBytes) {
+      if (aClass >= cClasses || mPooled+aClassBytes > cMaxPooled) return false;
+      mFree[aClass].push_back(aMemory);
+      mPooled += aClassBytes;
+      return true;
+    }
+    // Returns all free blocks to the system
+    void clear() {
+      for (int i = 0; i < cClasses; i++) {
+        for (unsigned int j = 0; j < mFree[i].size(); j++)
+          free(mFree[i][j]);
+        mFree[i].clear();
+      }
+      mPooled = 0;
+    }
+    // 0: not yet created, 1: alive, 2: destroyed at thread exit
+    static int& state() {
+      static thread_local int aState = 0;
+      return aState;
+    }
+  protected:
+    std::vector<void*> mFree[cClasses];
+    size_t mPooled;
+  };
+
+  // The pool of the calling thread, 0 once the thread is shutting down
+  inline CPool* pool() {
+    #ifdef NO_MEMORY_POOL
+    return 0;
+    #else
+    if (CPool::state() == 2) return 0;
+    static thread_local CPool aPool;
+    return &aPool;
+    #endif
+  }
+
+  // allocate
+  template <class T>
+  inline T* allocate(int aCount) {
+    if (aCount < 0) aCount = 0;
+    size_t aClassBytes;
+    int aClass = sizeClass(aCount*sizeof(T),aClassBytes);
+    CPool* aPool = pool();
+    void* aMemory = (aPool == 0) ? 0 : aPool->get(aClass,aClassBytes);
+    // One cache line for the header plus the slack needed for the alignment
+    if (aMemory == 0) aMemory = malloc(aClassBytes+2*cAlignment);
+    if (aMemory == 0) throw std::bad_alloc();
+    char* aData = (char*)(((uintptr_t)aMemory+2*cAlignment-1) & ~(uintptr_t)(cAlignment-1));
+    CHeader* aHeader = (CHeader*)aData-1;
+    aHeader->mMemory = aMemory;
+    aHeader->mCount = aCount;
+    aHeader->mClass = aClass;
+    T* aResult = (T*)aData;
+    if (!std::is_trivially_default_constructible<T>::value)
+      for (int i = 0; i < aCount; i++)
+        new (aResult+i) T();
+    return aResult;
+  }
+
+  // release
+  template <class T>
+  inline void release(T* aData) {
+    if (aData == 0) return;
+    CHeader* aHeader = (CHeader*)aData-1;
+    if (!std::is_trivially_destructible<T>::value)
+      for (size_t i = 0; i < aHeader->mCount; i++)
+        aData[i].~T();
+    size_t aClassBytes;
+    sizeClass(aHeader->mCount*sizeof(T),aClassBytes);
+    void* aMemory = aHeader->mMemory;
+    CPool* aPool = pool();
+    if (aPool == 0 || !aPool->put(aMemory,aHeader->mClass,aClassBytes)) free(aMemory);
+  }
+
+  // trim
+  inline void trim() {
+    CPool* aPool = pool();
+    if (aPool != 0) aPool->clear();
+  }
+
+}
+
+#endif
@@ -0,0 +1,170 @@
+// NPNM
+// Bulk reading of binary PGM (P5) and PPM (P6) files
+//
+// The whole file is read with a single fread into a buffer that is reused
+// by the calling thread, the header is parsed once, and the raster is
+// converted to the destination type by plain loops the compiler vectorizes.
+//-------------------------------------------------------------------------
+
+#ifndef NPNM_H
+#define NPNM_H
+
+#include <stdio.h>
+#include <vector>
+
+namespace NPNM {
+  // Result of reading a file
+  enum EStatus { cOK = 0, cNotFound, cInvalidFormat };
+
+  // Reads the file aFilename of type P<aType> (aType = '5' for PGM, '6' for PPM) into a
+  // thread-local buffer. On success aPixels points to aXSize*aYSize*channels bytes of raster
+  // data, which stay valid until the calling thread reads the next file.
+  EStatus read(const char* aFilename, char aType, int& aXSize, int& aYSize, const unsigned char*& aPixels);
+
+  // Converts aSize bytes to T
+  template <class T> inline void widen(const unsigned char* aSource, T* aDest, int aSize);
+  // Splits aSize interleaved RGB pixels into three planes and converts them to T
+  template <class T> inline void deinterleave(const unsigned char* aSource, T* aRed, T* aGreen, T* aBlue, int aSize);
+  // Extracts channel aChannel (0,1,2) of aSize interleaved RGB pixels and converts it to T
+  template <class T> inline void extractChannel(const unsigned char* aSource, int aChannel, T* aDest, int aSize);
+  // Computes the luma 0.299*R+0.587*G+0.114*B (ITU-R BT.601) of aSize interleaved RGB pixels
+  template <class T> inline void luma(const unsigned char* aSource, T* aDest, int aSize);
+  // Averages aFactor x aFactor blocks of channel aChannel (luma if aChannel < 0) of an interleaved
+  // RGB raster of size aXSize x aYSize. aDest receives (aXSize/aFactor) x (aYSize/aFactor) pixels,
+  // incomplete blocks at the right and bottom border are dropped. The rows of aDest are aDestPitch
+  // elements apart, 0 stands for aXSize/aFactor. Nothing is written if aFactor exceeds either size.
+  template <class T> void boxReduce(const unsigned char* aSource, int aXSize, int aYSize, int aChannel, int aFactor, T* aDest, int aDestPitch = 0);
+}
+
+// I M P L E M E N T A T I O N --------------------------------------------
+
+namespace NPNM {
+
+  // Skips whitespace and comments, then parses a non-negative decimal number
+  inline bool parseNumber(const unsigned char*& aPos, const unsigned char* aEnd, int& aValue) {
+    while (aPos < aEnd) {
+      if (*aPos == '#')
+        while (aPos < aEnd && *aPos != '\n' && *aPos != '\r') aPos++;
+      else if (*aPos == ' ' || *aPos == '\t' || *aPos == '\n' || *aPos == '\r' || *aPos == '\v' || *aPos == '\f') aPos++;
+      else break;
+    }
+    if (aPos >= aEnd || *aPos < '0' || *aPos > '9') return false;
+    aValue = 0;
+    while (aPos < aEnd && *aPos >= '0' && *aPos <= '9') {
+      aValue = 10*aValue+(*aPos-'0');
+      aPos++;
+    }
+    return true;
+  }
+
+  // read
+  inline EStatus read(const char* aFilename, char aType, int& aXSize, int& aYSize, const unsigned char*& aPixels) {
+    static thread_local std::vector<unsigned char> aBuffer;
+    FILE* aStream = fopen(aFilename,"rb");
+    if (aStream == 0) return cNotFound;
+    // Read the whole file at once
+    fseek(aStream,0,SEEK_END);
+    long aFileSize = ftell(aStream);
+    fseek(aStream,0,SEEK_SET);
+    if (aFileSize <= 0) {
+      fclose(aStream);
+      return cInvalidFormat;
+    }
+    if ((long)aBuffer.size() < aFileSize) aBuffer.resize(aFileSize);
+    size_t aRead = fread(&aBuffer[0],1,aFileSize,aStream);
+    fclose(aStream);
+    const unsigned char* aPos = &aBuffer[0];
+    const unsigned char* aEnd = aPos+aRead;
+    // Find beginning of file (P5 or P6)
+    while (aPos < aEnd && *aPos != 'P') aPos++;
+    if (aEnd-aPos < 2 || aPos[1] != aType) return cInvalidFormat;
+    aPos += 2;
+    // Header: width, height, maximum value, separated by whitespace and comments
+    int aMaxVal;
+    if (!parseNumber(aPos,aEnd,aXSize) || !parseNumber(aPos,aEnd,aYSize) || !parseNumber(aPos,aEnd,aMaxVal))
+      return cInvalidFormat;
+    // Only 8 bit rasters are supported
+    if (aMaxVal <= 0 || aMaxVal > 255) return cInvalidFormat;
+    // Exactly one whitespace character separates header and raster
+    aPos++;
+    long aRasterSize = (long)aXSize*aYSize*(aType == '6' ? 3 : 1);
+    if (aEnd-aPos < aRasterSize) return cInvalidFormat;
+    aPixels = aPos;
+    return cOK;
+  }
+
+  // widen
+  template <class T>
+  inline void widen(const unsigned char* aSource, T* aDest, int aSize) {
+    for (int i = 0; i < aSize; i++)
+      aDest[i] = aSource[i];
+  }
+
+  // deinterleave
+  template <class T>
+  inline void deinterleave(const unsigned char* aSource, T* aRed, T* aGreen, T* aBlue, int aSize) {
+    for (int i = 0; i < aSize; i++) {
+      aRed[i] = aSource[3*i];
+      aGreen[i] = aSource[3*i+1];
+      aBlue[i] = aSource[3*i+2];
+    }
+  }
+
+  // extractChannel
+  template <class T>
+  inline void extractChannel(const unsigned char* aSource, int aChannel, T* aDest, int aSize) {
+    aSource += aChannel;
+    for (int i = 0; i < aSize; i++)
+      aDest[i] = aSource[3*i];
+  }
+
+  // luma
+  template <class T>
+  inline void luma(const unsigned char* aSource, T* aDest, int aSize) {
+    // Single precision arithmetic lets the compiler process more pixels per vector
+    for (int i = 0; i < aSize; i++)
+      aDest[i] = 0.299f*aSource[3*i]+0.587f*aSource[3*i+1]+0.114f*aSource[3*i+2];
+  }
+
+  // boxReduce
+  template <class T>
+  void boxReduce(const unsigned char* aSource, int aXSize, int aYSize, int aChannel, int aFactor, T* aDest, int aDestPitch) {
+    int aNewXSize = aXSize/aFactor;
+    int aNewYSize = aYSize/aFactor;
+    if (aNewXSize <= 0 || aNewYSize <= 0) return;
+    if (aDestPitch <= 0) aDestPitch = aNewXSize;
+    int aRowSize = aNewXSize*aFactor;
+    // Sums of aFactor input rows, the horizontal reduction follows per output row
+    static thread_local std::vector<float> aColumnSum;
+    if ((int)aColumnSum.size() < aRowSize) aColumnSum.resize(aRowSize);
+    float* aSum = &aColumnSum[0];
+    float aNormalize = 1.0f/(aFactor*aFactor);
+    for (int y = 0; y < aNewYSize; y++) {
+      for (int x = 0; x < aRowSize; x++)
+        aSum[x] = 0.0f;
+      for (int k = 0; k < aFactor; k++) {
+        const unsigned char* aRow = aSource+3*(y*aFactor+k)*aXSize;
+        if (aChannel >= 0) {
+          aRow += aChannel;
+          for (int x = 0; x < aRowSize; x++)
+            aSum[x] += aRow[3*x];
+        }
+        else for (int x = 0; x < aRowSize; x++)
+          aSum[x] += 0.299f*aRow[3*x]+0.587f*aRow[3*x+1]+0.114f*aRow[3*x+2];
+      }
+      T* aOut = aDest+y*aDestPitch;
+      if (aFactor == 2)
+        for (int x = 0; x < aNewXSize; x++)
+          aOut[x] = aNormalize*(aSum[2*x]+aSum[2*x+1]);
+      else for (int x = 0; x < aNewXSize; x++) {
+        float aHelp = 0.0f;
+        for (int j = 0; j < aFactor; j++)
+          aHelp += aSum[x*aFactor+j];
+        aOut[x] = aNormalize*aHelp;
+      }
+    }
+  }
+
+}
+
+#endif
@@ -0,0 +1,282 @@
+// NScore
+// Blur scores of edge images and spectra and their comparison within a sequence
+//
+// The score of a frame is its edge strength in the image center, or the share
+// of its spectral energy at high frequencies, which blur removes first. A
+// frame is considered blurred if its score falls clearly below a statistic of
+// the scores of its neighboring frames.
+//-------------------------------------------------------------------------
+
+#ifndef NSCORE_H
+#define NSCORE_H
+
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include "CMatrix.h"
+#include "CFFTPlan.h"
+
+namespace NScore {
+  // Statistics of the neighborhood of a frame
+  enum EStatistic { cMean = 0, cMedian, cTrimmedMean };
+
+  // Edge strength in the center region of an edge image. aFile counts the values truncated
+  // to the 8 bits writeToPGM stores, i.e. the score of the edge image file read back.
+  template <class T> float center(const CMatrix<T>& aEdges, bool aFile = false);
+
+  // Share of the spectral energy of an image (without its mean) at frequencies above aCutoff cycles per pixel,
+  // 0.5 being the Nyquist frequency. aTile = 0 transforms the whole image, otherwise only tiles of about
+  // aTile x aTile pixels that cover the center region are transformed and their energies summed.
+  template <class T> float spectral(const CMatrix<T>& aImage, int aTile = 0, double aCutoff = 0.25);
+  // Adds the energy of the spectrum of the aXSize x aYSize block at (aX,aY) of aImage to aTotal,
+  // the part above aCutoff also to aHigh
+  template <class T> void spectralEnergy(const CMatrix<T>& aImage, int aX, int aY, int aXSize, int aYSize,
+    double aCutoff, double& aHigh, double& aTotal);
+
+  // For each frame i, the mean (or median or trimmed mean) of the scores of the frames
+  // i-aSize..i+aSize except i itself, clipped at the sequence ends. 0 for frames without neighbors.
+  inline void neighborhood(const std::vector<float>& aScores, int aSize, EStatistic aStatistic, std::vector<float>& aResult);
+
+  // Marks frame i as blurred if its score is below aRatio times its neighborhood statistic
+  inline void rate(const std::vector<float>& aScores, int aSize, EStatistic aStatistic, std::vector<bool>& aBlurred, double aRatio = 0.85);
+
+  // A subset of the frames of a sequence ordered by score. Counts and sums are kept in Fenwick trees
+  // over the ranks of the scores in the whole sequence, so inserting or removing a frame and
+  // finding the k-th smallest score or the sum of the k smallest scores take O(log n) each.
+  class CRankedScores {
+  public:
+    // constructor, the subset is empty
+    inline CRankedScores(const std::vector<float>& aScores);
+    // Adds or removes frame i
+    inline void insert(int i);
+    inline void erase(int i);
+    // The k-th smallest score of the subset, 1 <= k <= number of frames in the subset
+    inline float select(int k) const;
+    // Sum of the k smallest scores of the subset
+    inline double sumSmallest(int k) const;
+  protected:
+    // Adds aCount frames with score aValue at the 1-based rank aRank
+    inline void add(int aRank, int aCount, double aValue);
+    // Highest 1-based rank whose prefix holds fewer than k frames
+    inline int descend(int k, double& aSum) const;
+
+    std::vector<float> mSorted;
+    std::vector<int> mRank;
+    std::vector<int> mCount;
+    std::vector<double> mSum;
+    int mStep;
+  };
+}
+
+// I M P L E M E N T A T I O N --------------------------------------------
+
+namespace NScore {
+
+  // center
+  template <class T>
+  float center(const CMatrix<T>& aEdges, bool aFile) {
+    double aScore = 0.0;
+    for (int x = 0.25*aEdges.xSize(); x < 0.75*aEdges.xSize(); ++x)
+      for (int y = 0.25*aEdges.xSize(); y < 0.75*aEdges.ySize(); ++y)
+        if (aFile) aScore += (int)aEdges(x,y);
+        else aScore += aEdges(x,y);
+    return aScore;
+  }
+
+  // spectral
+  // Tiles are rounded to sizes with the prime factors 2, 3 and 5, as many as fit into the center half
+  // of each dimension (the region center() scores), but at least one
+  template <class T>
+  float spectral(const CMatrix<T>& aImage, int aTile, double aCutoff) {
+    double aHigh = 0.0;
+    double aTotal = 0.0;
+    // The real transform needs an even width, an odd last column is left out
+    int aXSize = aImage.xSize() & ~1;
+    int aYSize = aImage.ySize();
+    if (aXSize < 2 || aYSize < 1) return 0;
+    if (aTile <= 0) spectralEnergy(aImage,0,0,aXSize,aYSize,aCutoff,aHigh,aTotal);
+    else {
+      int aSize = CFFT1D::goodSize(aTile);
+      while (aSize % 2) aSize = CFFT1D::goodSize(aSize+1);
+      int aWidth = std::min(aSize,aXSize);
+      int aHeight = std::min(aSize,aYSize);
+      int aXTiles = std::max(1,(aXSize/2)/aWidth);
+      int aYTiles = std::max(1,(aYSize/2)/aHeight);
+      int x1 = (aXSize-aXTiles*aWidth)/2;
+      int y1 = (aYSize-aYTiles*aHeight)/2;
+      for (int j = 0; j < aYTiles; j++)
+        for (int i = 0; i < aXTiles; i++)
+          spectralEnergy(aImage,x1+i*aWidth,y1+j*aHeight,aWidth,aHeight,aCutoff,aHigh,aTotal);
+    }
+    if (aTotal <= 0) return 0;
+    return aHigh/aTotal;
+  }
+
+  // spectralEnergy
+  // A Hann window fades the block out towards its borders. Otherwise the jumps between opposite borders
+  // of the periodically continued block would count as high frequencies in sharp and blurred frames alike.
+  template <class T>
+  void spectralEnergy(const CMatrix<T>& aImage, int aX, int aY, int aXSize, int aYSize,
+    double aCutoff, double& aHigh, double& aTotal) {
+    CRealFFTPlan& aPlan = CRealFFTPlan::cached(aXSize,aYSize);
+    double aPi2 = 8.0*atan(1.0);
+    std::vector<double> aXWindow(aXSize),aYWindow(aYSize);
+    for (int x = 0; x < aXSize; x++)
+      aXWindow[x] = 0.5-0.5*cos(aPi2*(x+0.5)/aXSize);
+    for (int y = 0; y < aYSize; y++)
+      aYWindow[y] = 0.5-0.5*cos(aPi2*(y+0.5)/aYSize);
+    double aMean = 0.0;
+    for (int y = 0; y < aYSize; y++)
+      for (int x = 0; x < aXSize; x++)
+        aMean += aImage(aX+x,aY+y);
+    aMean /= (double)aXSize*aYSize;
+    for (int y = 0; y < aYSize; y++) {
+      double* aRow = aPlan.row(y);
+      for (int x = 0; x < aXSize; x++)
+        aRow[x] = (aImage(aX+x,aY+y)-aMean)*aXWindow[x]*aYWindow[y];
+    }
+    aPlan.forward();
+    double aCutoff2 = aCutoff*aCutoff;
+    for (int v = 0; v < aYSize; v++) {
+      const double* aRow = aPlan.row(v);
+      double fy = (2*v <= aYSize) ? (double)v/aYSize : (double)(v-aYSize)/aYSize;
+      for (int u = 0; u < aPlan.spectrumXSize(); u++) {
+        if (u == 0 && v == 0) continue;
+        double fx = (double)u/aXSize;
+        // The frequencies 0 < u < xSize/2 stand for their conjugates as well
+        double aEnergy = aRow[2*u]*aRow[2*u]+aRow[2*u+1]*aRow[2*u+1];
+        if (u > 0 && 2*u < aXSize) aEnergy *= 2;
+        aTotal += aEnergy;
+        if (fx*fx+fy*fy > aCutoff2) aHigh += aEnergy;
+      }
+    }
+  }
+
+  // neighborhood
+  // The window slides along the sequence: the mean keeps a running sum, median and
+  // trimmed mean keep the window in a CRankedScores, so each step only inserts and removes single scores.
+  inline void neighborhood(const std::vector<float>& aScores, int aSize, EStatistic aStatistic, std::vector<float>& aResult) {
+    int aCount = aScores.size();
+    aResult.assign(aCount,0.0f);
+    // Running sum of the window, double keeps the sums of integral scores exact
+    double aSum = 0.0;
+    // Window contents ordered by score (median and trimmed mean only)
+    bool aKeepSorted = (aStatistic != cMean);
+    CRankedScores aSorted(aKeepSorted ? aScores : std::vector<float>());
+    // Neighbors of frame 0
+    for (int j = 1; j <= aSize && j < aCount; j++) {
+      aSum += aScores[j];
+      if (aKeepSorted) aSorted.insert(j);
+    }
+    for (int i = 0; i < aCount; i++) {
+      if (i > 0) {
+        // Slide from i-1 to i: frame i-1 enters, frame i leaves,
+        // frame i+aSize enters at the front, frame i-1-aSize drops out at the back
+        int aEnter[2] = {i-1,i+aSize};
+        int aLeave[2] = {i,i-1-aSize};
+        for (int k = 0; k < 2; k++) {
+          if (aEnter[k] >= 0 && aEnter[k] < aCount) {
+            float aValue = aScores[aEnter[k]];
+            aSum += aValue;
+            if (aKeepSorted) aSorted.insert(aEnter[k]);
+          }
+          if (aLeave[k] >= 0 && aLeave[k] < aCount) {
+            float aValue = aScores[aLeave[k]];
+            aSum -= aValue;
+            if (aKeepSorted) aSorted.erase(aLeave[k]);
+          }
+        }
+      }
+      // Number of valid neighbors, the window is clipped at both sequence ends
+      int aNeighbors = std::min(i+aSize,aCount-1)-std::max(i-aSize,0);
+      if (aNeighbors <= 0) continue;
+      if (aStatistic == cMean) aResult[i] = aSum/aNeighbors;
+      else if (aStatistic == cMedian) {
+        if (aNeighbors % 2) aResult[i] = aSorted.select(aNeighbors/2+1);
+        else aResult[i] = 0.5f*(aSorted.select(aNeighbors/2)+aSorted.select(aNeighbors/2+1));
+      }
+      else {
+        // Trimmed mean: drop the lowest and highest 10% of the neighbors
+        int aTrim = aNeighbors/10;
+        double aTrimmed = aSorted.sumSmallest(aNeighbors-aTrim)-aSorted.sumSmallest(aTrim);
+        aResult[i] = aTrimmed/(aNeighbors-2*aTrim);
+      }
+    }
+  }
+
+  // rate
+  inline void rate(const std::vector<float>& aScores, int aSize, EStatistic aStatistic, std::vector<bool>& aBlurred, double aRatio) {
+    std::vector<float> aNeighborhood;
+    neighborhood(aScores,aSize,aStatistic,aNeighborhood);
+    aBlurred.resize(aScores.size());
+    for (unsigned int i = 0; i < aScores.size(); i++)
+      aBlurred[i] = (aScores[i] < aRatio*aNeighborhood[i]);
+  }
+
+  // CRankedScores
+  // Equal scores get consecutive ranks in frame order, so every rank holds at most one frame
+  inline CRankedScores::CRankedScores(const std::vector<float>& aScores)
+    : mSorted(aScores.size()), mRank(aScores.size()), mCount(aScores.size()+1,0), mSum(aScores.size()+1,0.0) {
+    int aCount = aScores.size();
+    std::vector<std::pair<float,int> > aOrder(aCount);
+    for (int i = 0; i < aCount; i++)
+      aOrder[i] = std::make_pair(aScores[i],i);
+    std::sort(aOrder.begin(),aOrder.end());
+    for (int r = 0; r < aCount; r++) {
+      mSorted[r] = aOrder[r].first;
+      mRank[aOrder[r].second] = r+1;
+    }
+    mStep = 1;
+    while (2*mStep <= aCount) mStep *= 2;
+  }
+
+  // insert
+  inline void CRankedScores::insert(int i) {
+    add(mRank[i],1,mSorted[mRank[i]-1]);
+  }
+
+  // erase
+  inline void CRankedScores::erase(int i) {
+    add(mRank[i],-1,-mSorted[mRank[i]-1]);
+  }
+
+  // select
+  inline float CRankedScores::select(int k) const {
+    double aSum;
+    return mSorted[descend(k,aSum)];
+  }
+
+  // sumSmallest
+  inline double CRankedScores::sumSmallest(int k) const {
+    if (k <= 0) return 0.0;
+    double aSum;
+    int aRank = descend(k,aSum);
+    // The k-th smallest score itself lies just above the prefix
+    return aSum+mSorted[aRank];
+  }
+
+  // add
+  inline void CRankedScores::add(int aRank, int aCount, double aValue) {
+    for (int r = aRank; r < (int)mCount.size(); r += r & -r) {
+      mCount[r] += aCount;
+      mSum[r] += aValue;
+    }
+  }
+
+  // descend
+  // Walks down the implicit tree, aSum receives the sum of the scores in the prefix
+  inline int CRankedScores::descend(int k, double& aSum) const {
+    int aRank = 0;
+    aSum = 0.0;
+    for (int aStep = mStep; aStep > 0; aStep /= 2)
+      if (aRank+aStep < (int)mCount.size() && mCount[aRank+aStep] < k) {
+        aRank += aStep;
+        k -= mCount[aRank];
+        aSum += mSum[aRank];
+      }
+    return aRank;
+  }
+
+}
+
+#endif
@@ -0,0 +1,418 @@
+////////////////////////////////////////////////////////////////////////
+// Benchmark of the motion blur pipeline on synthetic image sequences
+//
+// Usage: ./bench [-o folder] [-r WxH[,WxH...]] [-f frames] [-b every]
+//                [-k length] [-x repetitions] [-seed n]
+//   For each resolution (default: 320x240,640x480,1280x720), a sequence
+//   of "frames" images (default: 24) is rendered into "folder" (default:
+//   bench_data): a textured scene seen by a slowly panning camera. Every
+//   "every"-th frame (default: 6) is motion blurred with a CFilter2D line
+//   kernel of random direction and about "length" pixels (default: 9,
+//   relative to 640 pixels width). These frames are the ground truth.
+//
+//   Then every pipeline stage is timed "repetitions" times (default: 3)
+//   on all frames and reported in MPix/s:
+//     decode      reading channel 0 of the PPM file
+//     derivative  NFilter derivatives, gradient magnitude and direction
+//     nms         non-maximum suppression
+//     threshold   clipping and normalization
+//     canny       the fused CCanny engine (derivative+nms+threshold)
+//     write       saving the edge image
+//     score       center edge strength
+//   The separate derivative/nms/threshold stages are the original
+//   pipeline and serve as the reference the fused engine is checked
+//   against. Finally the blurred frames found by sortout's rating are
+//   compared to the ground truth.
+//
+// Build: make bench
+////////////////////////////////////////////////////////////////////////
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <sstream>
+#include <vector>
+#include <chrono>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <CTensor.h>
+#include <CFilter.h>
+#include <CCanny.h>
+#include <NScore.h>
+using namespace std;
+
+#ifndef PI
+#define PI 3.1415926535
+#endif
+
+
+/// stages of the pipeline, in report order
+enum Stage { DECODE, DERIVATIVE, NMS, THRESHOLD, CANNY, WRITE, SCORE, STAGES };
+const char* stage_names[STAGES] = { "decode", "derivative", "nms", "threshold", "canny", "write", "score" };
+
+
+/// seconds since an arbitrary point in time
+double now()
+{
+    return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+/// uniformly distributed random number in [a, b)
+double uniform(double a, double b)
+{
+    return a + (b-a)*(rand()/(RAND_MAX+1.0));
+}
+
+
+/// renders a random scene of rectangles, discs and lines on a smooth background
+void renderScene(CMatrix<float> canvas[3])
+{
+    int width = canvas[0].xSize();
+    int height = canvas[0].ySize();
+    for (int c = 0; c < 3; c++)
+    {
+        double gx = uniform(-0.1, 0.1), gy = uniform(-0.1, 0.1), base = uniform(60, 200);
+        for (int y = 0; y < height; y++)
+            for (int x = 0; x < width; x++)
+                canvas[c](x, y) = base + gx*(x-width/2) + gy*(y-height/2);
+    }
+    int shapes = width*height/2000;
+    for (int n = 0; n < shapes; n++)
+    {
+        float color[3] = { (float)uniform(0, 256), (float)uniform(0, 256), (float)uniform(0, 256) };
+        int kind = rand() % 3;
+        double cx = uniform(0, width), cy = uniform(0, height);
+        double size = uniform(3, 0.05*width+4);
+        if (kind == 0)
+        {
+            /// rectangle
+            int x1 = max(0, (int)(cx-size)), x2 = min(width-1, (int)(cx+size));
+            int y1 = max(0, (int)(cy-0.6*size)), y2 = min(height-1, (int)(cy+0.6*size));
+            for (int c = 0; c < 3; c++)
+                canvas[c].fillRect(color[c], x1, y1, x2, y2);
+        }
+        else if (kind == 1)
+        {
+            /// disc
+            for (int y = max(0, (int)(cy-size)); y <= min(height-1, (int)(cy+size)); y++)
+                for (int x = max(0, (int)(cx-size)); x <= min(width-1, (int)(cx+size)); x++)
+                    if ((x-cx)*(x-cx) + (y-cy)*(y-cy) <= size*size)
+                        for (int c = 0; c < 3; c++)
+                            canvas[c](x, y) = color[c];
+        }
+        else
+        {
+            /// line, 1-3 pixels thick
+            double angle = uniform(0, PI);
+            int thickness = 1 + rand() % 3;
+            for (double t = -3*size; t <= 3*size; t += 0.5)
+                for (int d = 0; d < thickness; d++)
+                {
+                    int x = (int)(cx + t*cos(angle) - d*sin(angle));
+                    int y = (int)(cy + t*sin(angle) + d*cos(angle));
+                    if (x >= 0 && x < width && y >= 0 && y < height)
+                        for (int c = 0; c < 3; c++)
+                            canvas[c](x, y) = color[c];
+                }
+        }
+    }
+}
+
+
+/// linear motion blur kernel of the given length and direction
+void lineKernel(double length, double angle, CFilter2D<float>& kernel)
+{
+    int size = 2*(int)ceil(0.5*length) + 1;
+    int center = size/2;
+    kernel.setSize(size, size);
+    kernel.fill(0);
+    kernel.shift(center, center);
+    /// splat sample points along the line bilinearly
+    for (double t = -0.5*length; t <= 0.5*length; t += 0.125)
+    {
+        double x = t*cos(angle), y = t*sin(angle);
+        int x0 = (int)floor(x), y0 = (int)floor(y);
+        double fx = x-x0, fy = y-y0;
+        for (int j = 0; j < 2; j++)
+            for (int i = 0; i < 2; i++)
+            {
+                int xi = x0+i, yj = y0+j;
+                if (xi < -center || xi > center || yj < -center || yj > center)
+                    continue;
+                kernel(xi, yj) += (i ? fx : 1-fx) * (j ? fy : 1-fy);
+            }
+    }
+    kernel.normalizeSum();
+}
+
+
+/// renders the sequence, returns the ground truth (true = blurred)
+vector<bool> generateSequence(const string& folder, int width, int height, int frames, int every, double length)
+{
+    int margin = 2*frames + 16;
+    CMatrix<float> canvas[3];
+    for (int c = 0; c < 3; c++)
+        canvas[c].setSize(width+margin, height+margin);
+    renderScene(canvas);
+
+    vector<bool> truth(frames, false);
+    CTensor<float> frame(width, height, 3);
+    CFilter2D<float> kernel;
+    double scaled_length = length*width/640.;
+    for (int n = 0; n < frames; n++)
+    {
+        truth[n] = (every > 0 && n % every == every/2);
+        if (truth[n])
+            lineKernel(uniform(0.75, 1.25)*scaled_length, uniform(0, PI), kernel);
+        /// the camera pans by (2,1) pixels per frame
+        int ox = 2*n % margin, oy = n % margin;
+        for (int c = 0; c < 3; c++)
+        {
+            /// each channel is rendered directly into the frame
+            CMatrixView<float> layer = frame.layer(c);
+            for (int y = 0; y < height; y++)
+                for (int x = 0; x < width; x++)
+                    layer(x, y) = canvas[c](x+ox, y+oy);
+            if (truth[n])
+                NFilter::filter(layer, kernel);
+            /// sensor noise
+            for (int y = 0; y < height; y++)
+                for (int x = 0; x < width; x++)
+                    layer(x, y) += uniform(-2, 2);
+            layer.clip(0, 255);
+        }
+        ostringstream filename;
+        filename << folder << "/frame" << setw(3) << setfill('0') << n << ".ppm";
+        frame.writeToPPM(filename.str().c_str());
+    }
+    return truth;
+}
+
+
+/// the original, staged pipeline: derivatives, gradient magnitude and direction
+void derivativeStage(const CMatrix<double>& image, CMatrix<double>& mag, CMatrix<double>& dir,
+                     CMatrix<double>& dx, CMatrix<double>& dy)
+{
+    int width = image.xSize();
+    int height = image.ySize();
+    dx = image;
+    dy = image;
+    NFilter::filter(dx, CDerivative<double>(3), 1);
+    NFilter::filter(dy, 1, CDerivative<double>(3));
+    mag.setSize(width, height);
+    dir.setSize(width, height);
+    for (int y = 0; y < height; y++)
+        for (int x = 0; x < width; x++)
+        {
+            if (dy(x, y) == 0 && dx(x, y) == 0)
+                dir(x, y) = 0.0;
+            else
+                dir(x, y) = atan2(dy(x, y), dx(x, y));
+            mag(x, y) = sqrt(dx(x, y)*dx(x, y) + dy(x, y)*dy(x, y));
+        }
+    mag.normalize(0., 255.);
+}
+
+
+/// the original, staged pipeline: non-maximum suppression (in place)
+void nmsStage(CMatrix<double>& mag, const CMatrix<double>& dir)
+{
+    int width = mag.xSize();
+    int height = mag.ySize();
+    for (int y = 1; y < height-1; y++)
+        for (int x = 1; x < width-1; x++)
+        {
+            double d = dir(x, y);
+            if (d >= 0.875*PI || d < -0.875*PI || (d >= -0.125*PI && d < 0.125*PI))
+            {
+                if (mag(x, y) <= mag(x-1, y) || mag(x, y) <= mag(x+1, y))
+                    mag(x, y) = 0;
+            }
+            else if ((d >= -0.875*PI && d < -0.625*PI) || (d >= 0.125*PI && d < 0.375*PI))
+            {
+                if (mag(x, y) <= mag(x-1, y-1) || mag(x, y) <= mag(x+1, y+1))
+                    mag(x, y) = 0;
+            }
+            else if ((d >= -0.625*PI && d < -0.375*PI) || (d >= 0.375*PI && d < 0.625*PI))
+            {
+                if (mag(x, y) <= mag(x, y+1) || mag(x, y) <= mag(x, y-1))
+                    mag(x, y) = 0;
+            }
+            else
+            {
+                if (mag(x, y) <= mag(x+1, y-1) || mag(x, y) <= mag(x-1, y+1))
+                    mag(x, y) = 0;
+            }
+        }
+}
+
+
+/// the original, staged pipeline: thresholding
+void thresholdStage(CMatrix<double>& mag)
+{
+    mag.clip(70, 255);
+    mag.normalize(0., 255.);
+}
+
+
+/// parses "WxH[,WxH...]"
+bool parseResolutions(const char* text, vector<int>& widths, vector<int>& heights)
+{
+    widths.clear();
+    heights.clear();
+    stringstream stream(text);
+    string item;
+    while (getline(stream, item, ','))
+    {
+        int width, height;
+        if (sscanf(item.c_str(), "%dx%d", &width, &height) != 2 || width < 3 || height < 3)
+            return false;
+        widths.push_back(width);
+        heights.push_back(height);
+    }
+    return widths.size() > 0;
+}
+
+
+int main(int argc, char **args)
+{
+    string folder = "bench_data";
+    vector<int> widths, heights;
+    parseResolutions("320x240,640x480,1280x720", widths, heights);
+    int frames = 24;
+    int every = 6;
+    double length = 9;
+    int repetitions = 3;
+    unsigned int seed = 1;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(args[i], "-o") == 0 && i+1 < argc)
+            folder = args[++i];
+        else if (strcmp(args[i], "-r") == 0 && i+1 < argc)
+        {
+            if (!parseResolutions(args[++i], widths, heights))
+            {
+                cerr << "Error: Resolutions must be given as WxH[,WxH...]" << endl;
+                return 1;
+            }
+        }
+        else if (strcmp(args[i], "-f") == 0 && i+1 < argc)
+            frames = max(1, atoi(args[++i]));
+        else if (strcmp(args[i], "-b") == 0 && i+1 < argc)
+            every = atoi(args[++i]);
+        else if (strcmp(args[i], "-k") == 0 && i+1 < argc)
+            length = atof(args[++i]);
+        else if (strcmp(args[i], "-x") == 0 && i+1 < argc)
+            repetitions = max(1, atoi(args[++i]));
+        else if (strcmp(args[i], "-seed") == 0 && i+1 < argc)
+            seed = atoi(args[++i]);
+        else
+        {
+            cerr << "Usage: ./bench [-o folder] [-r WxH[,WxH...]] [-f frames] [-b every] [-k length] [-x repetitions] [-seed n]" << endl;
+            return 1;
+        }
+    }
+    srand(seed);
+    mkdir(folder.c_str(), 0755);
+
+    cout << fixed;
+    for (unsigned int r = 0; r < widths.size(); r++)
+    {
+        int width = widths[r];
+        int height = heights[r];
+        ostringstream sequence_folder;
+        sequence_folder << folder << "/" << width << "x" << height;
+        mkdir(sequence_folder.str().c_str(), 0755);
+        string edge_folder = sequence_folder.str() + "/Canny";
+        mkdir(edge_folder.c_str(), 0755);
+
+        double start = now();
+        vector<bool> truth = generateSequence(sequence_folder.str(), width, height, frames, every, length);
+        cout << "== " << width << "x" << height << ", " << frames << " frames, generated in "
+             << setprecision(2) << now()-start << " s" << endl;
+
+        vector<double> seconds(STAGES, 0.);
+        vector<float> scores(frames);
+        long long mismatches = 0;
+        CMatrix<double> image, mag, dir, dx, dy, edges;
+        CCanny<double> canny;
+        for (int repetition = 0; repetition < repetitions; repetition++)
+            for (int n = 0; n < frames; n++)
+            {
+                ostringstream name;
+                name << "frame" << setw(3) << setfill('0') << n;
+                string filename = sequence_folder.str() + "/" + name.str() + ".ppm";
+                string edge_filename = edge_folder + "/" + name.str() + "_Canny.ppm";
+
+                double t0 = now();
+                image.readFromPPM(filename.c_str(), 0);
+                double t1 = now();
+                derivativeStage(image, mag, dir, dx, dy);
+                double t2 = now();
+                nmsStage(mag, dir);
+                double t3 = now();
+                thresholdStage(mag);
+                double t4 = now();
+                canny.apply(image, edges);
+                double t5 = now();
+                edges.writeToPGM(edge_filename.c_str());
+                double t6 = now();
+                scores[n] = NScore::center(edges);
+                double t7 = now();
+
+                seconds[DECODE] += t1-t0;
+                seconds[DERIVATIVE] += t2-t1;
+                seconds[NMS] += t3-t2;
+                seconds[THRESHOLD] += t4-t3;
+                seconds[CANNY] += t5-t4;
+                seconds[WRITE] += t6-t5;
+                seconds[SCORE] += t7-t6;
+
+                /// the fused engine has to reproduce the staged pipeline
+                if (repetition == 0)
+                    for (int i = 0; i < edges.size(); i++)
+                        if (fabs(edges.data()[i] - mag.data()[i]) > 1e-6)
+                            mismatches++;
+            }
+
+        double mpix = (double)width*height*frames*repetitions/1e6;
+        cout << "  stage        ms/frame      MPix/s" << endl;
+        for (int s = 0; s < STAGES; s++)
+            cout << "  " << left << setw(10) << stage_names[s] << right
+                 << setw(10) << setprecision(3) << 1e3*seconds[s]/(frames*repetitions)
+                 << setw(12) << setprecision(1) << mpix/seconds[s] << endl;
+        double staged = seconds[DERIVATIVE] + seconds[NMS] + seconds[THRESHOLD];
+        cout << "  fused canny vs. staged pipeline: " << setprecision(2) << staged/seconds[CANNY]
+             << "x faster, " << mismatches << " differing pixels" << endl;
+
+        /// accuracy of the rating against the ground truth
+        const char* statistic_names[3] = { "mean", "median", "trimmed" };
+        for (int s = 0; s < 3; s++)
+        {
+            vector<bool> blurred;
+            NScore::rate(scores, 10, (NScore::EStatistic)s, blurred);
+            int true_positives = 0, false_positives = 0, false_negatives = 0;
+            for (int n = 0; n < frames; n++)
+            {
+                if (blurred[n] && truth[n])
+                    true_positives++;
+                else if (blurred[n])
+                    false_positives++;
+                else if (truth[n])
+                    false_negatives++;
+            }
+            int found = true_positives + false_positives;
+            int actual = true_positives + false_negatives;
+            cout << "  rating (" << statistic_names[s] << "): " << true_positives << " of " << actual
+                 << " blurred frames found, " << false_positives << " false alarms, precision "
+                 << setprecision(2) << (found ? (double)true_positives/found : 1.)
+                 << ", recall " << (actual ? (double)true_positives/actual : 1.) << endl;
+        }
+    }
+    return 0;
+}
@@ -2,15 +2,43 @@
 // Identification of PPM images degraded by (motion) blur
 //
 // Usage:
-//   Step 1: ./motionblur findlines scene.bmf
+//   Step 1: ./motionblur findlines scene.bmf [-j threads] [-q depth] [-s factor]
 //     Canny filters images to extract strong edges, a lack of which
 //     indicates blur degradation. The resulting edge images are saved
-//     in a "Canny" folder.
-//   Step 2: ./motionblur sortout scene.bmf
+//     in a "Canny" folder. Reading, filtering and writing run as a
+//     pipeline: one thread decodes the images, "threads" workers
+//     (default: one per core) filter them, one thread writes the results.
+//     At most "depth" images are in flight (default: 2*threads+2).
+//     With "-s factor" the images are processed at 1/factor of their
+//     resolution (factor x factor pixel blocks are averaged while
+//     decoding). Half or quarter resolution suffices for blur ranking.
+//   Step 2: ./motionblur sortout scene.bmf [-hash] [-n size] [-stat mean|median|trimmed]
 //     Compares edge images and dismisses those that have less overall
 //     edge count/strength than their neighboring images. The rest (the
 //     images with comparatively good edges) are saved to:
 //       "Scene_without_blur.bmf"
+//     The neighbors are the "size" images before and after each image
+//     (default: 10), compared by their mean (default), median or mean
+//     without the lowest and highest 10% ("trimmed").
+//
+//   Both steps at once: ./motionblur findlines+sortout scene.bmf [-j threads] [-q depth] [-s factor] [-w] [-hash]
+//                       [-n size] [-stat mean|median|trimmed]
+//     Scores the edge images directly from memory instead of writing
+//     and re-reading 8-bit edge images. The edge images are only saved
+//     if "-w" is given.
+//
+//   Alternative to both steps: ./motionblur spectral scene.bmf [-j threads] [-q depth] [-s factor] [-t tile] [-hash]
+//                              [-n size] [-stat mean|median|trimmed]
+//     Scores each image by the share of its spectral energy at high
+//     frequencies instead of its edges, which skips the Canny filter and
+//     the edge images, and sorts out the images like sortout. With
+//     "-t tile" only tiles of about tile x tile pixels covering the image
+//     center are transformed instead of the whole image.
+//
+//   Scores are kept in "scores.cache", keyed by file name, size and
+//   modification time of each image (and its contents with "-hash").
+//   Repeated runs only rescore new or changed images; findlines+sortout
+//   without "-w" skips filtering unchanged images entirely.
 //
 // Author: Nikolaus Mayer
 ////////////////////////////////////////////////////////////////////////
@@ -22,14 +50,219 @@
 #include <vector>
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <mutex>
+#include <thread>
+#include <exception>
 
 #include <CTensor.h>
 #include <CFilter.h>
+#include <CCanny.h>
+#include <CThreadPool.h>
+#include <CBoundedQueue.h>
+#include <CScoreCache.h>
+#include <NScore.h>
 using namespace std;
 
-#ifndef PI
-#define PI 3.1415926535
-#endif
+
+/// an image travelling through the findlines pipeline, the buffers are reused
+struct Frame
+{
+    int index;
+    bool valid;
+    CMatrix<double> in_layer, edges;
+    float score;
+};
+
+
+/// collects the console output of parallel jobs and prints it in job order
+class OrderedOutput
+{
+public:
+    OrderedOutput(int count) : texts(count), done(count, false), next(0) {}
+
+    void put(int index, const string& text)
+    {
+        lock_guard<mutex> lock(guard);
+        texts[index] = text;
+        done[index] = true;
+        while (next < (int)done.size() && done[next])
+        {
+            cout << texts[next];
+            texts[next].clear();
+            next++;
+        }
+        cout.flush();
+    }
+
+private:
+    mutex guard;
+    vector<string> texts;
+    vector<bool> done;
+    int next;
+};
+
+
+/// name of the edge image belonging to an input image, "_Canny" goes before the
+/// extension (if the file name has one)
+string cannyFilename(const string& filename)
+{
+    size_t split = filename.find_last_of(".");
+    size_t slash = filename.find_last_of("/");
+    if (split == string::npos || (slash != string::npos && split < slash))
+        split = filename.size();
+    return "./Canny/" + filename.substr(0,split) + "_Canny" + filename.substr(split);
+}
+
+
+/// "preprocessing": Canny filters all images as a pipeline of a reader, "threads"
+/// compute workers and a writer connected by bounded queues. The images are
+/// processed at 1/factor of their resolution. The writer saves
+/// the edge images (if write_edges) and/or their scores (if scores != 0),
+/// and the scores of the edge image files written (if edge_scores != 0).
+/// If spectral, the workers score the spectra of the images (of their center tiles
+/// of about tile x tile pixels if tile > 0) instead, and there are no edge images.
+void findlines(const vector<string>& filenames, int threads, int depth, int factor, bool write_edges, vector<float>* scores,
+               vector<float>* edge_scores = 0, bool spectral = false, int tile = 0, double cutoff = 0.25)
+{
+    int count = filenames.size();
+    CThreadPool pool(threads);
+    if (depth <= 0)
+        depth = 2*pool.threads()+2;
+    if (scores != 0)
+        scores->resize(count);
+    if (edge_scores != 0)
+        edge_scores->resize(count);
+    if (count == 0)
+        return;
+
+    /// at most "depth" frames exist, they circulate reader -> workers -> writer -> reader
+    vector<Frame> frames(depth);
+    CBoundedQueue<Frame*> free_frames(depth), decoded(depth), computed(depth);
+    for (int i = 0; i < depth; i++)
+        free_frames.push(&frames[i]);
+
+    exception_ptr error;
+    mutex error_guard;
+    OrderedOutput output(count);
+
+    /// stage 1: decode images
+    thread reader([&]()
+    {
+        for (int index = 0; index < count; index++)
+        {
+            Frame* frame;
+            free_frames.pop(frame);
+            frame->index = index;
+            frame->valid = true;
+            try
+            {
+                /// all color layers are equally blurred (?), so only the first one is decoded,
+                /// already reduced to the working resolution
+                frame->in_layer.readFromPPM(filenames[index].c_str(), 0, factor);
+            }
+            catch (...)
+            {
+                lock_guard<mutex> lock(error_guard);
+                if (!error)
+                    error = current_exception();
+                frame->valid = false;
+            }
+            decoded.push(frame);
+        }
+        /// one end marker per compute worker
+        for (int i = 0; i < pool.threads(); i++)
+            decoded.push(0);
+    });
+
+    /// stage 3: write edge images and/or compute scores, print messages in image order
+    thread writer([&]()
+    {
+        for (int n = 0; n < count; n++)
+        {
+            Frame* frame;
+            computed.pop(frame);
+            const string& filename = filenames[frame->index];
+            ostringstream message;
+            if (frame->valid)
+            {
+                try
+                {
+                    /// only needed if the edge image is written
+                    string canny_filename;
+                    if (write_edges)
+                    {
+                        canny_filename = cannyFilename(filename);
+                        message << "File: " << filename << " --> " << canny_filename << endl;
+                    }
+
+                    /// score the edge image right away
+                    if (scores != 0 && spectral)
+                    {
+                        (*scores)[frame->index] = frame->score;
+                        message << "Score " << frame->score << " for " << filename << endl;
+                    }
+                    else if (scores != 0)
+                    {
+                        (*scores)[frame->index] = NScore::center(frame->edges);
+                        message << "Score " << (long)(*scores)[frame->index] << " for " << filename << endl;
+                    }
+
+                    /// (debug) write lines image, its file holds the 8-bit values only
+                    if (write_edges)
+                    {
+                        frame->edges.writeToPGM(canny_filename.c_str());
+                        if (edge_scores != 0)
+                            (*edge_scores)[frame->index] = NScore::center(frame->edges, true);
+                    }
+                }
+                catch (...)
+                {
+                    lock_guard<mutex> lock(error_guard);
+                    if (!error)
+                        error = current_exception();
+                }
+            }
+            output.put(frame->index, message.str());
+            free_frames.push(frame);
+        }
+    });
+
+    /// stage 2: gradients, non-maximum suppression and thresholding in one sweep (or the spectrum)
+    vector<CCanny<double> > cannies(spectral ? 0 : pool.threads());
+    pool.run(pool.threads(), [&](int, int worker)
+    {
+        while (true)
+        {
+            Frame* frame;
+            decoded.pop(frame);
+            if (frame == 0)
+                break;
+            /// a failed frame is passed on as invalid, so that all stages still drain
+            try
+            {
+                if (frame->valid && spectral)
+                    frame->score = NScore::spectral(frame->in_layer, tile, cutoff);
+                else if (frame->valid)
+                    cannies[worker].apply(frame->in_layer, frame->edges);
+            }
+            catch (...)
+            {
+                lock_guard<mutex> lock(error_guard);
+                if (!error)
+                    error = current_exception();
+                frame->valid = false;
+            }
+            computed.push(frame);
+        }
+    });
+
+    reader.join();
+    writer.join();
+    if (error)
+        rethrow_exception(error);
+}
+
 
 int main(int argc, char **args) {
     int mode = 0;
@@ -37,7 +270,7 @@ int main(int argc, char **args) {
     if (argc < 2)
     {
         cout << "Identification of images degraded by motion blur" << endl;
-        cout << "Usage: ./motionblur {findlines, sortout} scene.bmf" << endl;
+        cout << "Usage: ./motionblur {findlines, sortout, findlines+sortout, spectral} scene.bmf [-j threads] [-q depth] [-s factor] [-w] [-t tile] [-hash] [-n size] [-stat mean|median|trimmed]" << endl;
         return 1;
     }
     if (argc < 3)
@@ -50,12 +283,98 @@ int main(int argc, char **args) {
         mode = 1;
     else if (strcmp(args[1], "sortout") == 0)
         mode = 2;
+    else if (strcmp(args[1], "findlines+sortout") == 0)
+        mode = 3;
+    else if (strcmp(args[1], "spectral") == 0)
+        mode = 4;
     else
     {
-        cerr << "Error: First argument must be one of {findlines, sortout}." << endl;
+        cerr << "Error: First argument must be one of {findlines, sortout, findlines+sortout, spectral}." << endl;
         return 1;
     }
 
+    /// options
+    int threads = 0;
+    int depth = 0;
+    int factor = 1;
+    bool write_edges = (mode == 1);
+    bool hash_content = false;
+    int neighborhood_size = 10;
+    NScore::EStatistic statistic = NScore::cMean;
+    int tile = 0;
+    /// spectral energy above a quarter cycle per pixel (half the Nyquist frequency) counts as high
+    const double cutoff = 0.25;
+    for (int i = 3; i < argc; i++)
+    {
+        if (strcmp(args[i], "-j") == 0 && i+1 < argc)
+            threads = atoi(args[++i]);
+        else if (strcmp(args[i], "-q") == 0 && i+1 < argc)
+            depth = atoi(args[++i]);
+        else if (strcmp(args[i], "-s") == 0 && i+1 < argc)
+        {
+            factor = atoi(args[++i]);
+            if (factor < 1)
+            {
+                cerr << "Error: Working resolution factor must be at least 1." << endl;
+                return 1;
+            }
+        }
+        else if (strcmp(args[i], "-w") == 0)
+        {
+            if (mode == 4)
+            {
+                cerr << "Error: The spectral mode does not compute edge images." << endl;
+                return 1;
+            }
+            write_edges = true;
+        }
+        else if (strcmp(args[i], "-t") == 0 && i+1 < argc)
+        {
+            tile = atoi(args[++i]);
+            if (mode != 4)
+            {
+                cerr << "Error: Tiles only apply to the spectral mode." << endl;
+                return 1;
+            }
+            if (tile < 2)
+            {
+                cerr << "Error: Tile size must be at least 2." << endl;
+                return 1;
+            }
+        }
+        else if (strcmp(args[i], "-hash") == 0)
+            hash_content = true;
+        else if (strcmp(args[i], "-n") == 0 && i+1 < argc)
+        {
+            neighborhood_size = atoi(args[++i]);
+            if (neighborhood_size < 1)
+            {
+                cerr << "Error: Neighborhood size must be at least 1." << endl;
+                return 1;
+            }
+        }
+        else if (strcmp(args[i], "-stat") == 0 && i+1 < argc)
+        {
+            i++;
+            if (strcmp(args[i], "mean") == 0)
+                statistic = NScore::cMean;
+            else if (strcmp(args[i], "median") == 0)
+                statistic = NScore::cMedian;
+            else if (strcmp(args[i], "trimmed") == 0)
+                statistic = NScore::cTrimmedMean;
+            else
+            {
+                cerr << "Error: Neighborhood statistic must be one of {mean, median, trimmed}." << endl;
+                return 1;
+            }
+        }
+        else
+        {
+            cerr << "Error: Unknown option " << args[i] << endl;
+            return 1;
+        }
+    }
+
 
     string image_folder;
     vector<string> filenames;
@@ -81,187 +400,99 @@ int main(int argc, char **args) {
 
 
 
-    /// "preprocessing": Canny filtering images to find strong edges
-    if (mode == 1)
+    /// scores are cached, an image is only rescored if it or the parameters changed
+    CScoreCache cache("scores.cache", hash_content);
+    cache.load();
+    /// everything besides the input image that influences its score
+    uint64_t parameters;
+    if (mode == 4)
     {
-        CTensor<double> in_img;        
-        CMatrix<double> in_layerx, in_layery, tmp, mag;
-        
-        for (vector<string>::iterator iter = filenames.begin(); iter != filenames.end(); ++iter)
-        {
-            size_t split = (*iter).find_last_of(".");
-            cout << "File: " << *iter << " --> " << "./Canny/" << (*iter).substr(0,split) << "_Canny" << (*iter).substr(split) << endl;
-
-            in_img.readFromPPM((*iter).c_str());
-            int width = in_img.xSize();
-            int height = in_img.ySize();
-
-            in_img.downsample(width, height);
-            /// all color layers are equally blurred (?)
-            in_layerx = in_img.getMatrix(0);
-            in_layery = in_img.getMatrix(0);
-            tmp.setSize(width, height);
-            mag.setSize(width, height);
-            
-            //~ in_layer.downsample(512, 512);
-
-            //~ in_img.downsample(512, 512);
-            //~ in_img.fft();
-            //~ in_img.normalize(0.0, 255.0);
-            //~ in_layer = in_img.getMatrix(0);
-            //~ return 0;
-
-
-            //~ NFilter::filter(in_layerx, CSmooth<double>::CSmooth(2, 1), 1);
-            //~ NFilter::filter(in_layery, CSmooth<double>::CSmooth(2, 1), 1);
-            
-            //~ /// (debug) write 
-            //~ sprintf(charbuf, "resized_blackandwhite_%s.pgm", s.c_str());
-            //~ in_layerx.writeToPGM(charbuf);
-            
-            NFilter::filter(in_layerx, CDerivative<double>::CDerivative(3), 1);
-            NFilter::filter(in_layery, 1, CDerivative<double>::CDerivative(3));
-
-            
-            for (int y = 0; y < height; y++)
-                for (int x = 0; x < width; x++)
-                {
-                    /// gradient direction
-                    if (in_layery(x, y) == 0 && in_layerx(x, y) == 0)
-                        tmp(x, y) = 0.0;
-                    else
-                        tmp(x, y) = atan2(in_layery(x, y), in_layerx(x, y));
-                    /// gradient magnitude
-                    mag(x, y) = sqrt(in_layerx(x, y)*in_layerx(x, y) + in_layery(x, y)*in_layery(x, y));
-                }
-
-            /// (debug) write gradient magnitude image
-            mag.normalize(0., 255.);
-            //~ sprintf(charbuf, "gradient_magnitude_%s.pgm", s.c_str());
-            //~ mag.writeToPGM(charbuf);
-
-            /// non-maximum suppression
-            for (int y = 0; y < height; y++)
-                for (int x = 0; x < width; x++)
-                {
-                    if (x == 0 || y == 0 || x == width-1 || y == height-1)
-                        { tmp(x, y) = 0; }
-                    else if (tmp(x, y) >= 0.875*PI || tmp(x, y) < -0.875*PI || (tmp(x, y) >= -0.125*PI && tmp(x, y) < 0.125*PI))
-                    {
-                        if (mag(x, y) <= mag(x-1, y) || mag(x, y) <= mag(x+1, y))
-                            mag(x, y) = 0;
-                    }
-                    else if ((tmp(x, y) >= -0.875*PI && tmp(x, y) < -0.625*PI) || (tmp(x, y) >= 0.125*PI && tmp(x, y) < 0.375*PI))
-                    {
-                        if (mag(x, y) <= mag(x-1, y-1) || mag(x, y) <= mag(x+1, y+1))
-                            mag(x, y) = 0;
-                    }
-                    else if ((tmp(x, y) >= -0.625*PI && tmp(x, y) < -0.375*PI) || (tmp(x, y) >= 0.375*PI && tmp(x, y) < 0.625*PI))
-                    {
-                        if (mag(x, y) <= mag(x, y+1) || mag(x, y) <= mag(x, y-1))
-                            mag(x, y) = 0;
-                    }
-                    else if ((tmp(x, y) >= -0.375*PI && tmp(x, y) < -0.125*PI) || (tmp(x, y) >= 0.625*PI && tmp(x, y) < 0.875*PI))
-                    {
-                        if (mag(x, y) <= mag(x+1, y-1) || mag(x, y) <= mag(x-1, y+1))
-                            mag(x, y) = 0;
-                    }
-                    else
-                        cout << "something's amiss! x=" << x << ", y=" << y << ", tmp(x, y)=" << tmp(x, y) << endl;
-                    
-                }
-
-
-            /// thresholding
-            mag.clip(70, 255);
-
-            /// (debug) write lines image
-            mag.normalize(0., 255.);
-            char *charbuf = new char[1024];
-            split = (*iter).find_last_of(".");
-            sprintf(charbuf, "./Canny/%s_Canny%s", (*iter).substr(0,split).c_str(), (*iter).substr(split).c_str());
-            mag.writeToPGM(charbuf);
-
-            delete[] charbuf;
-        }
+        parameters = CScoreCache::fnv1a((const unsigned char*)"spectral", 8);
+        parameters = CScoreCache::fingerprint(parameters, factor);
+        parameters = CScoreCache::fingerprint(parameters, tile);
+        parameters = CScoreCache::fingerprint(parameters, cutoff);
     }
+    else
+    {
+        parameters = CScoreCache::fnv1a((const unsigned char*)"findlines", 9);
+        parameters = CScoreCache::fingerprint(parameters, factor);
+        parameters = CScoreCache::fingerprint(parameters, CCanny<double>().threshold());
+    }
+    /// the score of an edge image only depends on the edge image
+    const uint64_t edge_parameters = 0;
+
+    vector<float> scores(filenames.size());
 
-    /// blur estimation
-    else if (mode == 2)
+    /// "preprocessing": Canny filtering images to find strong edges, or scoring their spectra
+    if (mode == 1 || mode == 3 || mode == 4)
     {
-        vector<float> scores;
-        vector<string> ok_files;
-        char *charbuf = new char[255];
+        /// filter all images whose edge images are wanted, otherwise only the new or changed ones
+        vector<string> todo;
+        vector<int> todo_index;
+        for (unsigned int i = 0; i < filenames.size(); ++i)
+        {
+            if (write_edges || !cache.lookup(filenames[i], parameters, scores[i]))
+            {
+                todo.push_back(filenames[i]);
+                todo_index.push_back(i);
+            }
+        }
+        if (todo.size() < filenames.size())
+            cout << "Using cached scores for " << filenames.size()-todo.size() << " of " << filenames.size() << " images" << endl;
 
-        /// try to read existing scores file
-        ifstream infile("scores.txt");
-        if (infile.fail())
+        vector<float> todo_scores, edge_scores;
+        try
         {
-            cerr << "Could not read scores.txt!" << endl;
+            findlines(todo, threads, depth, factor, write_edges, &todo_scores, &edge_scores, mode == 4, tile, cutoff);
         }
-        else
+        catch (...)
         {
-            string str;
-            getline(infile, str);
-            while (infile)
-            {
-                scores.push_back(atof(str.c_str()));
-                getline(infile, str);
-            }
-            infile.close();
+            /// the exception has already reported the error
+            return 1;
         }
 
+        for (unsigned int j = 0; j < todo.size(); ++j)
+        {
+            scores[todo_index[j]] = todo_scores[j];
+            cache.store(todo[j], parameters, todo_scores[j]);
+            /// lets sortout reuse the scores of the edge images just written
+            if (write_edges)
+                cache.store(cannyFilename(todo[j]), edge_parameters, edge_scores[j]);
+        }
+    }
 
-        /// if the scores file could not be found/read, create scores and write the file
-        if (scores.size() == 0)
+    /// blur estimation from the edge images of step 1
+    if (mode == 2)
+    {
+        for (unsigned int i = 0; i < filenames.size(); ++i)
         {
-            /// compute scores
-            for (vector<string>::iterator iter = filenames.begin(); iter != filenames.end(); ++iter)
-            {
-                size_t split = (*iter).find_last_of(".");
-                sprintf(charbuf, "./Canny/%s_Canny%s", (*iter).substr(0,split).c_str(), (*iter).substr(split).c_str());
-                
-                cout << "Reading " << charbuf << " for " << *iter << endl;
-
-                CMatrix<float> img;
-                img.readFromPGM(charbuf);
-
-                float score = 0.;
-                //~ for (int x = 0; x < img.xSize(); ++x)
-                    //~ for (int y = 0; y < img.ySize(); ++y)
-                        //~ score += img(x, y);
-                for (int x = 0.25*img.xSize(); x < 0.75*img.xSize(); ++x)
-                    for (int y = 0.25*img.xSize(); y < 0.75*img.ySize(); ++y)
-                        score += img(x, y);
-                        
-                scores.push_back(score);
+            string canny_filename = cannyFilename(filenames[i]);
+            if (cache.lookup(canny_filename, edge_parameters, scores[i]))
+                continue;
 
-            }
+            cout << "Reading " << canny_filename << " for " << filenames[i] << endl;
+
+            CMatrix<float> img;
+            img.readFromPGM(canny_filename.c_str());
 
-            /// debug: write scores to file
-            ofstream outfile ("scores.txt");
-            for (unsigned int i = 0; i < scores.size(); ++i)
-                /// (long) casting to avoid float's scientific number notation (1e+06)
-                outfile << (long)scores[i] << endl;
-            outfile.close();
+            scores[i] = NScore::center(img);
+            cache.store(canny_filename, edge_parameters, scores[i]);
         }
-            
+    }
+
+    if (!cache.save())
+        cerr << "Could not write scores.cache!" << endl;
+
+    if (mode == 2 || mode == 3 || mode == 4)
+    {
+        vector<string> ok_files;
 
-        /// rate images
-        int neighborhood_size = 10;
+        /// rate images against their neighborhoods
+        vector<bool> blurred;
+        NScore::rate(scores, neighborhood_size, statistic, blurred);
         for (unsigned int i = 0; i < scores.size(); ++i)
         {
-            float mean_score = 0.;
-            
-            for (int shift = -neighborhood_size; shift < neighborhood_size; shift++)
-            {
-                if (shift == 0 || i+shift < 0 || i+shift >= scores.size())
-                    continue;
-                else
-                    mean_score += scores[i+shift]/(2*neighborhood_size);
-            }
-
-            if (scores[i] < 0.85 * mean_score)
+            if (blurred[i])
                 cout << "Image " << filenames[i] << " seems to be blurry." << endl;
             else
                 ok_files.push_back(filenames[i]);
@@ -274,61 +505,5 @@ int main(int argc, char **args) {
             outfile << image_folder << "/" << ok_files[i] << endl;
         outfile.close();            
         cout << filenames.size() - ok_files.size() << " of " << filenames.size() << " images have been dismissed. From the other images, I have compiled a new scene file (scene_without_blur.bmf)." << endl;
-
-        delete[] charbuf;
     }
-
-    
-    //~ in_layerx.writeToPGM("x.pgm");
-    //~ in_layer.normalize(-255.0, 255.0);
-    //~ in_layer.writeToPGM("deriv.pgm");
-    
-    //~ double *in_data = in_layer.data();
-    //~ int width  = in_layer.xSize();
-    //~ int height = in_layer.ySize();
-    //~ 
-    //~ fftw_plan p;
-    //~ fftw_complex *in;
-    //~ fftw_complex *out;
-    //~ 
-    //~ in  = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * width*height);
-    //~ out = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * width*height);
-    //~ 
-    //~ p = fftw_plan_dft_2d(width, height, in, out, FFTW_FORWARD, FFTW_ESTIMATE);
-    //~ 
-    //~ for (int i = 0; i < width*height; i++)
-        //~ in[i][0] = in_data[i];
-    //~ 
-    //~ fftw_execute(p);
-    //~ 
-    //~ CMatrix<double> out_img;
-    //~ out_img.setSize(width, height);
-    //~ for (int y = 0; y < height; y++)
-        //~ for (int x = 0; x < width; x++)
-        //~ {
-            //~ double r = out[y*width+x][0] / (width*height);
-            //~ double i = out[y*width+x][1] / (width*height);
-            //~ 
-            //~ if (x < width/2 && y < height/2)
-                //~ out_img(width/2 + x, height/2 + y) = log(sqrt(r*r+i*i));
-            //~ else if (x >= width/2 && y < height/2)
-                //~ out_img(x - width/2, height/2 + y) = log(sqrt(r*r+i*i));
-            //~ else if (x < width/2 && y >= height/2)
-                //~ out_img(width/2 + x, y - height/2) = log(sqrt(r*r+i*i));
-            //~ else if (x >= width/2 && y >= height/2)
-                //~ out_img(x - width/2, y - height/2) = log(sqrt(r*r+i*i));
-            //~ else
-                //~ cout << "Error: No place for x=" << x << ", y=" << y << endl;
-        //~ }
-    //~ 
-    //~ out_img.normalize(1.0, 255.0);
-    //~ out_img.writeToPGM("fft.pgm");
-    //~ 
-    //~ fftw_destroy_plan(p);
-    //~ fftw_free(in);
-    //~ fftw_free(out);
-    //~ 
-    //~ return 0;
-
 }
-